@@ -25,6 +25,10 @@ class Epoller {
   bool EpollModify(int fd, uint32_t event);
   bool EpollRemove(int fd);
 
+  /* 以data.ptr代替data.fd注册, 事件返回时直接取回ptr, 无需按fd查表 */
+  bool EpollAdd(int fd, uint32_t events, void *ptr);
+  bool EpollModify(int fd, uint32_t events, void *ptr);
+
   /* epoll_wait的简单封装 */
   int EpollWait(int timeout = -1);
 
@@ -32,6 +36,8 @@ class Epoller {
   int GetEventFd(size_t idx) const;
   /* 从事件队列中获取一个epoll_event事件支持的events, 支持随机访问 */
   uint32_t GetEpollEvents(size_t idx) const;
+  /* 获取以data.ptr注册的事件对应的指针 */
+  void *GetEventPtr(size_t idx) const;
   /* 获取Epoll实例的fd */
   int GetEpollFd() const;
 
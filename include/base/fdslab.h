@@ -0,0 +1,84 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-22
+ * @copyleft Apache 2.0
+ *
+ * 模板类的声明和定义放在同一个头文件中, 参考blockqueue.h
+ */
+
+#ifndef FDSLAB_H_
+#define FDSLAB_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+namespace webserver {
+
+/* 以fd为下标的对象表, 用来代替 std::unordered_map<int, T>:
+ * 查找只是一次数组下标运算, 对象地址在整个生命周期内保持不变, 可直接存入
+ * epoll_event.data.ptr；fd关闭后槽位中的对象会被下一个同号fd复用。
+ * 下标表按capacity一次性分配, 对象按CHUNK_SIZE分块在首次使用时创建,
+ * 避免启动时为全部MAX_FD个连接分配缓冲区。Get()是线程安全的。 */
+template <typename T>
+class FdSlab {
+ public:
+  explicit FdSlab(size_t capacity);
+  ~FdSlab();
+
+  /* 返回fd对应的对象, 所在分块尚未创建时先创建 */
+  T *Get(int fd);
+
+  size_t Capacity() const { return capacity_; }
+
+  FdSlab(const FdSlab &) = delete;
+  FdSlab &operator=(const FdSlab &) = delete;
+
+ private:
+  static const size_t CHUNK_SIZE = 256;
+
+  size_t capacity_;
+  size_t chunk_cnt_;
+  std::unique_ptr<std::atomic<T *>[]> chunks_;
+};
+
+template <typename T>
+FdSlab<T>::FdSlab(size_t capacity)
+    : capacity_(capacity),
+      chunk_cnt_((capacity + CHUNK_SIZE - 1) / CHUNK_SIZE),
+      chunks_(new std::atomic<T *>[chunk_cnt_]) {
+  assert(capacity > 0);
+  for (size_t i = 0; i < chunk_cnt_; ++i) {
+    chunks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+FdSlab<T>::~FdSlab() {
+  for (size_t i = 0; i < chunk_cnt_; ++i) {
+    delete[] chunks_[i].load(std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+T *FdSlab<T>::Get(int fd) {
+  assert(fd >= 0 && static_cast<size_t>(fd) < capacity_);
+  size_t idx = fd / CHUNK_SIZE;
+  T *chunk = chunks_[idx].load(std::memory_order_acquire);
+  if (chunk == nullptr) {
+    /* 多个Reactor可能同时创建同一个分块, 只保留第一个 */
+    T *fresh = new T[CHUNK_SIZE];
+    if (chunks_[idx].compare_exchange_strong(chunk, fresh,
+                                             std::memory_order_acq_rel)) {
+      chunk = fresh;
+    } else {
+      delete[] fresh;
+    }
+  }
+  return &chunk[fd % CHUNK_SIZE];
+}
+
+}  // namespace webserver
+
+#endif
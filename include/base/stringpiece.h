@@ -0,0 +1,84 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-26
+ * @copyleft Apache 2.0
+ */
+
+#ifndef STRINGPIECE_H_
+#define STRINGPIECE_H_
+
+#include <strings.h>  // strncasecmp
+
+#include <cstring>
+#include <string>
+
+namespace webserver {
+
+/* 只读的字符串视图(C++11中没有std::string_view), 不持有内存,
+ * 指向的数据(通常是读缓冲区)必须在使用期间保持有效 */
+class StringPiece {
+ public:
+  static const size_t npos = static_cast<size_t>(-1);
+
+  StringPiece() : data_(nullptr), size_(0) {}
+  StringPiece(const char* data, size_t size) : data_(data), size_(size) {}
+  StringPiece(const char* str) : data_(str), size_(str ? strlen(str) : 0) {}
+  StringPiece(const std::string& str) : data_(str.data()), size_(str.size()) {}
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  char operator[](size_t i) const { return data_[i]; }
+
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+
+  std::string ToString() const { return std::string(data_, size_); }
+
+  /* 找不到时返回npos */
+  size_t find(char ch, size_t pos = 0) const {
+    if (pos >= size_) return npos;
+    const void* p = memchr(data_ + pos, ch, size_ - pos);
+    return p ? static_cast<const char*>(p) - data_ : npos;
+  }
+  /* 与std::string::substr相同, len超出时截断到末尾 */
+  StringPiece substr(size_t pos, size_t len = npos) const {
+    if (pos > size_) pos = size_;
+    if (len > size_ - pos) len = size_ - pos;
+    return StringPiece(data_ + pos, len);
+  }
+  void RemovePrefix(size_t n) {
+    data_ += n;
+    size_ -= n;
+  }
+  /* 去掉首尾的空格和制表符(HTTP的OWS) */
+  void TrimSpace() {
+    while (size_ > 0 && (data_[0] == ' ' || data_[0] == '\t')) RemovePrefix(1);
+    while (size_ > 0 && (data_[size_ - 1] == ' ' || data_[size_ - 1] == '\t')) {
+      --size_;
+    }
+  }
+
+  bool StartsWith(const StringPiece& prefix) const {
+    return size_ >= prefix.size_ &&
+           memcmp(data_, prefix.data_, prefix.size_) == 0;
+  }
+
+  /* HTTP的头部字段名、部分字段值(如keep-alive)不区分大小写 */
+  bool EqualsIgnoreCase(const StringPiece& other) const {
+    return size_ == other.size_ && strncasecmp(data_, other.data_, size_) == 0;
+  }
+
+  bool operator==(const StringPiece& other) const {
+    return size_ == other.size_ && memcmp(data_, other.data_, size_) == 0;
+  }
+  bool operator!=(const StringPiece& other) const { return !(*this == other); }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+}  // namespace webserver
+
+#endif  // STRINGPIECE_H_
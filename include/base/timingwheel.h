@@ -0,0 +1,89 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-29
+ * @copyleft Apache 2.0
+ */
+
+#ifndef TIMINGWHEEL_H_
+#define TIMINGWHEEL_H_
+
+#include <cstdint>
+#include <deque>
+
+#include "base/timer.h"
+
+namespace webserver {
+
+/* 分层时间轮(hashed hierarchical timing wheel), 接口与MinHeapTimer一致。
+ * 以1ms为一个tick, 根时间轮256个槽位, 其上4层各64个槽位, 可表示约49天。
+ * 定时器按fd直接下标访问并挂在槽位的双向链表上, 添加/取消都是O(1)；
+ * UpdateItem在超时时间延后时只记录新的到期时间(惰性刷新), 等所在槽位
+ * 到期时再重新挂到正确的位置, 因此每次读写事件的续期不需要任何链表操作。 */
+class TimingWheel {
+ public:
+  TimingWheel();
+  ~TimingWheel() { Clear(); }
+
+  // 添加一个元素
+  void AddItem(int fd, int timeout, const Task& cb_func);
+
+  // 修改一个节点的时间
+  void UpdateItem(int fd, int timeout);
+
+  // 删除指定节点, 不执行回调函数
+  void CancelItem(int fd);
+
+  // 删除指定节点, 并执行回调函数
+  void DoWork(int fd);
+
+  // 推进时间轮并执行到期回调, 返回距下一个需要处理的tick的毫秒数
+  int GetNextTick();
+
+  // 清除计时器中所有item
+  void Clear();
+
+  size_t Size() const { return count_; }
+
+ private:
+  static const int ROOT_BITS = 8;
+  static const int LEVEL_BITS = 6;
+  static const int LEVELS = 5;  // 根时间轮 + 4层
+  static const int ROOT_SIZE = 1 << ROOT_BITS;
+  static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+  static const int ROOT_MASK = ROOT_SIZE - 1;
+  static const int LEVEL_MASK = LEVEL_SIZE - 1;
+  static const int SLOT_NUM = ROOT_SIZE + (LEVELS - 1) * LEVEL_SIZE;
+
+  /* 时间轮中的一个节点 */
+  struct WheelItem {
+    int item_id;
+    int slot;        // 所在槽位, -1表示不在时间轮中
+    int64_t expire;  // 到期的tick
+    Task cb_func;
+    WheelItem* prev;
+    WheelItem* next;
+    WheelItem()
+        : item_id(-1), slot(-1), expire(0), prev(nullptr), next(nullptr) {}
+  };
+
+  /* deque在尾部扩容时不会使已有元素的地址失效 */
+  std::deque<WheelItem> items_;
+  WheelItem* slots_[SLOT_NUM];
+  uint64_t bitmap_[SLOT_NUM / 64];  // 非空槽位的位图, 用于快速查找下一个tick
+
+  int64_t current_;  // 下一个待处理的tick
+  size_t count_;
+  TimeStamp start_;
+
+  int64_t Now_() const;
+  WheelItem* Find_(int fd);
+  void Link_(WheelItem* item);
+  void Unlink_(WheelItem* item);
+  void Advance_(int64_t now);
+  void Cascade_(int level, int idx);
+  int NextRootSlot_(int idx) const;
+};
+
+}  // namespace webserver
+
+#endif
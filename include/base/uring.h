@@ -0,0 +1,82 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-15
+ * @copyleft Apache 2.0
+ */
+
+#ifndef URING_H_
+#define URING_H_
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace webserver {
+
+/* io_uring的简单封装(不依赖liburing, 直接使用系统调用):
+ * PrepXxx()只向提交队列(SQ)填写请求, 不产生系统调用；
+ * Submit()通过一次io_uring_enter提交整批请求并等待完成事件,
+ * 之后用PeekCqe()逐个取出完成队列(CQ)中的结果。
+ * 提交与收割只能在同一个线程中进行。 */
+class IoUring {
+ public:
+  explicit IoUring(unsigned entries = 1024);
+  ~IoUring();
+
+  /* 内核是否支持io_uring以及本类依赖的特性(IORING_FEAT_EXT_ARG) */
+  bool Valid() const { return ring_fd_ >= 0; }
+
+  void PrepAccept(int fd, sockaddr* addr, socklen_t* len, int flags,
+                  uint64_t user_data);
+  void PrepRecv(int fd, void* buf, size_t len, uint64_t user_data);
+  void PrepRead(int fd, void* buf, size_t len, uint64_t user_data);
+  void PrepWritev(int fd, const iovec* iov, int iov_cnt, uint64_t user_data);
+  void PrepClose(int fd, uint64_t user_data);
+  void PrepCancel(uint64_t target, uint64_t user_data);
+
+  /* 提交所有已准备的请求, 并最多等待timeout毫秒直到至少一个完成事件,
+     timeout == -1 表示一直阻塞 */
+  int Submit(int timeout = -1);
+
+  /* 取出一个完成事件, CQ为空时返回false */
+  bool PeekCqe(io_uring_cqe* cqe);
+
+  /* 禁止拷贝 */
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+ private:
+  int ring_fd_;
+  unsigned sq_entries_;
+  unsigned sqe_tail_;  // 本地SQ尾指针, Submit时发布给内核
+
+  void* sq_ptr_;
+  size_t sq_ring_size_;
+  void* cq_ptr_;
+  size_t cq_ring_size_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned* sq_mask_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned* cq_mask_;
+  io_uring_cqe* cqes_;
+
+  /* 获取一个空闲的SQE, SQ已满时先提交已有请求 */
+  io_uring_sqe* GetSqe_();
+  void Release_();
+};
+
+}  // namespace webserver
+
+#endif
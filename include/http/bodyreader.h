@@ -0,0 +1,82 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-15
+ * @copyleft Apache 2.0
+ */
+
+#ifndef BODY_READER_H_
+#define BODY_READER_H_
+
+#include <stddef.h>
+
+#include <functional>
+
+namespace webserver {
+
+/* 增量式请求体解码: 按Content-Length或分块编码(chunked)定界, 每次Feed
+ * 消费已收到的数据并把解码后的内容片段交给Sink, 调用方随即可以丢弃这些
+ * 字节, 因此请求体不需要完整地留在读缓冲区中。分块的扩展与trailer被
+ * 跳过, 解码后的总长度超过limit时返回TOO_LARGE。 */
+class BodyReader {
+ public:
+  enum STATUS {
+    INCOMPLETE = 0,
+    COMPLETE,
+    ERROR,      // 分块格式错误或Sink中止
+    TOO_LARGE,  // 超过limit
+  };
+
+  /* 收到一段解码后的内容, 返回false时中止读取 */
+  typedef std::function<bool(const char* data, size_t len)> Sink;
+
+  static const size_t MAX_LINE = 1024;         // 分块大小行与trailer行
+  static const size_t MAX_TRAILER = 8 * 1024;  // 全部trailer
+
+  BodyReader() { Reset(); }
+  ~BodyReader() = default;
+
+  void Reset();
+  /* 读取length字节的内容 */
+  void InitLength(size_t length, size_t limit, const Sink& sink);
+  /* 读取分块编码的内容, 直到大小为0的块与trailer结束 */
+  void InitChunked(size_t limit, const Sink& sink);
+
+  /* 从data中消费尽可能多的字节, *used为消费的字节数(COMPLETE时之后的
+     字节属于下一个流水线请求) */
+  STATUS Feed(const char* data, size_t len, size_t* used);
+
+  /* 已解码的内容字节数 */
+  size_t Received() const { return received_; }
+  bool Done() const { return state_ == DONE; }
+
+ private:
+  enum STATE {
+    LENGTH_DATA,
+    CHUNK_SIZE,
+    CHUNK_EXT,
+    CHUNK_SIZE_LF,
+    CHUNK_DATA,
+    CHUNK_DATA_CR,
+    CHUNK_DATA_LF,
+    TRAILER_START,
+    TRAILER_LINE,
+    TRAILER_END_LF,
+    DONE,
+  };
+
+  STATE state_;
+  size_t remaining_;  // 当前块(或Content-Length)剩余的内容字节
+  size_t received_;
+  size_t limit_;
+  size_t line_;  // 当前分块大小行或trailer行已扫描的长度
+  size_t trailer_;
+  int digits_;
+  Sink sink_;
+
+  /* 把data[0, len)交给Sink, 返回是否继续 */
+  bool Deliver_(const char* data, size_t len);
+};
+
+}  // namespace webserver
+
+#endif  // BODY_READER_H_
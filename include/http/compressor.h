@@ -0,0 +1,54 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-12
+ * @copyleft Apache 2.0
+ */
+
+#ifndef COMPRESSOR_H_
+#define COMPRESSOR_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+
+#include "base/stringpiece.h"
+#include "http/filecache.h"
+
+namespace webserver {
+
+/* 响应内容压缩: Accept-Encoding协商, gzip(zlib)与brotli(编译时找到
+ * libbrotlienc才启用)。文件的压缩结果按编码保存在FileCache条目中,
+ * 条目即文件版本, 文件变化后随旧条目一起失效 */
+class Compressor {
+ public:
+  enum ENCODING {
+    IDENTITY = 0,
+    GZIP,
+    BROTLI,
+    ENCODINGS,
+  };
+
+  static const size_t MIN_SIZE = 256;  // 更小的文件压缩后省不了一个报文段
+
+  /* 按q值选择, 同等q值时优先brotli; 都不可接受时为IDENTITY */
+  static ENCODING Negotiate(const StringPiece& acceptEncoding);
+  static const char* Name(ENCODING encoding);  // Content-Encoding的值
+  static bool Compressible(const char* mime);
+  static bool Compress(ENCODING encoding, const char* data, size_t len,
+                       std::string* out);
+
+  /* 文件的压缩变体: 优先使用同目录下不旧于源文件的.br/.gz预压缩文件,
+     否则即时压缩。类型不可压缩或压缩后没有变小时返回空指针 */
+  static std::shared_ptr<const std::string> Encode(
+      const FileCache::EntryPtr& file, const std::string& path,
+      ENCODING encoding);
+
+ private:
+  static bool ReadSidecar_(const std::string& path, const struct stat& source,
+                           std::string* out);
+};
+
+}  // namespace webserver
+
+#endif  // COMPRESSOR_H_
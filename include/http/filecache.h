@@ -0,0 +1,104 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-10
+ * @copyleft Apache 2.0
+ */
+
+#ifndef FILE_CACHE_H_
+#define FILE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>  // stat
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "base/uncopyable.h"
+
+namespace webserver {
+
+/* 静态文件的打开缓存: 路径 -> 打开的fd、stat信息、整个文件的只读映射(过大
+ * 的文件除外)和MIME类型。所有reactor与工作线程共享, 按路径哈希分片加锁。
+ * 条目以shared_ptr引用计数, 输出链持有引用期间即使文件被替换或条目被
+ * 淘汰, 映射与fd也保持有效, 直到最后一个引用释放。
+ * 每个条目至多每REVALIDATE_MS重新stat一次, inode/大小/修改时间任一变化
+ * 即重新打开, 因此命中时通常不需要任何系统调用。 */
+class FileCache : private Uncopyable {
+ public:
+  struct Entry {
+    struct stat st;
+    int fd;            // 仅不小于FD_MIN的文件保留, 供sendfile使用
+    /* 整个文件的映射; 空文件、不可读或不小于STREAM_MIN(只保留fd,
+       按窗口流式发送)时为nullptr */
+    char* data;
+    const char* mime;          // 指向静态的类型表
+    const char* cacheControl;  // 按后缀的缓存策略, 同样指向静态表
+    std::string etag;          // inode-大小-修改时间, 不含引号
+    std::string lastModified;  // HTTP-date格式的修改时间
+
+    /* 由文件内容派生的数据(如压缩结果), 使用者按下标填充, 与条目即
+       文件版本一起失效 */
+    static const int DERIVED = 4;
+    mutable std::mutex derivedMtx;
+    mutable std::shared_ptr<const std::string> derived[DERIVED];
+    mutable bool derivedDone[DERIVED];
+
+    Entry()
+        : fd(-1),
+          data(nullptr),
+          mime("text/plain"),
+          cacheControl("max-age=3600"),
+          derivedDone() {}
+    ~Entry();
+    size_t Size() const { return st.st_size; }
+  };
+  typedef std::shared_ptr<const Entry> EntryPtr;
+
+  static const int SHARDS = 16;
+  static const size_t MAX_ENTRIES = 32;  // 每个分片, 限制常驻的fd与映射
+  static const size_t FD_MIN = 64 * 1024;
+  /* 更大的文件不整体映射, 避免每个大文件占用与其大小相同的地址空间 */
+  static const size_t STREAM_MIN = 16 * 1024 * 1024;
+  static const int64_t REVALIDATE_MS = 1000;
+
+  static FileCache* Instance();
+
+  /* path为完整路径; 文件不存在或不是普通文件时返回空指针 */
+  EntryPtr Get(const std::string& path);
+  /* 按后缀查MIME类型, 无法识别时为text/plain */
+  static const char* MimeType(const std::string& path);
+  /* 按后缀查Cache-Control: 页面每次都重新验证, 样式脚本缓存一天,
+     图片等媒体缓存一周, 其余一小时 */
+  static const char* CacheControl(const std::string& path);
+  void Clear();
+
+ private:
+  FileCache() = default;
+
+  struct Slot {
+    EntryPtr entry;
+    int64_t checkedMs;  // 上次确认与磁盘一致的时间
+    std::list<std::string>::iterator lru;
+  };
+  struct Shard {
+    std::mutex mtx;
+    std::unordered_map<std::string, Slot> slots;
+    std::list<std::string> lru;  // 头部为最近使用, 满时淘汰尾部
+  };
+
+  static void Erase_(Shard& shard, const std::string& path);
+  static EntryPtr Load_(const std::string& path, const struct stat& st);
+  static bool SameFile_(const struct stat& a, const struct stat& b);
+  static void SetValidators_(Entry* entry);
+  static int64_t NowMs_();
+
+  Shard shards_[SHARDS];
+};
+
+}  // namespace webserver
+
+#endif  // FILE_CACHE_H_
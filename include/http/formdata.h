@@ -0,0 +1,123 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-17
+ * @copyleft Apache 2.0
+ */
+
+#ifndef FORM_DATA_H_
+#define FORM_DATA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/stringpiece.h"
+
+namespace webserver {
+
+/* 表单请求体的解码结果, 字段以StringPiece的形式指向请求体缓冲区:
+ * application/x-www-form-urlencoded  整个请求体收完后原地URL解码;
+ * multipart/form-data                作为BodyReader的Sink边收边解析,
+ *                                    普通字段的值追加到arena(请求体缓冲区),
+ *                                    文件字段直接写入uploadDir下的临时文件。
+ * 字段数组在请求之间复用, 解析时不为单个字段分配内存。临时文件在Reset时
+ * 删除, 需要保留的由处理者在此之前rename/link走。 */
+class FormData {
+ public:
+  struct Field {
+    StringPiece name;
+    StringPiece value;        // 普通字段的值, 文件字段为空
+    StringPiece filename;     // 文件字段的原文件名(可能为空)
+    StringPiece contentType;  // 分段的Content-Type
+    StringPiece path;         // 文件字段的临时文件路径
+    int fd;                   // 文件字段的临时文件(已回到开头), 普通字段为-1
+    size_t size;              // 值或文件的字节数
+  };
+
+  static const int MAX_FIELDS = 128;
+  static const size_t MAX_PART_HEAD = 8 * 1024;
+  static const size_t MAX_BOUNDARY = 70;  // RFC 2046
+
+  FormData();
+  ~FormData();
+
+  /* 关闭并删除临时文件, 清空字段 */
+  void Reset();
+
+  /* 原地解码application/x-www-form-urlencoded, data在字段使用期间须有效 */
+  void ParseUrlencoded(char* data, size_t len);
+
+  /* 按Content-Type中的boundary开始解析multipart/form-data。arena存放普通
+     字段的值与各分段的头部信息, 其长度不超过fieldLimit; boundary不合法时
+     返回false */
+  bool InitMultipart(const StringPiece& contentType, std::string* arena,
+                     size_t fieldLimit, const std::string& uploadDir);
+  /* 收到一段请求体, 格式错误、超过上限或写文件失败时返回false */
+  bool Feed(const char* data, size_t len);
+  /* 请求体结束, 结束分隔符出现过时返回true, 之后Fields()可用 */
+  bool Finish();
+  /* 由于fieldLimit而失败 */
+  bool TooLarge() const { return tooLarge_; }
+
+  const std::vector<Field>& Fields() const { return fields_; }
+  /* 第一个同名字段, 没有时返回nullptr */
+  const Field* Get(const StringPiece& name) const;
+
+  /* 原地URL解码('+'为空格, 不完整的%转义保持原样), 返回解码后的长度 */
+  static size_t UrlDecode(char* data, size_t len);
+  /* 从Content-Type中取出参数值(可带引号), 不存在时返回空 */
+  static StringPiece Param(const StringPiece& header, const StringPiece& name);
+  /* Content-Type中';'之前的媒体类型 */
+  static StringPiece MediaType(const StringPiece& contentType);
+
+ private:
+  enum STATE {
+    PREAMBLE,
+    DELIMITER,  // 分隔符之后: "--"结束, CRLF开始新的分段
+    PART_HEAD,
+    PART_DATA,
+    EPILOGUE,
+    FAILED,
+  };
+
+  /* [begin, begin + len) 相对arena起始处的偏移, 收完后再转成StringPiece */
+  struct Span {
+    uint32_t begin;
+    uint32_t len;
+  };
+  struct Part {
+    Span name, filename, contentType, path;
+    size_t value;  // 普通字段的值在arena中的起始偏移
+    int fd;
+    size_t size;
+  };
+
+  STATE state_;
+  std::string delimiter_;  // "\r\n--" + boundary
+  std::string pending_;    // 上次没有处理完的字节(不完整的分隔符或分段头)
+  std::string* arena_;
+  size_t fieldLimit_;
+  std::string uploadDir_;
+  bool tooLarge_;
+
+  std::vector<Part> parts_;
+  std::vector<Field> fields_;
+
+  /* 处理[data, data + len), 返回消费的字节数, 剩余的需等待更多数据 */
+  size_t Process_(const char* data, size_t len);
+  bool OpenPart_(const char* head, size_t len);
+  bool AppendPart_(const char* data, size_t len);
+  /* data末尾可能是分隔符开头部分的字节数, 需要留到下次再判断 */
+  size_t PartialDelimiter_(const char* data, size_t len) const;
+  /* 把str追加到arena, 超过fieldLimit时返回false */
+  bool Save_(const StringPiece& str, Span* span);
+  StringPiece Piece_(const Span& span) const {
+    return StringPiece(arena_->data() + span.begin, span.len);
+  }
+};
+
+}  // namespace webserver
+
+#endif  // FORM_DATA_H_
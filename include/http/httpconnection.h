@@ -14,10 +14,15 @@
 #include <sys/types.h>
 #include <sys/uio.h>  // readv/writev
 
+#include <atomic>
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "base/stringbuffer.h"
+#include "http/filecache.h"
 #include "http/httprequest.h"
+#include "http/responsecache.h"
 #include "http/httpresponse.h"
 #include "pool/sqlconnpool.h"
 #include "utils/logger.h"
@@ -30,14 +35,24 @@ class HttpConn {
 
   ~HttpConn();
 
-  void init(int sockFd, const sockaddr_in& addr);
+  /* sendfile为false时大文件也以内存映射发送(完成式I/O只能提交iovec),
+     不整体映射的文件每次映射一个STREAM_WINDOW大小的窗口 */
+  void init(int sockFd, const sockaddr_in& addr, bool sendfile = true);
 
   ssize_t read(int* saveErrno);
+  /* 上一次read因读缓冲区达到READ_BUDGET而停下, socket中可能还有数据 */
+  bool ReadPending() const { return readPending_; }
+  /* 有数据可读但暂不读取(等待异步处理者时), ET模式下不会再通知, 记为
+     ReadPending, 之后由调用者接着读 */
+  void SkipRead() { readPending_ = isET; }
 
   ssize_t write(int* saveErrno);
 
   void Close();
 
+  /* 与Close()相同, 但不关闭fd而是将其返回, 由调用者负责关闭(如io_uring) */
+  int Release();
+
   int GetFd() const;
 
   int GetPort() const;
@@ -46,11 +61,52 @@ class HttpConn {
 
   sockaddr_in GetAddr() const;
 
-  bool process();
-
-  int ToWriteBytes() { return iov_[0].iov_len + iov_[1].iov_len; }
-
-  bool IsKeepAlive() const { return request_.IsKeepAlive(); }
+  /* 处理读缓冲区中所有完整的(流水线)请求, 响应按顺序拼成一条输出链,
+     之后由write一次writev发出; 遇到不保持连接的请求后不再继续处理。
+     inlineOnly为true时遇到不能在Reactor线程中处理的请求即停止;
+     交给异步处理者的请求之后也停止, 见IsPending。
+     至少生成了一个响应(含100 Continue)时返回true, 调用前上一条输出链
+     必须已经写完 */
+  bool process(bool inlineOnly = false);
+
+  /* 异步处理者调用done后的通知, 由reactor在init之后设置: 它应回到
+     Reactor线程调用Complete(), 再让连接的持有者调用Resume() */
+  void SetCompletion(const std::function<void()>& cb) { completion_ = cb; }
+  /* 有请求在等待异步处理者的回复(含已完成但还未Resume的) */
+  bool IsPending() const { return async_ != ASYNC_IDLE; }
+  /* 异步处理者还没有调用done, 仍在使用request与response, 连接不能释放 */
+  bool InHandler() const { return async_ == ASYNC_WAITING; }
+  /* 在Reactor线程中调用, 标记异步处理者已完成 */
+  void Complete();
+  /* 异步处理者已完成时生成它的回复作为新的输出链并返回true, 仍在等待时
+     返回false; 调用前上一条输出链必须已经写完 */
+  bool Resume();
+
+  /* 读缓冲区中的请求能否在Reactor线程中直接处理(不会访问数据库) */
+  bool IsInlineable() const;
+
+  int ToWriteBytes() { return static_cast<int>(toWrite_); }
+
+  size_t ToReadBytes() const { return readBuff_.ReadableBytes(); }
+
+  /* 输出链中最后一个响应是否保持连接 */
+  bool IsKeepAlive() const { return isKeepAlive_; }
+
+  bool IsClosed() const { return isClose_; }
+
+  /* 供完成式I/O(io_uring)使用: 由调用者发起读写, 完成后再通知HttpConn */
+  iovec ReadSpace(size_t len);
+  void HasRead(size_t len);
+  const iovec* WriteIov(int* iovCnt) const;
+  void HasWritten(size_t len);
+
+  /* 一次process最多处理的流水线请求数, 输出链最多为其两倍个iovec */
+  static const int MAX_PIPELINE = 16;
+  /* 流式发送的窗口: 不能sendfile时每个连接至多映射这么大的一段文件;
+     LT模式下一次write至多发送这么多, 之后让出线程等待下一次可写 */
+  static const size_t STREAM_WINDOW = 1024 * 1024;
+  /* 一次read至多让读缓冲区攒到这么多, 请求体边读边解码 */
+  static const size_t READ_BUDGET = 256 * 1024;
 
   /* 下面三静态成员变量在WebServer的构造函数中初始化 */
   static bool isET;
@@ -63,9 +119,64 @@ class HttpConn {
   struct sockaddr_in addr_;
 
   bool isClose_;
-
-  int iovCnt_;
-  struct iovec iov_[2];
+  bool isKeepAlive_;
+  bool sendfile_;
+  bool readPending_;
+
+  /* 异步处理者的状态: process中调用之前置为WAITING, Reactor线程收到
+     完成通知后置为DONE, 持有者Resume后回到IDLE */
+  enum ASYNC_STATE {
+    ASYNC_IDLE = 0,
+    ASYNC_WAITING,
+    ASYNC_DONE,
+  };
+  std::atomic<int> async_;
+  std::function<void()> completion_;
+
+  /* 输出链中的一段: 共享内存data[0, len)(文件映射或缓存的完整响应),
+     以sendfile或窗口映射发送的文件fd[off, off + len), 或写缓冲区中
+     [off, off + len); 文件段发送时off与len随之推进 */
+  struct Piece {
+    std::shared_ptr<const void> owner;  // 保证data/fd在发送期间有效
+    const char* data;
+    int fd;
+    size_t off;
+    size_t len;
+  };
+  std::vector<Piece> pieces_;
+  /* 输出链, 写缓冲区中相邻的段已合并; iov_base为nullptr的是sendfile段,
+     不能sendfile时当前文件段指向窗口, 之后的文件段仍为nullptr */
+  std::vector<iovec> iov_;
+  size_t iovIdx_;   // 第一个未写完的iovec
+  size_t fileIdx_;  // 当前文件段在pieces_中的下标
+  size_t fileIov_;  // 当前文件段在iov_中的下标
+  size_t toWrite_;
+  void* window_;  // 当前文件段已映射的窗口
+  size_t windowLen_;
+
+  /* 小文件的200响应整体缓存, 命中时直接加入输出链 */
+  bool AddCachedResponse_(const std::string& path,
+                          Compressor::ENCODING encoding);
+  void AddCachedPieces_(const ResponseCache::ResponsePtr& cached);
+  /* 处理者给出回复之后: 命中缓存时加入缓存的响应, 否则按条件请求与
+     范围请求生成 */
+  void AddResponse_(Compressor::ENCODING encoding);
+  /* 生成response_的响应头, 与内容段一起加入输出链 */
+  void AddPieces_(bool cacheable, Compressor::ENCODING encoding);
+
+  /* 从输出链当前位置发送一次 */
+  ssize_t Send_();
+  /* 从pieces_[piece]与iov_[iov]起定位下一个文件段, 映射失败时返回false */
+  bool NextFile_(size_t piece, size_t iov);
+  /* 映射当前文件段从off开始的一个窗口; 失败时关闭socket, 之后的写入
+     出错, 由reactor关闭连接 */
+  bool MapWindow_();
+  void UnmapWindow_();
+
+  /* 写缓冲区不再追加之后才能取得其中的指针, 因此最后一次性生成iov_ */
+  void BuildIov_();
+  /* 输出链写完或连接关闭: 解除文件映射, 清空写缓冲区 */
+  void ResetOutput_();
 
   StringBuffer readBuff_;   // 读缓冲区
   StringBuffer writeBuff_;  // 写缓冲区
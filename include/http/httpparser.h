@@ -0,0 +1,125 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-26
+ * @copyleft Apache 2.0
+ */
+
+#ifndef HTTP_PARSER_H_
+#define HTTP_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "base/stringpiece.h"
+
+namespace webserver {
+
+/* 增量式HTTP/1.1请求解析器: 手写状态机, 按字符类批量扫描, 不做任何拷贝。
+ * 数据不完整时记录扫描位置并返回INCOMPLETE, 收到更多数据后从上次停下的
+ * 位置继续, 不会从头重新解析。解析结果以StringPiece的形式指向调用方的
+ * 缓冲区, 内部只保存相对请求起始处的偏移量, 因此两次Parse之间缓冲区可以
+ * 扩容或搬移; 但取出的StringPiece只在缓冲区下一次被修改前有效。
+ * 解析器只负责请求行与头部, 请求体的定界与解码由BodyReader完成。 */
+class HttpParser {
+ public:
+  enum STATUS {
+    INCOMPLETE = 0,
+    COMPLETE,
+    ERROR,
+  };
+
+  static const int MAX_HEADERS = 64;
+  static const size_t MAX_HEAD_SIZE = 16 * 1024;  // 请求行+头部
+
+  HttpParser() { Reset(); }
+  ~HttpParser() = default;
+
+  /* 开始解析一个新的请求 */
+  void Reset();
+
+  /* data指向请求的起始位置, len为目前收到的全部字节数(可包含后续流水线
+     请求)。每次调用时data可以不同, 但已扫描过的内容不能改变 */
+  STATUS Parse(const char* data, size_t len);
+
+  /* 请求行与头部(含结尾空行)的字节数, 仅在COMPLETE后有效 */
+  size_t Consumed() const { return consumed_; }
+  /* 最近一次Parse的请求起始处的Consumed()个字节, 仅在COMPLETE后有效 */
+  StringPiece Head() const { return StringPiece(base_, consumed_); }
+  /* 头部已被原样复制到data处, 之后取出的StringPiece改为指向data */
+  void Rebase(const char* data) { base_ = data; }
+
+  StringPiece Method() const { return Piece_(method_); }
+  StringPiece Target() const { return Piece_(target_); }
+  StringPiece Version() const { return Piece_(version_); }  // 如"1.1"
+
+  int HeaderCount() const { return header_cnt_; }
+  StringPiece HeaderName(int i) const { return Piece_(headers_[i].name); }
+  StringPiece HeaderValue(int i) const { return Piece_(headers_[i].value); }
+  /* 字段名不区分大小写, 不存在时返回空的StringPiece */
+  StringPiece GetHeader(const StringPiece& name) const;
+
+  /* HTTP/1.1默认保持连接, 除非Connection: close; HTTP/1.0则相反 */
+  bool IsKeepAlive() const { return keep_alive_; }
+  size_t ContentLength() const { return content_length_; }
+  /* Transfer-Encoding: chunked, 此时忽略ContentLength */
+  bool IsChunked() const { return chunked_; }
+  bool HasBody() const { return chunked_ || content_length_ > 0; }
+
+ private:
+  enum STATE {
+    METHOD,
+    TARGET,
+    VERSION,
+    REQUEST_LINE_LF,
+    HEADER_START,
+    HEADER_NAME,
+    HEADER_VALUE_START,
+    HEADER_VALUE,
+    HEADER_LF,
+    HEAD_END_LF,
+    DONE,
+  };
+
+  /* [begin, begin + len) 相对请求起始处的偏移 */
+  struct Span {
+    uint32_t begin;
+    uint32_t len;
+  };
+  struct Header {
+    Span name;
+    Span value;
+  };
+
+  STATE state_;
+  size_t pos_;       // 下一个待扫描字节的偏移
+  size_t mark_;      // 当前token的起始偏移
+  size_t consumed_;  // 头部的字节数
+  const char* base_;
+
+  Span method_, target_, version_;
+  Header headers_[MAX_HEADERS];
+  int header_cnt_;
+
+  bool keep_alive_;
+  size_t content_length_;
+  bool chunked_;
+
+  StringPiece Piece_(const Span& span) const {
+    return StringPiece(base_ + span.begin, span.len);
+  }
+  static Span MakeSpan_(size_t begin, size_t end) {
+    Span span = {static_cast<uint32_t>(begin),
+                 static_cast<uint32_t>(end - begin)};
+    return span;
+  }
+
+  /* 头部解析完成后处理Connection/Content-Length/Transfer-Encoding等影响
+     报文边界的字段 */
+  bool OnHeadersComplete_();
+  /* 路径(查询串之前)中不能有".."段(含%2e的写法), 否则可以越过站点根目录 */
+  static bool SafePath_(const StringPiece& target);
+};
+
+}  // namespace webserver
+
+#endif  // HTTP_PARSER_H_
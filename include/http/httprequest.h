@@ -8,28 +8,24 @@
 #define HTTP_REQUEST_H
 
 #include <errno.h>
-#include <mysql/mysql.h>  //mysql
 
-#include <regex>
+#include <functional>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 
 #include "base/stringbuffer.h"
-#include "pool/sqlconnpool.h"
+#include "base/stringpiece.h"
+#include "http/bodyreader.h"
+#include "http/compressor.h"
+#include "http/formdata.h"
+#include "http/httpparser.h"
+#include "http/jsonparser.h"
+#include "http/router.h"
 #include "utils/logger.h"
 
 namespace webserver {
 
 class HttpRequest {
  public:
-  enum PARSE_STATE {
-    REQUEST_LINE,
-    HEADERS,
-    BODY,
-    FINISH,
-  };
-
   enum HTTP_CODE {
     NO_REQUEST = 0,
     GET_REQUEST,
@@ -39,53 +35,92 @@ class HttpRequest {
     FILE_REQUEST,
     INTERNAL_ERROR,
     CLOSED_CONNECTION,
+    PAYLOAD_TOO_LARGE,
   };
 
+  /* 请求体的流式处理: 头部解析完后以该请求调用, 返回非空的Sink时解码后的
+     请求体直接交给它(上限maxUploadSize), 例如写入磁盘, 不在内存中缓冲;
+     返回空时请求体缓冲到body()(上限maxBodySize)。在解析请求的线程中调用 */
+  typedef std::function<BodyReader::Sink(const HttpRequest& request)>
+      BodyHandler;
+
   HttpRequest() { Init(); }
   ~HttpRequest() = default;
 
   void Init();
-  bool parse(StringBuffer& buff);
+  /* 增量解析: 请求不完整时返回NO_REQUEST, 收到更多数据后再次调用即可,
+     已扫描的部分不会重新解析; 完整时返回GET_REQUEST并从buff中取走该请求,
+     格式错误返回BAD_REQUEST, 请求体超过上限返回PAYLOAD_TOO_LARGE。
+     请求体边收边解码, 已解码的字节立即从buff中取走 */
+  HTTP_CODE parse(StringBuffer& buff);
 
   std::string path() const;
   std::string& path();
-  std::string method() const;
-  std::string version() const;
+  /* 以下StringPiece指向读缓冲区(有请求体或调用过KeepHead时指向头部的
+     副本), 只在下一次读入数据(或解析下一个请求)前有效 */
+  StringPiece method() const;
+  StringPiece version() const;
+  StringPiece GetHeader(const char* name) const;
+  /* 按Accept-Encoding协商出的响应编码 */
+  Compressor::ENCODING AcceptedEncoding() const;
+  /* 表单字段的值, 没有表单时取JSON对象中同名的字符串成员, 都没有时为空 */
   std::string GetPost(const std::string& key) const;
   std::string GetPost(const char* key) const;
+  /* 缓冲在内存中的请求体, 流式处理时为空 */
+  const std::string& body() const { return body_; }
+  /* urlencoded与multipart/form-data请求体解码后的字段, 以及JSON请求体
+     的token, 在解析下一个请求前有效 */
+  const FormData& form() const { return form_; }
+  const JsonParser& json() const { return json_; }
+  /* 路由匹配到的路径参数, 指向path(), 处理者改写path()后失效 */
+  Router::Params& params() { return params_; }
+  const Router::Params& params() const { return params_; }
+  /* 名为name的路径参数, 没有时为空 */
+  StringPiece Param(const StringPiece& name) const;
 
   bool IsKeepAlive() const;
-
-  /*
-  todo
-  void HttpConn::ParseFormData() {}
-  void HttpConn::ParseJson() {}
-  */
+  /* 头部已解析完, 请求体还没有收完 */
+  bool InBody() const { return inBody_; }
+  /* 把头部复制到请求自己的存储中, 之后读缓冲区的改动不再影响GetHeader
+     等; 请求交给异步处理者之前调用, 它可能在其它线程中读取头部 */
+  void KeepHead();
+  /* 客户端带有Expect: 100-continue并在等待回复时返回true, 每个请求只返回
+     一次, 调用者随即回复100 Continue */
+  bool TakeContinue();
+
+  /* 缓冲与流式处理的请求体上限, 在WebServer的构造函数中初始化 */
+  static size_t maxBodySize;
+  static size_t maxUploadSize;
+  /* 为空时所有请求体都缓冲在内存中, 需在服务器启动前设置 */
+  static BodyHandler bodyHandler;
+  /* multipart/form-data中文件字段的临时目录 */
+  static std::string uploadDir;
 
  private:
-  /* 以下三个函数用于解析http报文，先处理 RequestLine，若处理成功将 PARSE_STATE
-     从 REQUEST_LINE 转为 HEADERS。headers解析成功则将 PARSE_STATE 转为 BODY, 
-     继续处理请求主体body。http报文处理完毕的标志是FINISH。*/
-    
-  bool ParseRequestLine_(const std::string& line);
-  void ParseHeader_(const std::string& line);
-  void ParseBody_(const std::string& line);
-
-  void ParsePath_();
-  void ParsePost_();
-  void ParseFromUrlencoded_();
-
-  static bool UserVerify(const std::string& name, const std::string& pwd,
-                         bool isLogin);
-
-  PARSE_STATE state_;
-  std::string method_, path_, version_, body_;
-  std::unordered_map<std::string, std::string> header_;
-  std::unordered_map<std::string, std::string> post_;
-
-  static const std::unordered_set<std::string> DEFAULT_HTML;
-  static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
-  static int ConverHex(char ch);
+  /* 头部解析完成后开始读取请求体 */
+  void StartBody_(StringBuffer& buff);
+  /* 按Content-Type解码已收完的请求体, 格式错误时返回false */
+  bool ParsePost_();
+  /* Content-Type中的媒体类型 */
+  StringPiece ContentType_() const;
+
+  HttpParser parser_;
+  bool finished_;    // 上一个请求已解析完, 下次parse前需要Init
+  bool keep_alive_;  // 请求取走后仍需要, 不能依赖指向缓冲区的StringPiece
+  bool inBody_;
+  bool expectContinue_;
+  bool streamed_;  // 请求体交给了bodyHandler返回的Sink
+  std::string path_, body_;
+  /* 头部的副本: 有请求体时读缓冲区随后会被请求体覆盖, 异步处理者完成之前
+     读缓冲区可能扩容或搬移 */
+  std::string head_;
+  BodyReader reader_;
+  FormData form_;  // 指向body_, 声明在其后以便先于body_析构
+  JsonParser json_;
+  Router::Params params_;
+
+  /* 解析完一个请求后保留的body_容量上限 */
+  static const size_t BODY_KEEP = 64 * 1024;
 };
 
 }  // namespace webserver
@@ -7,52 +7,124 @@
 #ifndef HTTP_RESPONSE_H
 #define HTTP_RESPONSE_H
 
-#include <fcntl.h>     // open
-#include <sys/mman.h>  // mmap, munmap
 #include <sys/stat.h>  // stat
-#include <unistd.h>    // close
 
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "base/stringbuffer.h"
+#include "base/stringpiece.h"
+#include "http/compressor.h"
+#include "http/filecache.h"
 #include "utils/logger.h"
 
 namespace webserver {
 
 class HttpResponse {
  public:
+  /* 响应内容的一段: data非空时为内存, fd>=0时也可从文件的off处发送,
+     两者都有时任选其一, 只有fd的是流式发送的大文件; 两者都没有时是
+     写缓冲区可读部分中[off, off+len)的分段头 */
+  struct Segment {
+    const char* data;
+    int fd;
+    size_t off;
+    size_t len;
+  };
+
+  static const size_t MAX_RANGES = 16;  // 更多的范围按整个文件回复
+  /* "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n", 紧跟在状态行之后, 缓存的
+     完整响应发送时据此换成当前时间 */
+  static const size_t DATE_LINE_LEN = 37;
+
   HttpResponse();
   ~HttpResponse();
 
+  /* encoding为协商出的编码, 文件不可压缩时仍以原文发送 */
   void Init(const std::string& srcDir, std::string& path,
-            bool isKeepAlive = false, int code = -1);
+            bool isKeepAlive = false, int code = -1,
+            Compressor::ENCODING encoding = Compressor::IDENTITY);
+  /* 条件请求的If-None-Match/If-Modified-Since, 匹配时以304回复;
+     两者指向读缓冲区, 须在MakeResponse之前保持有效 */
+  void SetConditional(const StringPiece& ifNoneMatch,
+                      const StringPiece& ifModifiedSince);
+  /* Range/If-Range, 只对原文生效; 生命周期要求同SetConditional */
+  void SetRange(const StringPiece& range, const StringPiece& ifRange);
+  /* 以下供路由的处理者在MakeResponse之前调用: 改为回复另一个静态文件
+     (相对srcDir), 以code回复错误页面, 或直接给出内容(不压缩、不缓存,
+     不处理条件与范围请求) */
+  void SetPath(const std::string& path);
+  void SetCode(int code) { code_ = code; }
+  void SetContent(int code, std::string content,
+                  const char* contentType = "text/plain");
+  bool HasContent() const { return content_ != nullptr; }
+  const std::string& Path() const { return path_; }
+  /* srcDir与Path()拼成的完整路径, 也是文件缓存与响应缓存的键 */
+  const std::string& FullPath() const { return fullPath_; }
   void MakeResponse(StringBuffer& buff);
+  /* 释放对文件缓存条目、压缩内容及生成内容的引用 */
   void UnmapFile();
-  char* File();
-  size_t FileLen() const;
-  void ErrorContent(StringBuffer& buff, std::string message);
+
+  /* 完整的响应内容: 文件映射或压缩后的数据 */
+  const char* Body() const;
+  size_t BodyLen() const;
+  /* MakeResponse写入buff的响应头长度, 不含多段响应的分段头 */
+  size_t HeadLen() const { return headLen_; }
+  /* 依次发送的内容段, 下一次Init前有效 */
+  const std::vector<Segment>& Segments() const { return segments_; }
+  /* 交出内容的引用, 输出链持有它直到响应发送完毕 */
+  std::shared_ptr<const void> DetachBody();
+  /* 文件版本, 用于缓存整个响应 */
+  const FileCache::EntryPtr& FileEntry() const { return file_; }
+  void ErrorContent(StringBuffer& buff, const char* message);
   int Code() const { return code_; }
 
+  /* code的状态行长度, 即Date行在响应中的偏移 */
+  static size_t DateOffset(int code);
+  /* 当前时间的Date行, 每秒格式化一次 */
+  static void AddDate(StringBuffer& buff);
+
  private:
   void AddStateLine_(StringBuffer& buff);
   void AddHeader_(StringBuffer& buff);
   void AddContent_(StringBuffer& buff);
+  void AddRanges_(StringBuffer& buff);
 
   void ErrorHtml_();
-  std::string GetFileType_();
+  const char* GetFileType_();
+  /* tag(带引号)是否与encoding表示的强ETag相同 */
+  bool MatchETag_(StringPiece tag, Compressor::ENCODING encoding) const;
+  bool NotModified_() const;
+  /* If-Range与当前版本一致(或没有If-Range)时Range才生效 */
+  bool RangeApplies_() const;
+  /* 解析出可满足的范围存入ranges_; 语法错误或范围过多时返回false,
+     按没有Range处理 */
+  bool ParseRanges_();
+  /* path_或srcDir_改变后重新拼出fullPath_ */
+  void UpdateFullPath_();
+  /* 写入多段响应的分隔符, 由文件版本决定 */
+  void AddBoundary_(StringBuffer& buff) const;
 
   int code_;
   bool isKeepAlive_;
 
   std::string path_;
   std::string srcDir_;
+  std::string fullPath_;  // srcDir_ + path_
 
-  char* mmFile_;
-  struct stat mmFileStat_;
-
-  static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;
-  static const std::unordered_map<int, std::string> CODE_STATUS;
-  static const std::unordered_map<int, std::string> CODE_PATH;
+  FileCache::EntryPtr file_;  // 内容为空时仍保留, 用于Content-type
+  Compressor::ENCODING encoding_;
+  StringPiece ifNoneMatch_;
+  StringPiece ifModifiedSince_;
+  StringPiece range_;
+  StringPiece ifRange_;
+  std::vector<std::pair<size_t, size_t>> ranges_;  // 闭区间[first, second]
+  std::vector<Segment> segments_;
+  size_t headStart_;
+  size_t headLen_;
+  std::shared_ptr<const std::string> encoded_;  // 压缩后的内容
+  std::shared_ptr<const std::string> content_;  // 处理者给出的内容
+  const char* contentType_;
 };
 
 }  // namespace webserver
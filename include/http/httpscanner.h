@@ -0,0 +1,67 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-03
+ * @copyleft Apache 2.0
+ */
+
+#ifndef HTTP_SCANNER_H_
+#define HTTP_SCANNER_H_
+
+namespace webserver {
+
+/* HTTP报文的字符分类扫描, 供HttpParser与请求体解码使用。每个函数返回
+ * [begin, end)中第一个"停止字符"的位置, 没有则返回end。停止字符既是分隔符
+ * 也是非法字符, 由调用方判断, 因此查找分隔符与校验字符在同一次扫描中完成:
+ *   FindTokenEnd   第一个非tchar字节(方法名、头部字段名, 正常应停在' '或':')
+ *   FindTargetEnd  第一个空白或控制字符(请求目标, 正常应停在' ')
+ *   FindValueEnd   第一个除HTAB外的控制字符(字段值, 正常应停在CR或LF)
+ *   FindFormEscape 第一个'%'或'+'(表单的URL解码)
+ *   FindJsonStop   第一个'"'、'\\'或控制字符(JSON字符串)
+ * 启动时根据CPU选择AVX2(32字节)、SSSE3(16字节)或逐字节查表的实现 */
+class HttpScanner {
+ public:
+  enum LEVEL {
+    SCALAR = 0,
+    SSSE3,
+    AVX2,
+  };
+
+  static const char* FindTokenEnd(const char* begin, const char* end) {
+    return impl_.token(begin, end);
+  }
+  static const char* FindTargetEnd(const char* begin, const char* end) {
+    return impl_.target(begin, end);
+  }
+  static const char* FindValueEnd(const char* begin, const char* end) {
+    return impl_.value(begin, end);
+  }
+  static const char* FindFormEscape(const char* begin, const char* end) {
+    return impl_.escape(begin, end);
+  }
+  static const char* FindJsonStop(const char* begin, const char* end) {
+    return impl_.json(begin, end);
+  }
+
+  static LEVEL Level() { return impl_.level; }
+  static const char* LevelName();
+
+  /* 使用不超过maxLevel且CPU支持的实现, 返回实际使用的级别(用于测试) */
+  static LEVEL Use(LEVEL maxLevel);
+
+ private:
+  typedef const char* (*ScanFunc)(const char*, const char*);
+  struct Impl {
+    LEVEL level;
+    ScanFunc token;
+    ScanFunc target;
+    ScanFunc value;
+    ScanFunc escape;
+    ScanFunc json;
+  };
+
+  static Impl impl_;
+};
+
+}  // namespace webserver
+
+#endif  // HTTP_SCANNER_H_
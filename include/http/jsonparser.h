@@ -0,0 +1,81 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-17
+ * @copyleft Apache 2.0
+ */
+
+#ifndef JSON_PARSER_H_
+#define JSON_PARSER_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "base/stringpiece.h"
+
+namespace webserver {
+
+/* JSON请求体(RFC 8259)的解析, 结果是按出现顺序排列的扁平token数组:
+ * 对象之后依次是 键, 值, 键, 值...; 数组之后依次是各元素。字符串原地去掉
+ * 转义, token以StringPiece指向输入, 不为单个值分配内存, token数组在请求
+ * 之间复用。不递归, 嵌套深度不超过MAX_DEPTH。
+ * 例如 {"a":[1,2],"b":true} 得到
+ *   0 OBJECT size=2  1 STRING "a"  2 ARRAY size=2  3 NUMBER 1  4 NUMBER 2
+ *   5 STRING "b"  6 BOOLEAN true */
+class JsonParser {
+ public:
+  enum TYPE {
+    OBJECT = 0,
+    ARRAY,
+    STRING,
+    NUMBER,
+    BOOLEAN,
+    NUL,
+  };
+
+  struct Token {
+    TYPE type;
+    StringPiece text;  // 字符串为去掉转义后的内容, 其它为原文
+    int size;          // 对象的成员数或数组的元素数
+    int next;          // 该值(含所有子值)之后的下一个token, 用于跳过兄弟节点
+  };
+
+  static const int MAX_DEPTH = 64;
+
+  JsonParser() = default;
+  ~JsonParser() = default;
+
+  void Reset();
+  /* 解析整个[data, data + len), 会修改data, token在data有效期间可用。
+     格式错误(包括结尾多余的内容)返回false */
+  bool Parse(char* data, size_t len);
+
+  int Count() const { return static_cast<int>(tokens_.size()); }
+  const Token& operator[](int i) const { return tokens_[i]; }
+  /* 对象中键为key的值的下标, 没有或object不是对象时返回-1 */
+  int Find(int object, const StringPiece& key) const;
+
+ private:
+  enum STATE {
+    VALUE,  // 期待一个值
+    FIRST,  // 刚进入对象或数组, 可能立即结束
+    KEY,    // 期待对象的键
+    AFTER,  // 一个值结束, 期待','、结束符或输入结束
+  };
+
+  /* 解析完一个请求后保留的token数组容量上限 */
+  static const size_t TOKENS_KEEP = 4096;
+
+  std::vector<Token> tokens_;
+  std::vector<int> stack_;  // 未结束的对象与数组
+
+  /* 添加token, 值位于数组中或作为对象的键时计入父节点的size */
+  void Push_(TYPE type, const char* begin, size_t len, bool isKey);
+  /* p指向'"', 原地去掉转义, 成功后p指向结束引号之后 */
+  static bool ParseString_(char*& p, char* end, StringPiece* out);
+  static bool ParseNumber_(char*& p, char* end);
+};
+
+}  // namespace webserver
+
+#endif  // JSON_PARSER_H_
@@ -0,0 +1,112 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-11
+ * @copyleft Apache 2.0
+ */
+
+#ifndef RESPONSE_CACHE_H_
+#define RESPONSE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/uncopyable.h"
+#include "http/compressor.h"
+#include "http/filecache.h"
+
+namespace webserver {
+
+/* Count-Min Sketch估计访问频率, 计数器上限为15。累计采样数达到
+   计数器个数的10倍时所有计数减半, 使频率随时间衰减 */
+class FrequencySketch {
+ public:
+  explicit FrequencySketch(size_t width);
+
+  void Increment(uint64_t hash);
+  int Estimate(uint64_t hash) const;
+
+ private:
+  static const int DEPTH = 4;
+  static const int MAX_COUNT = 15;
+
+  size_t Index_(uint64_t hash, int row) const;
+  void Age_();
+
+  size_t mask_;
+  size_t samples_;
+  size_t sampleLimit_;
+  std::vector<uint8_t> table_;  // DEPTH行, 每行width个计数器
+};
+
+/* 小文件完整响应(状态行+头部+内容连续存放)的缓存, 按keep-alive与否及
+ * 协商出的编码分别保存变体, 命中时输出链直接引用共享的内存, 一次send即可发出。
+ * 与FileCache一样按路径哈希分片加锁, 各分片有独立的字节预算、LRU与
+ * 频率估计, 不同Reactor访问不同路径时互不等待。
+ * 预算采用TinyLFU准入: 分片预算不足时新响应只有在估计频率高于LRU尾部
+ * 的受害者时才会替换它, 因此大量只访问一次的文件(如爬虫遍历)不会冲掉
+ * 热点。条目记录生成时的FileCache条目, 文件变化后自动失效 */
+class ResponseCache : private Uncopyable {
+ public:
+  typedef std::shared_ptr<const std::string> ResponsePtr;
+
+  static const int SHARDS = 16;
+  static const size_t MAX_BYTES = 16 * 1024 * 1024;  // 所有分片合计
+  static const size_t MAX_OBJECT = FileCache::FD_MIN;  // 更大的文件走sendfile
+
+  explicit ResponseCache(size_t maxBytes, int shards = SHARDS);
+  static ResponseCache* Instance();
+
+  /* file为该路径当前的FileCache条目, 与缓存时不同则视为未命中 */
+  ResponsePtr Get(const std::string& path, bool keepAlive,
+                  Compressor::ENCODING encoding,
+                  const FileCache::EntryPtr& file);
+  /* 由响应头与内容(原文或压缩结果)拼成完整响应并尝试加入缓存,
+     未被准入时返回空 */
+  ResponsePtr Put(const std::string& path, bool keepAlive,
+                  Compressor::ENCODING encoding,
+                  const FileCache::EntryPtr& file, const char* head,
+                  size_t headLen, const char* body, size_t bodyLen);
+
+  size_t Bytes() const;
+  void Clear();
+
+ private:
+  static const size_t SKETCH_WIDTH = 4096;  // 所有分片合计
+
+  struct Node {
+    FileCache::EntryPtr file;
+    /* [keep-alive][编码] */
+    ResponsePtr variant[2][Compressor::ENCODINGS];
+    size_t bytes;
+    std::list<std::string>::iterator lru;
+  };
+  struct Shard {
+    Shard(size_t maxBytes, size_t sketchWidth)
+        : maxBytes(maxBytes), bytes(0), sketch(sketchWidth) {}
+    mutable std::mutex mtx;
+    size_t maxBytes;
+    size_t bytes;
+    FrequencySketch sketch;
+    std::unordered_map<std::string, Node> nodes;
+    std::list<std::string> lru;  // 头部为最近使用
+  };
+
+  static uint64_t Hash_(const std::string& path);
+  Shard& ShardOf_(uint64_t hash);
+  static void Drop_(Shard& shard, Node& node);
+  static bool MakeRoom_(Shard& shard, const std::string& path, uint64_t hash,
+                        size_t bytes);
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+}  // namespace webserver
+
+#endif  // RESPONSE_CACHE_H_
@@ -0,0 +1,142 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-18
+ * @copyleft Apache 2.0
+ */
+
+#ifndef ROUTER_H_
+#define ROUTER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/stringpiece.h"
+#include "base/uncopyable.h"
+
+namespace webserver {
+
+class HttpRequest;
+class HttpResponse;
+
+/* 请求路径到处理者的路由, 所有路由组成一棵基数树(公共前缀合并), 一次
+ * 分发只需沿树向下走一遍。路由模式由三种段组成:
+ *   /index.html      精确匹配的静态部分
+ *   /api/users/:id   参数段, 匹配一个'/'之间的非空段, 记为参数id
+ *   *file            通配段, 只能位于末尾的'/'之后, 匹配余下的全部(可为空)
+ * 同一位置静态部分优先于参数段, 参数段优先于通配段, 优先的分支最终没有
+ * 匹配时回退尝试下一种。每个节点按方法分别保存处理者, ANY匹配其余方法。
+ * 没有匹配的路由时由HttpConn按请求路径回复静态文件。
+ * 路由须在服务器启动前注册, 之后只读, 各线程并发分发不加锁 */
+class Router : private Uncopyable {
+ public:
+  enum METHOD {
+    GET = 0,
+    HEAD,
+    POST,
+    PUT,
+    DELETE,
+    PATCH,
+    OPTIONS,
+    ANY,  // 注册时表示所有方法
+    METHOD_COUNT,
+  };
+
+  /* 参数段与通配段匹配到的值, name指向路由树, value指向请求路径 */
+  struct Param {
+    StringPiece name;
+    StringPiece value;
+  };
+  typedef std::vector<Param> Params;
+
+  /* 处理者读取请求(路径参数、表单、JSON等)并通过response给出回复:
+     SetPath改为回复另一个静态文件, SetContent生成内容, SetCode回复错误
+     页面; 都不调用时回复与请求路径同名的静态文件 */
+  typedef std::function<void(HttpRequest& request, HttpResponse& response)>
+      Handler;
+  /* 异步处理者的完成通知, 可在任意线程中调用, 每个请求恰好调用一次 */
+  typedef std::function<void()> Done;
+  /* 异步处理者只发起操作(如把数据库查询交给其它线程)就返回, 之后在任意
+     线程中填好response再调用done; 调用done之前request与response一直
+     有效, 调用之后不能再访问。同一连接上之后的流水线请求等它完成再处理 */
+  typedef std::function<void(HttpRequest& request, HttpResponse& response,
+                             const Done& done)>
+      AsyncHandler;
+
+  /* Dispatch的结果 */
+  enum RESULT {
+    NO_ROUTE = 0,  // 没有匹配的路由
+    HANDLED,       // 处理者已给出回复
+    PENDING,       // 异步处理者将在调用done时给出回复
+  };
+
+  static Router* Instance();
+
+  /* 注册处理者, 模式不合法或与已有路由冲突时返回false。inlineable为false
+     的处理者(可能阻塞, 如访问数据库)不在Reactor线程中调用 */
+  bool Handle(METHOD method, const std::string& pattern, Handler handler,
+              bool inlineable = false);
+  /* 注册异步处理者, 它不会阻塞, 总是可以在Reactor线程中调用 */
+  bool HandleAsync(METHOD method, const std::string& pattern,
+                   AsyncHandler handler);
+  /* 以静态文件file回复所有方法; 模式以通配段结尾时file为目录, 通配段
+     匹配到的部分接在其后 */
+  bool Static(const std::string& pattern, const std::string& file);
+
+  /* 按方法和路径(不含查询串)查找并调用处理者, 参数存入request.params();
+     匹配到异步处理者时把done交给它并返回PENDING */
+  RESULT Dispatch(HttpRequest& request, HttpResponse& response,
+                  const Done& done = nullptr) const;
+  /* 请求行为method target的请求能否在Reactor线程中处理: 没有匹配的路由
+     或处理者注册为inlineable */
+  bool IsInlineable(const StringPiece& method,
+                    const StringPiece& target) const;
+
+  /* 方法名对应的METHOD, 不认识的方法返回ANY(只匹配以ANY注册的路由) */
+  static METHOD ToMethod(const StringPiece& method);
+
+ private:
+  Router();
+  ~Router();
+
+  /* 同步处理者也以AsyncHandler保存, 忽略done */
+  struct Route {
+    AsyncHandler handler;
+    bool async;
+    bool inlineable;
+  };
+
+  enum NODE_TYPE {
+    STATIC,
+    PARAM,
+    WILDCARD,
+  };
+
+  struct Node {
+    NODE_TYPE type;
+    std::string prefix;   // 静态节点合并后的字符, 参数与通配节点为参数名
+    std::string indices;  // 各静态子节点prefix的首字符, 与children对应
+    std::vector<std::unique_ptr<Node>> children;
+    std::unique_ptr<Node> param;
+    std::unique_ptr<Node> wildcard;
+    Route routes[METHOD_COUNT];  // 在此结束的路由, handler为空表示没有
+  };
+
+  std::unique_ptr<Node> root_;
+
+  /* 找到或建立pattern对应的节点, 冲突时返回nullptr */
+  Node* Insert_(StringPiece pattern);
+  /* 从node开始匹配path, 失败时回退并恢复params */
+  const Route* Match_(const Node* node, StringPiece path, METHOD method,
+                      Params* params) const;
+  /* 注册路由的公共部分, 模式不合法或冲突时返回false */
+  bool Add_(METHOD method, const std::string& pattern, AsyncHandler handler,
+            bool async, bool inlineable);
+  static const Route* RouteOf_(const Node* node, METHOD method);
+  static bool Validate_(const std::string& pattern);
+};
+
+}  // namespace webserver
+
+#endif  // ROUTER_H_
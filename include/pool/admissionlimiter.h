@@ -0,0 +1,64 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-12
+ * @copyleft Apache 2.0
+ */
+
+#ifndef ADMISSION_LIMITER_H_
+#define ADMISSION_LIMITER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace webserver {
+
+/* 自适应并发限制(AIMD): 以线程池中任务的排队时延作为拥塞信号。
+ * 排队时延不超过目标值且并发接近上限时, 每完成约limit个任务上限加1;
+ * 超过目标值时上限乘以BACKOFF, 同一个平滑时延(约一个RTT)内最多收缩一次。
+ * 超出上限的任务由调用方直接拒绝(503), 而不是继续在队列中堆积。 */
+class AdmissionLimiter {
+ public:
+  AdmissionLimiter(int minLimit, int maxLimit, int initLimit,
+                   int targetDelayMS);
+  ~AdmissionLimiter() = default;
+
+  /* 线程安全: 未超过并发上限时占用一个名额并返回true */
+  bool TryAcquire();
+
+  /* 线程安全: 任务完成后归还名额, queueUs为排队时延, latencyUs为总时延 */
+  void Release(int64_t queueUs, int64_t latencyUs);
+
+  int Limit() const { return limit_; }
+  int InFlight() const { return inflight_; }
+  uint64_t Rejected() const { return rejected_; }
+  int64_t LatencyUs() const { return latency_us_; }  // 总时延的滑动平均
+
+  AdmissionLimiter(const AdmissionLimiter&) = delete;
+  AdmissionLimiter& operator=(const AdmissionLimiter&) = delete;
+
+ private:
+  static constexpr double BACKOFF = 0.9;
+  static const int EMA_WEIGHT = 16;  // 滑动平均的权重为1/16
+
+  using SteadyClock = std::chrono::steady_clock;
+
+  const int min_limit_;
+  const int max_limit_;
+  const int64_t target_us_;
+
+  std::atomic<int> inflight_;
+  std::atomic<int> limit_;
+  std::atomic<uint64_t> rejected_;
+  std::atomic<int64_t> latency_us_;
+
+  /* 以下成员由mtx_保护 */
+  std::mutex mtx_;
+  double limit_f_;  // 加性增长需要小数精度
+  SteadyClock::time_point last_backoff_;
+};
+
+}  // namespace webserver
+
+#endif  // ADMISSION_LIMITER_H_
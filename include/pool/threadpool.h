@@ -7,14 +7,18 @@
 #ifndef THREADPOOL_H_
 #define THREADPOOL_H_
 
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
 
+#include "pool/admissionlimiter.h"
+
 namespace webserver {
 
 class ThreadPool {
@@ -27,7 +31,8 @@ class ThreadPool {
   */
   using Task = std::function<void()>;
 
-  explicit ThreadPool(size_t n_threads);
+  /* maxQueueDelayMS > 0 时开启自适应准入控制, 见TryAddTask */
+  explicit ThreadPool(size_t n_threads, int maxQueueDelayMS = 0);
 
   ~ThreadPool();
 
@@ -36,6 +41,13 @@ class ThreadPool {
    */
   void AddTask(Task &&task);
 
+  /* 带准入控制的AddTask: 并发超过自适应上限时不入队并返回false,
+     由调用方快速失败; 未开启准入控制时等同于AddTask */
+  bool TryAddTask(Task &&task);
+
+  /* 未开启准入控制时返回nullptr */
+  const AdmissionLimiter *Limiter() const { return limiter_.get(); }
+
   /* 拷贝构造函数，并且取消默认父类构造函数 */
   ThreadPool(const ThreadPool &) = delete;
 
@@ -49,17 +61,35 @@ class ThreadPool {
   ThreadPool &operator=(const ThreadPool &&) = delete;
 
  private:
+  using SteadyClock = std::chrono::steady_clock;
+
+  /* 队列中的任务, 受准入控制的任务同时记录入队时间, 由工作线程计算时延,
+     不必再用一层闭包包装Task(那样每个任务都要多一次堆分配) */
+  struct Item {
+    Task task;
+    bool admitted;
+    SteadyClock::time_point enqueue;
+  };
+
   /* Pool的成员closed和tasks需要加锁访问 */
   struct Pool {
     bool closed;
     std::mutex mtx;
     std::condition_variable cv;
-    std::queue<Task> tasks;
+    std::queue<Item> tasks;
     Pool(bool status = false) : closed(false) {}
   };
 
+  /* 并发上限的范围: 下限为线程数, 初始为线程数的INIT_LIMIT_RATIO倍 */
+  static const int INIT_LIMIT_RATIO = 4;
+  static const int MAX_LIMIT = 4096;
+
   std::shared_ptr<Pool> pool_;
   std::list<std::thread> workers_;
+  std::unique_ptr<AdmissionLimiter> limiter_;
+
+  void Push_(Item &&item);
+  void RunItem_(Item &item);
 };
 
 }  // namespace webserver
@@ -0,0 +1,89 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-15
+ * @copyleft Apache 2.0
+ */
+
+#ifndef EPOLL_REACTOR_H_
+#define EPOLL_REACTOR_H_
+
+#include "base/epoller.h"
+#include "base/fdslab.h"
+#include "http/httpconnection.h"
+#include "server/reactor.h"
+
+namespace webserver {
+
+/* 基于epoll的Reactor: 事件就绪后把连接交给线程池(快速路径下在本线程)处理。
+ * 同一时刻只有一个线程持有某个连接(见EpollConn), 因此ET模式下连接只在
+ * accept时以EPOLLIN|EPOLLOUT|EPOLLET注册一次, 之后不再调用epoll_ctl;
+ * LT模式下仍以EPOLLONESHOT注册, 每次等待读写时重新注册。
+ * 开启快速路径后, 静态小文件请求在本线程内完成, 只有POST和大文件交给线程池 */
+class EpollReactor : public Reactor {
+ public:
+  EpollReactor(int timeoutMS, uint32_t connEvent, ThreadPool* threadpool);
+  ~EpollReactor() = default;
+
+  bool AddListener(int listenFd, uint32_t listenEvent,
+                   const AcceptCallback& cb = nullptr) override;
+  void Loop() override;
+
+ private:
+  /* 连接的所有权: 事件到达时先记入events, 抢到busy的线程成为持有者,
+     持有者处理完后释放busy, 若期间又有新事件则重新抢占继续处理。
+     事件不会丢失, 也不会有两个线程同时处理同一个连接 */
+  struct EpollConn {
+    HttpConn conn;
+    std::atomic<bool> busy;
+    std::atomic<uint32_t> events;
+    int fd;           // 由事件循环线程在accept时写入, 用作定时器的键
+    int released_fd;  // 持有者关闭连接后待close的fd, 仅持有者访问
+    bool hangup;      // 异步处理者完成后再关闭, 仅持有者访问
+    EpollConn()
+        : busy(false), events(0), fd(-1), released_fd(-1), hangup(false) {}
+  };
+
+  uint32_t listen_event_;
+  uint32_t conn_event_;
+  bool persistent_;  // ET模式下持久注册, 不使用EPOLLONESHOT
+
+  std::unique_ptr<Epoller> epoller_;
+  FdSlab<EpollConn>* users_;  // 以sockfd为下标的http连接表, 所有Reactor共享
+
+  static FdSlab<EpollConn>* ConnTable_();
+
+  void AddClient_(int fd, sockaddr_in addr) override;
+  void RemoveListener_() override;
+
+  void DealListen_();
+  void DealWakeup_();
+
+  void ExtentTime_(EpollConn* client);
+  void Expire_(EpollConn* client);
+  /* 异步处理者调用done后在事件循环线程中执行, 以EPOLLOUT交回持有者 */
+  void Complete_(EpollConn* client);
+
+  /* 记录事件并尝试取得所有权, 取得后在本线程或线程池中处理 */
+  void Dispatch_(EpollConn* client, uint32_t events);
+  /* 持有者的处理循环, onLoop表示是否运行在事件循环线程中 */
+  void Run_(EpollConn* client, bool onLoop);
+  /* 处理一批事件, 所有权移交给线程池时返回false */
+  bool Handle_(EpollConn* client, uint32_t events, bool onLoop);
+  /* 发送响应并处理缓冲区中的请求, 直到需要等待读写事件 */
+  bool Progress_(EpollConn* client, bool onLoop);
+  /* 接着读取上次因READ_BUDGET停下的数据, 不需要时等待EPOLLIN并返回false */
+  bool ReadMore_(EpollConn* client);
+  /* 把所有权移交给线程池, gated时受准入控制, 被拒绝时返回503并关闭连接;
+     移交成功返回false */
+  bool Offload_(EpollConn* client, bool gated);
+  /* 等待读/写事件, 只有EPOLLONESHOT模式需要重新注册 */
+  void Rearm_(EpollConn* client, uint32_t events);
+  /* 由持有者调用, fd在释放所有权之后才真正close; 异步处理者还没完成时
+     只记下hangup, 完成后再关闭 */
+  void CloseConn_(EpollConn* client);
+  void FinishClose_(int fd);
+};
+
+}  // namespace webserver
+
+#endif  // EPOLL_REACTOR_H_
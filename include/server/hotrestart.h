@@ -0,0 +1,63 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-05
+ * @copyleft Apache 2.0
+ */
+
+#ifndef HOT_RESTART_H_
+#define HOT_RESTART_H_
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+namespace webserver {
+
+/* 热重启(平滑升级): 旧进程收到信号后fork并exec磁盘上最新的可执行文件,
+ * 通过Unix域socket以SCM_RIGHTS把监听socket交给新进程, 新进程初始化完成
+ * 后回复一个字节, 旧进程随即停止accept并等待已有连接处理完毕后退出。
+ * 新进程通过环境变量ENV_NAME得知自己是被旧进程拉起的。 */
+class HotRestart {
+ public:
+  static constexpr const char* ENV_NAME = "ORION_UPGRADE_FD";
+
+  explicit HotRestart(int signo = SIGUSR2);
+  ~HotRestart();
+
+  /* 新进程: 从旧进程接收监听socket, 不是被热重启拉起或接收失败时返回false */
+  bool TakeListenFds(std::vector<int>* fds);
+
+  /* 新进程: 初始化完成, 通知旧进程停止accept */
+  void NotifyReady();
+
+  /* 旧进程: 阻塞等待升级信号, Interrupt()被调用时返回false */
+  bool WaitSignal();
+  void Interrupt();
+
+  /* 旧进程: 拉起新进程并传递fds, 在timeoutMS内收到就绪通知才返回true,
+     否则结束新进程, 旧进程继续服务 */
+  bool Spawn(const std::vector<int>& fds, int timeoutMS);
+
+  HotRestart(const HotRestart&) = delete;
+  HotRestart& operator=(const HotRestart&) = delete;
+
+ private:
+  static const int MAX_FDS = 64;  // 一次最多传递的fd数量
+  static int sig_pipe_[2];        // 信号处理函数只做一次write, 由WaitSignal读取
+
+  int signo_;
+  int channel_fd_;  // 新进程中与旧进程通信的socket, -1表示不是热重启拉起
+  std::string exe_path_;           // 可执行文件路径, 升级时exec同一路径
+  std::vector<std::string> args_;  // 原始命令行参数
+
+  static void OnSignal_(int signo);
+  static bool SendFds_(int sock, const std::vector<int>& fds);
+  static bool RecvFds_(int sock, std::vector<int>* fds);
+};
+
+}  // namespace webserver
+
+#endif  // HOT_RESTART_H_
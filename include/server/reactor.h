@@ -0,0 +1,122 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-08
+ * @copyleft Apache 2.0
+ */
+
+#ifndef REACTOR_H_
+#define REACTOR_H_
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>  // eventfd()
+#include <sys/socket.h>
+#include <unistd.h>  // close()
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "base/timingwheel.h"
+#include "pool/threadpool.h"
+#include "utils/logger.h"
+
+namespace webserver {
+
+/* 一个Reactor即一个事件循环(one loop per thread), 独占自己的I/O多路复用器、
+ * 定时器(TimingWheel)和连接表。单Reactor模式下它同时负责监听socket；多Reactor
+ * 模式下由主Reactor accept并通过QueueConn()把连接分发给各个子Reactor。
+ * 具体的I/O后端(epoll/io_uring)由子类实现。 */
+class Reactor {
+ public:
+  /* accept到新连接后的回调, 默认由本Reactor接管, 主Reactor用它来分发连接 */
+  using AcceptCallback = std::function<void(int fd, const sockaddr_in& addr)>;
+
+  /* 可选的I/O后端 */
+  enum IO_BACKEND {
+    EPOLL = 0,
+    IO_URING,
+  };
+
+  // 最大的 文件描述符(File Descriptor)数量
+  static const int MAX_FD = 65536;
+
+  /* 当前内核能否使用backend */
+  static bool Supported(int backend);
+
+  /* 按backend创建Reactor, io_uring不可用时退回epoll; 调用者应先以
+     Supported确定实际使用的后端, 这里的警告可能早于日志初始化 */
+  static Reactor* Create(int backend, int timeoutMS, uint32_t connEvent,
+                         ThreadPool* threadpool);
+
+  Reactor(int timeoutMS, ThreadPool* threadpool);
+  virtual ~Reactor();
+
+  /* 在本Reactor上注册监听socket, cb为空时连接由本Reactor处理 */
+  virtual bool AddListener(int listenFd, uint32_t listenEvent,
+                           const AcceptCallback& cb = nullptr) = 0;
+
+  /* 运行事件循环, 直到Stop()被调用 */
+  virtual void Loop() = 0;
+  void Stop();
+
+  /* 线程安全: 将task投递到本Reactor的事件循环线程中执行 */
+  void RunInLoop(Task&& task);
+
+  /* 线程安全: 将一个已accept的连接投递给本Reactor */
+  void QueueConn(int fd, const sockaddr_in& addr);
+
+  /* 线程安全: 热重启时停止accept, 已有连接发送完当前响应后即关闭 */
+  void Drain();
+
+  /* 静态请求快速路径: 不访问数据库、响应不超过maxBytes的请求直接在
+     事件循环线程中读取、解析并发送, 不经过线程池; 0表示关闭。
+     需在Loop()之前设置 */
+  void SetInlineStatic(size_t maxBytes) { inline_max_bytes_ = maxBytes; }
+
+  /* 当前由本Reactor管理的连接数, 用于最少连接分发 */
+  int ConnCount() const { return conn_count_; }
+
+  Reactor(const Reactor&) = delete;
+  Reactor& operator=(const Reactor&) = delete;
+
+ protected:
+  int timeout_ms_;  // 超时单位（毫秒ms）
+  std::atomic<bool> closed_;
+  std::atomic<bool> draining_;  // 热重启中, 不再保持keep-alive
+  size_t inline_max_bytes_;     // 快速路径的响应大小上限, 0表示关闭
+
+  int listen_fd_;
+  AcceptCallback on_accept_;
+
+  int wakeup_fd_;  // eventfd, 用于跨线程唤醒事件循环
+  std::atomic<int> conn_count_;
+
+  ThreadPool* threadpool_;  // 所有Reactor共享同一个线程池
+  std::unique_ptr<TimingWheel> timer_;  // 空闲连接超时
+
+  // 当收到连接请求时，添加客户端
+  virtual void AddClient_(int fd, sockaddr_in addr) = 0;
+
+  // 在事件循环线程中注销监听socket, socket本身由WebServer关闭
+  virtual void RemoveListener_() = 0;
+
+  /* 在事件循环线程中执行其他线程投递的task */
+  void DoPendingTasks_();
+  void SendError_(int fd, const char* info);
+
+  // 线程池拒绝了请求(过载), 返回503, 连接由调用方关闭
+  void SendBusy_(int fd);
+
+ private:
+  std::mutex pending_mtx_;
+  std::vector<Task> pending_tasks_;
+};
+
+}  // namespace webserver
+
+#endif  // REACTOR_H_
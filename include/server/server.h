@@ -10,42 +10,76 @@
 #include <arpa/inet.h>
 #include <assert.h>
 #include <errno.h>
-#include <fcntl.h>  // fcntl()
 #include <netinet/in.h>
+#include <netinet/tcp.h>  // TCP_DEFER_ACCEPT, TCP_NODELAY
+#include <signal.h>       // SIGPIPE
+#include <sys/epoll.h>  // EPOLLET, EPOLLONESHOT
 #include <sys/socket.h>
 #include <unistd.h>  // close()
 
+#include <chrono>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <thread>
+#include <vector>
 
-#include "base/epoller.h"
-#include "base/timer.h"
 #include "http/httpconnection.h"
+#include "http/httpscanner.h"
 #include "pool/sqlconnpool.h"
 #include "pool/threadpool.h"
+#include "server/hotrestart.h"
+#include "server/reactor.h"
 #include "utils/logger.h"
 
 namespace webserver {
 
+/* 基本配置之外的可调参数, 未设置的项保持默认值 */
+struct ServerOptions {
+  /* Reactor配置: 子Reactor数量(0为单Reactor) 分发策略(0轮询 1最少连接) */
+  int reactorNum = 0;
+  int dispatchMode = 0;
+  /* 监听配置: SO_REUSEPORT分片监听 listen队列长度 TCP_DEFER_ACCEPT(秒) */
+  bool reusePort = false;
+  int backlog = SOMAXCONN;
+  int deferAcceptSec = 0;
+  /* I/O后端: Reactor::EPOLL或Reactor::IO_URING(内核不支持时退回epoll) */
+  int ioBackend = Reactor::EPOLL;
+  /* 热重启: 收到SIGUSR2时把监听socket交给新进程, 排空连接后退出 */
+  bool hotRestart = false;
+  /* 过载保护: 线程池排队时延目标(ms), 0为关闭 */
+  int maxQueueDelayMS = 0;
+  /* 静态请求快速路径: 响应不超过该字节数时在Reactor线程内处理, 0为关闭 */
+  int inlineMaxBytes = 0;
+  /* 请求体上限: 缓冲在内存中的 流式处理(HttpRequest::bodyHandler)的 */
+  size_t maxBodySize = 1024 * 1024;
+  size_t maxUploadSize = 64 * 1024 * 1024;
+};
+
 class WebServer {
  public:
   WebServer(int port, int trigMode, int timeoutMS, bool OptLinger, int sqlPort,
             const char* sqlUser, const char* sqlPwd, const char* dbName,
             int connPoolNum, int threadNum, bool openLog, int logLevel,
-            int logQueSize);
+            int logQueSize, const ServerOptions& options = ServerOptions());
 
   ~WebServer();
   void Start();
 
  private:
-  // 最大的 文件描述符(File Descriptor)数量
-  static const int MAX_FD = 65536;
+  /* 主Reactor向子Reactor分发连接的策略 */
+  enum DISPATCH_MODE {
+    ROUND_ROBIN = 0,
+    LEAST_LOADED,
+  };
 
   int port_;          // server端口
   bool open_linger_;  // 是否开启"优雅退出"
   int timeout_ms_;    // 超时单位（毫秒ms）
   bool closed_;       // 标记服务器是否处于"关闭"状态
-  int listen_fd_;     // server进程的文件描述符（一个整数）
+  bool reuse_port_;   // 是否为每个子Reactor创建SO_REUSEPORT监听socket
+  int backlog_;       // listen()的全连接队列长度
+  int defer_accept_sec_;     // TCP_DEFER_ACCEPT超时(秒), 0表示关闭
+  std::vector<int> listen_fds_;  // 监听socket的文件描述符
 
   std::string src_dir_;  // server的源路径
   std::string log_dir_;  // log的存放目录
@@ -53,31 +87,44 @@ class WebServer {
   uint32_t listen_event_;
   uint32_t conn_event_;
 
-  std::unique_ptr<MinHeapTimer> timer_;
+  int dispatch_mode_;    // 连接分发策略, 见DISPATCH_MODE
+  size_t next_reactor_;  // 轮询分发时下一个子Reactor的下标
+
   std::unique_ptr<ThreadPool> threadpool_;
-  std::unique_ptr<Epoller> epoller_;
-  std::unordered_map<int, HttpConn> users_;  // 映射sockfd和http连接之间的关系
+  /* 主Reactor运行在调用Start()的线程上, 持有监听socket;
+     子Reactor为空时即为原来的单Reactor模式, 否则只负责accept和分发 */
+  std::unique_ptr<Reactor> main_reactor_;
+  std::vector<std::unique_ptr<Reactor>> sub_reactors_;
+  std::vector<std::thread> reactor_threads_;
+  /* 执行数据库查询的线程, 数量与数据库连接数相同; 异步处理者把查询交给
+     它后立即返回, 线程池与Reactor线程不必等待数据库。声明在Reactor之后,
+     先于它们析构, 未完成的查询仍能投递完成通知 */
+  std::unique_ptr<ThreadPool> sqlpool_;
+
+  /* 热重启: upgrade_thread_等待升级信号, 交接监听socket后排空连接并退出 */
+  static const int SPAWN_TIMEOUT_MS = 10000;  // 等待新进程就绪的时间
+  static const int DRAIN_TIMEOUT_MS = 30000;  // 排空连接的最长时间
+  std::unique_ptr<HotRestart> hot_restart_;
+  std::thread upgrade_thread_;
+  int inherited_fds_;  // 从旧进程继承的监听socket数量
 
   // 初始化socket
   bool InitSocket_();
+  // 创建、配置并监听一个socket, 失败返回-1
+  int CreateListenFd_();
   // 初始化epoll的边缘触发/水平触发
   void InitEventMode_(int trigMode);
-  // 当收到连接请求时，添加客户端
-  void AddClient_(int fd, sockaddr_in addr);
-
-  void DealListen_();
-  void DealWrite_(HttpConn* client);
-  void DealRead_(HttpConn* client);
-
-  void SendError_(int fd, const char* info);
-  void ExtentTime_(HttpConn* client);
-  void CloseConn_(HttpConn* client);
-
-  void OnRead_(HttpConn* client);
-  void OnWrite_(HttpConn* client);
-  void OnProcess(HttpConn* client);
-
-  static int SetFdNonblock(int fd);
+  // 将主Reactor accept到的连接分发给子Reactor
+  void Dispatch_(int fd, const sockaddr_in& addr);
+  // 注册站点的默认路由, 其余路由可在Start()之前经Router::Instance()添加
+  void InitRoutes_();
+
+  // 等待升级信号并完成一次热重启
+  void WatchUpgrade_();
+  // 停止accept, 等待所有Reactor上的连接关闭后退出事件循环
+  void Drain_();
+  // 所有Reactor当前管理的连接数
+  int ConnCount_() const;
 };
 
 }  // namespace webserver
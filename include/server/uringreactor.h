@@ -0,0 +1,98 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-15
+ * @copyleft Apache 2.0
+ */
+
+#ifndef URING_REACTOR_H_
+#define URING_REACTOR_H_
+
+#include "base/fdslab.h"
+#include "base/uring.h"
+#include "http/httpconnection.h"
+#include "server/reactor.h"
+
+namespace webserver {
+
+/* 基于io_uring的Reactor(完成模型):
+ * accept/recv/writev/close均作为SQE提交, 每轮循环只调用一次io_uring_enter
+ * 批量提交并收割完成事件；报文解析仍在线程池中执行HttpConn::process(),
+ * 完成后通过RunInLoop()回到本线程提交写请求。
+ * 每个连接同一时刻最多只有一个读或写请求在内核中。 */
+class UringReactor : public Reactor {
+ public:
+  UringReactor(int timeoutMS, ThreadPool* threadpool);
+  ~UringReactor() = default;
+
+  /* 当前内核是否可以使用io_uring后端 */
+  static bool Supported();
+
+  bool AddListener(int listenFd, uint32_t listenEvent,
+                   const AcceptCallback& cb = nullptr) override;
+  void Loop() override;
+
+ private:
+  /* 请求类型, 与fd一起编码进SQE的user_data */
+  enum URING_OP {
+    OP_ACCEPT = 0,
+    OP_WAKEUP,
+    OP_RECV,
+    OP_WRITE,
+    OP_PROCESS,  // 不是SQE, 表示连接正在线程池中处理
+    OP_PENDING,  // 不是SQE, 表示连接在等待异步处理者完成
+    OP_CLOSE,
+    OP_CANCEL,
+  };
+
+  /* 连接及其当前未完成的请求 */
+  struct UringConn {
+    HttpConn conn;
+    int op;        // 当前进行中的请求, 见URING_OP
+    bool expired;  // 超时后等待当前请求(或异步处理者)结束再关闭
+    UringConn() : op(OP_CLOSE), expired(false) {}
+  };
+
+  static const size_t READ_SIZE = 4096;  // 每次recv至少预留的空间
+
+  FdSlab<UringConn>* users_;  // 以sockfd为下标的连接表, 所有Reactor共享
+  std::unique_ptr<IoUring> ring_;
+
+  /* accept请求和wakeup读请求使用的缓冲区, 在请求完成前必须保持有效 */
+  sockaddr_in accept_addr_;
+  socklen_t accept_len_;
+  uint64_t wakeup_cnt_;
+
+  static uint64_t Tag_(int fd, int op) {
+    return (static_cast<uint64_t>(fd) << 8) | static_cast<uint64_t>(op);
+  }
+
+  static FdSlab<UringConn>* ConnTable_();
+
+  void AddClient_(int fd, sockaddr_in addr) override;
+  void RemoveListener_() override;
+
+  void PrepAccept_();
+  void PrepWakeup_();
+  void PrepRecv_(UringConn* client);
+  void PrepWrite_(UringConn* client);
+
+  void HandleCqe_(const io_uring_cqe& cqe);
+  void OnAccept_(int res);
+  void OnRecv_(UringConn* client, int res);
+  void OnWrite_(UringConn* client, int res);
+  void OnProcessed_(UringConn* client);
+  /* 异步处理者调用done后在本线程中执行 */
+  void OnCompleted_(UringConn* client);
+  /* 发送异步处理者的回复, 还没完成时等待OnCompleted_ */
+  void Resume_(UringConn* client);
+
+  void Process_(UringConn* client);
+  void ExtentTime_(UringConn* client);
+  void Expire_(int fd);
+  /* 异步处理者还没完成时标记expired, 完成后再关闭 */
+  void CloseConn_(UringConn* client);
+};
+
+}  // namespace webserver
+
+#endif  // URING_REACTOR_H_
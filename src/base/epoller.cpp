@@ -45,6 +45,22 @@ bool Epoller::EpollRemove(int fd) {
   return (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &ev) == 0);
 }
 
+bool Epoller::EpollAdd(int fd, uint32_t events, void *ptr) {
+  if (fd < 0) return false;
+  epoll_event ev;
+  ev.data.ptr = ptr;
+  ev.events = events;
+  return (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == 0);
+}
+
+bool Epoller::EpollModify(int fd, uint32_t events, void *ptr) {
+  if (fd < 0) return false;
+  epoll_event ev;
+  ev.data.ptr = ptr;
+  ev.events = events;
+  return (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0);
+}
+
 int Epoller::EpollWait(int timeout) {
   return epoll_wait(epoll_fd_, events_.data(), static_cast<int>(events_.size()),
                     timeout);
@@ -56,6 +72,8 @@ uint32_t Epoller::GetEpollEvents(size_t idx) const {
   return events_.at(idx).events;
 }
 
+void *Epoller::GetEventPtr(size_t idx) const { return events_[idx].data.ptr; }
+
 int Epoller::GetEpollFd() const { return epoll_fd_; }
 
 }  // namespace webserver
\ No newline at end of file
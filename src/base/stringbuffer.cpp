@@ -66,9 +66,8 @@ char *StringBuffer::WriteBeginPtr() { return BeginPtr_() + write_pos_; }
 
 void StringBuffer::Append(const char *data, size_t len) {
   assert(data);
-  /* 此处单独检查 */
+  /* 按len拷贝, 数据中可以有'\0'(如上传的二进制请求体) */
   if (len <= 0) return;
-  len = len > strlen(data) ? strlen(data) : len;
   EnsureWritable(len);
   std::copy(data, data + len, WriteBeginPtr());
   CompleteWriting(len);
@@ -81,7 +81,8 @@ bool MinHeapTimer::SiftDown_(size_t idx, size_t end) {
 bool MinHeapTimer::SiftUp_(size_t idx) {
   size_t child = idx;
   size_t parent = (child - 1) / 2;
-  while (parent >= 0) {
+  /* size_t恒大于等于0, 必须以child判断是否已到堆顶, 否则会越界访问 */
+  while (child > 0) {
     if (heap_[parent] < heap_[child]) break;
     SwapItem_(parent, child);
     child = parent;
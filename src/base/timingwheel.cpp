@@ -0,0 +1,222 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-29
+ * @copyleft Apache 2.0
+ */
+
+#include "base/timingwheel.h"
+
+#include <cstring>
+
+namespace webserver {
+
+TimingWheel::TimingWheel() : current_(0), count_(0), start_(Clock::now()) {
+  memset(slots_, 0, sizeof(slots_));
+  memset(bitmap_, 0, sizeof(bitmap_));
+}
+
+void TimingWheel::AddItem(int fd, int timeout, const Task& cb_func) {
+  if (fd < 0) return;
+  if (items_.size() <= static_cast<size_t>(fd)) {
+    items_.resize(fd + 1);
+  }
+  WheelItem* item = &items_[fd];
+  if (item->slot >= 0) {
+    // 已有节点
+    Unlink_(item);
+  } else {
+    // 新节点
+    ++count_;
+  }
+  item->item_id = fd;
+  item->expire = Now_() + timeout;
+  item->cb_func = cb_func;
+  Link_(item);
+}
+
+void TimingWheel::UpdateItem(int fd, int timeout) {
+  WheelItem* item = Find_(fd);
+  if (item == nullptr) return;
+  int64_t expire = Now_() + timeout;
+  if (expire >= item->expire) {
+    /* 到期时间延后: 只记录新时间, 槽位到期时再重新放置 */
+    item->expire = expire;
+  } else {
+    Unlink_(item);
+    item->expire = expire;
+    Link_(item);
+  }
+}
+
+void TimingWheel::CancelItem(int fd) {
+  WheelItem* item = Find_(fd);
+  if (item == nullptr) return;
+  Unlink_(item);
+  item->cb_func = nullptr;
+  --count_;
+}
+
+void TimingWheel::DoWork(int fd) {
+  WheelItem* item = Find_(fd);
+  if (item == nullptr) return;
+  Unlink_(item);
+  --count_;
+  /* 回调中可能重新添加同一个fd, 先把回调取出来 */
+  Task cb_func;
+  cb_func.swap(item->cb_func);
+  cb_func();
+}
+
+int TimingWheel::GetNextTick() {
+  int64_t now = Now_();
+  if (count_ == 0) {
+    /* 时间轮为空时无需逐个tick推进 */
+    current_ = now + 1;
+    return -1;
+  }
+  Advance_(now);
+  if (count_ == 0) {
+    return -1;
+  }
+  /* 在根时间轮中找下一个非空槽位, 找不到则等到下一次降级的tick:
+     idx为0时下一个tick本身就要降级, 否则等根时间轮转完这一圈 */
+  int idx = static_cast<int>(current_ & ROOT_MASK);
+  int next = NextRootSlot_(idx);
+  int64_t ticks = 0;
+  if (next >= 0) {
+    ticks = next - idx;
+  } else if (idx != 0) {
+    ticks = ROOT_SIZE - idx;
+  }
+  return static_cast<int>(current_ + ticks - now);
+}
+
+void TimingWheel::Clear() {
+  items_.clear();
+  memset(slots_, 0, sizeof(slots_));
+  memset(bitmap_, 0, sizeof(bitmap_));
+  count_ = 0;
+}
+
+/* 私有成员函数 */
+
+int64_t TimingWheel::Now_() const {
+  return std::chrono::duration_cast<Msec>(Clock::now() - start_).count();
+}
+
+TimingWheel::WheelItem* TimingWheel::Find_(int fd) {
+  if (fd < 0 || items_.size() <= static_cast<size_t>(fd)) return nullptr;
+  WheelItem* item = &items_[fd];
+  return item->slot >= 0 ? item : nullptr;
+}
+
+/* 根据剩余tick数决定放在哪一层: 根时间轮按到期tick取模,
+   第level层按到期tick右移 ROOT_BITS + (level-1)*LEVEL_BITS 位后取模 */
+void TimingWheel::Link_(WheelItem* item) {
+  int64_t expire = item->expire;
+  int64_t delta = expire - current_;
+  int slot;
+  if (delta < 0) {
+    /* 已经到期, 放在下一个要处理的槽位 */
+    slot = static_cast<int>(current_ & ROOT_MASK);
+  } else if (delta < ROOT_SIZE) {
+    slot = static_cast<int>(expire & ROOT_MASK);
+  } else {
+    int level = 1;
+    while (level < LEVELS - 1 &&
+           delta >= (int64_t(1) << (ROOT_BITS + level * LEVEL_BITS))) {
+      ++level;
+    }
+    int64_t max_delta = (int64_t(1) << (ROOT_BITS + level * LEVEL_BITS)) - 1;
+    if (delta > max_delta) {
+      /* 超出最高层范围, 先放在最远处, 到时再重新放置 */
+      expire = current_ + max_delta;
+    }
+    int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+    slot = ROOT_SIZE + (level - 1) * LEVEL_SIZE +
+           static_cast<int>((expire >> shift) & LEVEL_MASK);
+  }
+
+  item->slot = slot;
+  item->prev = nullptr;
+  item->next = slots_[slot];
+  if (item->next) {
+    item->next->prev = item;
+  }
+  slots_[slot] = item;
+  bitmap_[slot / 64] |= uint64_t(1) << (slot % 64);
+}
+
+void TimingWheel::Unlink_(WheelItem* item) {
+  int slot = item->slot;
+  if (item->prev) {
+    item->prev->next = item->next;
+  } else {
+    slots_[slot] = item->next;
+  }
+  if (item->next) {
+    item->next->prev = item->prev;
+  }
+  if (slots_[slot] == nullptr) {
+    bitmap_[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+  }
+  item->prev = item->next = nullptr;
+  item->slot = -1;
+}
+
+/* 逐个tick推进到now, 根时间轮转完一圈时把上一层对应槽位的节点降级 */
+void TimingWheel::Advance_(int64_t now) {
+  while (current_ <= now) {
+    int idx = static_cast<int>(current_ & ROOT_MASK);
+    if (idx == 0) {
+      for (int level = 1; level < LEVELS; ++level) {
+        int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+        int lidx = static_cast<int>((current_ >> shift) & LEVEL_MASK);
+        Cascade_(level, lidx);
+        if (lidx != 0) break;
+      }
+    }
+
+    while (WheelItem* item = slots_[idx]) {
+      Unlink_(item);
+      if (item->expire > current_) {
+        /* 惰性刷新过的节点, 重新放置 */
+        Link_(item);
+        continue;
+      }
+      --count_;
+      Task cb_func;
+      cb_func.swap(item->cb_func);
+      cb_func();
+    }
+    ++current_;
+  }
+}
+
+void TimingWheel::Cascade_(int level, int idx) {
+  int slot = ROOT_SIZE + (level - 1) * LEVEL_SIZE + idx;
+  WheelItem* item = slots_[slot];
+  slots_[slot] = nullptr;
+  bitmap_[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+  while (item) {
+    WheelItem* next = item->next;
+    Link_(item);
+    item = next;
+  }
+}
+
+/* 在根时间轮[idx, ROOT_SIZE)范围内查找第一个非空槽位, 没有则返回-1 */
+int TimingWheel::NextRootSlot_(int idx) const {
+  for (int word = idx / 64; word < ROOT_SIZE / 64; ++word) {
+    uint64_t bits = bitmap_[word];
+    if (word == idx / 64) {
+      bits &= ~uint64_t(0) << (idx % 64);
+    }
+    if (bits) {
+      return word * 64 + __builtin_ctzll(bits);
+    }
+  }
+  return -1;
+}
+
+}  // namespace webserver
@@ -0,0 +1,212 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-15
+ * @copyleft Apache 2.0
+ */
+
+#include "base/uring.h"
+
+#include <errno.h>
+#include <signal.h>  // _NSIG
+
+#include "utils/logger.h"
+
+namespace webserver {
+
+IoUring::IoUring(unsigned entries)
+    : ring_fd_(-1),
+      sq_entries_(0),
+      sqe_tail_(0),
+      sq_ptr_(MAP_FAILED),
+      sq_ring_size_(0),
+      cq_ptr_(MAP_FAILED),
+      cq_ring_size_(0),
+      sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+      sqes_size_(0) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+  if (fd < 0) {
+    LOG_WARN("io_uring_setup error: %d (%s)", errno, strerror(errno));
+    return;
+  }
+  /* 等待完成事件时需要带超时, 依赖IORING_ENTER_EXT_ARG(Linux 5.11+) */
+  if (!(params.features & IORING_FEAT_EXT_ARG)) {
+    LOG_WARN("io_uring lacks IORING_FEAT_EXT_ARG");
+    close(fd);
+    return;
+  }
+  ring_fd_ = fd;
+  sq_entries_ = params.sq_entries;
+
+  /* 将SQ/CQ环形队列以及SQE数组映射到用户空间 */
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ =
+        sq_ring_size_ > cq_ring_size_ ? sq_ring_size_ : cq_ring_size_;
+  }
+  sq_ptr_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (single_mmap) {
+    cq_ptr_ = sq_ptr_;
+  } else if (sq_ptr_ != MAP_FAILED) {
+    cq_ptr_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe*>(
+      mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+  if (sq_ptr_ == MAP_FAILED || cq_ptr_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+    LOG_WARN("io_uring mmap error: %d (%s)", errno, strerror(errno));
+    Release_();
+    return;
+  }
+
+  char* sq = static_cast<char*>(sq_ptr_);
+  char* cq = static_cast<char*>(cq_ptr_);
+  sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  sqe_tail_ = *sq_tail_;
+}
+
+IoUring::~IoUring() { Release_(); }
+
+void IoUring::PrepAccept(int fd, sockaddr* addr, socklen_t* len, int flags,
+                         uint64_t user_data) {
+  io_uring_sqe* sqe = GetSqe_();
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(addr);
+  sqe->addr2 = reinterpret_cast<uint64_t>(len);
+  sqe->accept_flags = flags;
+  sqe->user_data = user_data;
+}
+
+void IoUring::PrepRecv(int fd, void* buf, size_t len, uint64_t user_data) {
+  io_uring_sqe* sqe = GetSqe_();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(buf);
+  sqe->len = static_cast<uint32_t>(len);
+  sqe->user_data = user_data;
+}
+
+void IoUring::PrepRead(int fd, void* buf, size_t len, uint64_t user_data) {
+  io_uring_sqe* sqe = GetSqe_();
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(buf);
+  sqe->len = static_cast<uint32_t>(len);
+  sqe->user_data = user_data;
+}
+
+void IoUring::PrepWritev(int fd, const iovec* iov, int iov_cnt,
+                         uint64_t user_data) {
+  io_uring_sqe* sqe = GetSqe_();
+  sqe->opcode = IORING_OP_WRITEV;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(iov);
+  sqe->len = static_cast<uint32_t>(iov_cnt);
+  sqe->user_data = user_data;
+}
+
+void IoUring::PrepClose(int fd, uint64_t user_data) {
+  io_uring_sqe* sqe = GetSqe_();
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->fd = fd;
+  sqe->user_data = user_data;
+}
+
+void IoUring::PrepCancel(uint64_t target, uint64_t user_data) {
+  io_uring_sqe* sqe = GetSqe_();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = target;
+  sqe->user_data = user_data;
+}
+
+int IoUring::Submit(int timeout) {
+  /* 发布本地尾指针, 内核从这里开始消费新的SQE */
+  unsigned to_submit = sqe_tail_ - *sq_tail_;
+  __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+
+  unsigned flags = IORING_ENTER_GETEVENTS;
+  io_uring_getevents_arg arg;
+  __kernel_timespec ts;
+  void* argp = nullptr;
+  size_t argsz = 0;
+  if (timeout >= 0) {
+    memset(&arg, 0, sizeof(arg));
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000L;
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    argp = &arg;
+    argsz = sizeof(arg);
+    flags |= IORING_ENTER_EXT_ARG;
+  }
+  int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, to_submit,
+                                     1, flags, argp, argsz));
+  /* 超时(ETIME)和被信号打断(EINTR)都不是错误 */
+  if (ret < 0 && errno != ETIME && errno != EINTR) {
+    LOG_ERROR("io_uring_enter error: %d (%s)", errno, strerror(errno));
+  }
+  return ret;
+}
+
+bool IoUring::PeekCqe(io_uring_cqe* cqe) {
+  unsigned head = *cq_head_;
+  if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  *cqe = cqes_[head & *cq_mask_];
+  __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+/* ---------------------- 私有方法 ---------------------- */
+
+io_uring_sqe* IoUring::GetSqe_() {
+  while (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >=
+         sq_entries_) {
+    /* SQ已满, 先把已有请求交给内核, 不等待完成事件 */
+    unsigned to_submit = sqe_tail_ - *sq_tail_;
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    syscall(__NR_io_uring_enter, ring_fd_, to_submit, 0, 0, nullptr, 0);
+  }
+  unsigned idx = sqe_tail_ & *sq_mask_;
+  sq_array_[idx] = idx;
+  ++sqe_tail_;
+  io_uring_sqe* sqe = &sqes_[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+void IoUring::Release_() {
+  if (sqes_ != MAP_FAILED) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) {
+    munmap(cq_ptr_, cq_ring_size_);
+  }
+  if (sq_ptr_ != MAP_FAILED) {
+    munmap(sq_ptr_, sq_ring_size_);
+  }
+  sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+  sq_ptr_ = cq_ptr_ = MAP_FAILED;
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+    ring_fd_ = -1;
+  }
+}
+
+}  // namespace webserver
@@ -0,0 +1,195 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-15
+ * @copyleft Apache 2.0
+ */
+
+#include "http/bodyreader.h"
+
+#include <algorithm>
+
+namespace webserver {
+
+const size_t BodyReader::MAX_LINE;
+const size_t BodyReader::MAX_TRAILER;
+
+namespace {
+
+int HexValue(char ch) {
+  if (ch >= '0' && ch <= '9') return ch - '0';
+  if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+  return -1;
+}
+
+}  // namespace
+
+void BodyReader::Reset() {
+  state_ = DONE;
+  remaining_ = received_ = limit_ = line_ = trailer_ = 0;
+  digits_ = 0;
+  sink_ = nullptr;
+}
+
+void BodyReader::InitLength(size_t length, size_t limit, const Sink& sink) {
+  Reset();
+  state_ = (length > 0) ? LENGTH_DATA : DONE;
+  remaining_ = length;
+  limit_ = limit;
+  sink_ = sink;
+}
+
+void BodyReader::InitChunked(size_t limit, const Sink& sink) {
+  Reset();
+  state_ = CHUNK_SIZE;
+  limit_ = limit;
+  sink_ = sink;
+}
+
+bool BodyReader::Deliver_(const char* data, size_t len) {
+  received_ += len;
+  return !sink_ || sink_(data, len);
+}
+
+BodyReader::STATUS BodyReader::Feed(const char* data, size_t len,
+                                    size_t* used) {
+  size_t i = 0;
+  if (state_ == LENGTH_DATA && remaining_ > limit_ - received_) {
+    *used = 0;
+    return TOO_LARGE;
+  }
+  /* 行尾接受CRLF或单独的LF, 与HttpParser解析头部时相同 */
+  while (i < len && state_ != DONE) {
+    char ch = data[i];
+    switch (state_) {
+      case LENGTH_DATA:
+      case CHUNK_DATA: {
+        size_t n = std::min(remaining_, len - i);
+        if (!Deliver_(data + i, n)) {
+          *used = i;
+          return ERROR;
+        }
+        i += n;
+        remaining_ -= n;
+        if (remaining_ == 0) {
+          state_ = (state_ == LENGTH_DATA) ? DONE : CHUNK_DATA_CR;
+        }
+        break;
+      }
+      case CHUNK_SIZE: {
+        int value = HexValue(ch);
+        if (value >= 0) {
+          /* 块大小不能超过剩余的额度, 同时避免溢出 */
+          size_t avail = limit_ - received_;
+          if (static_cast<size_t>(value) > avail ||
+              remaining_ > (avail - value) / 16) {
+            *used = i;
+            return TOO_LARGE;
+          }
+          remaining_ = remaining_ * 16 + value;
+          ++digits_;
+          ++i;
+          break;
+        }
+        if (digits_ == 0) {
+          *used = i;
+          return ERROR;
+        }
+        if (ch == ';' || ch == ' ' || ch == '\t') {
+          state_ = CHUNK_EXT;
+        } else if (ch == '\r') {
+          state_ = CHUNK_SIZE_LF;
+          ++i;
+        } else if (ch == '\n') {
+          state_ = CHUNK_SIZE_LF;  // 由CHUNK_SIZE_LF消费
+        } else {
+          *used = i;
+          return ERROR;
+        }
+        break;
+      }
+      case CHUNK_EXT:
+        /* 块扩展没有定义任何语义, 跳过 */
+        if (ch == '\r' || ch == '\n') {
+          state_ = CHUNK_SIZE_LF;
+          if (ch == '\r') ++i;
+          break;
+        }
+        if (++line_ > MAX_LINE) {
+          *used = i;
+          return ERROR;
+        }
+        ++i;
+        break;
+      case CHUNK_SIZE_LF:
+        if (ch != '\n') {
+          *used = i;
+          return ERROR;
+        }
+        ++i;
+        line_ = 0;
+        digits_ = 0;
+        state_ = (remaining_ == 0) ? TRAILER_START : CHUNK_DATA;
+        break;
+      case CHUNK_DATA_CR:
+        if (ch == '\r') {
+          state_ = CHUNK_DATA_LF;
+          ++i;
+        } else if (ch == '\n') {
+          state_ = CHUNK_DATA_LF;
+        } else {
+          *used = i;
+          return ERROR;
+        }
+        break;
+      case CHUNK_DATA_LF:
+        if (ch != '\n') {
+          *used = i;
+          return ERROR;
+        }
+        ++i;
+        state_ = CHUNK_SIZE;
+        break;
+      case TRAILER_START:
+        if (ch == '\r') {
+          state_ = TRAILER_END_LF;
+          ++i;
+        } else if (ch == '\n') {
+          state_ = DONE;
+          ++i;
+        } else {
+          line_ = 0;
+          state_ = TRAILER_LINE;
+        }
+        break;
+      case TRAILER_LINE:
+        /* trailer字段不影响静态资源的处理, 只检查长度后丢弃 */
+        if (++line_ > MAX_LINE || ++trailer_ > MAX_TRAILER) {
+          *used = i;
+          return ERROR;
+        }
+        if (ch == '\n') {
+          state_ = TRAILER_START;
+        }
+        ++i;
+        break;
+      case TRAILER_END_LF:
+        if (ch != '\n') {
+          *used = i;
+          return ERROR;
+        }
+        ++i;
+        state_ = DONE;
+        break;
+      default:
+        break;
+    }
+  }
+  *used = i;
+  if (state_ == DONE) {
+    return COMPLETE;
+  }
+  return INCOMPLETE;
+}
+
+}  // namespace webserver
@@ -0,0 +1,226 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-12
+ * @copyleft Apache 2.0
+ */
+
+#include "http/compressor.h"
+
+#include <fcntl.h>   // open
+#include <string.h>  // strncmp
+#include <unistd.h>  // read, close
+#include <zlib.h>
+
+#ifdef WEBSERVER_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include "utils/logger.h"
+
+namespace webserver {
+
+const size_t Compressor::MIN_SIZE;
+
+static_assert(Compressor::ENCODINGS <= FileCache::Entry::DERIVED,
+              "FileCache::Entry::derived too small");
+
+namespace {
+
+const int GZIP_LEVEL = 6;
+const int BROTLI_QUALITY = 6;  // 每个文件版本只压缩一次, 兼顾压缩率与首次延迟
+
+/* q值以千分之一为单位, 格式错误按0处理。
+   qvalue = ("0" ["." 0*3DIGIT]) / ("1" ["." 0*3("0")]) */
+int ParseQuality(StringPiece param) {
+  param.TrimSpace();
+  if (param.size() < 2 || (param[0] != 'q' && param[0] != 'Q') ||
+      param[1] != '=') {
+    return 1000;
+  }
+  param.RemovePrefix(2);
+  if (param.empty() || param[0] < '0' || param[0] > '1' ||
+      (param.size() > 1 && param[1] != '.') || param.size() > 5) {
+    return 0;
+  }
+  int q = (param[0] - '0') * 1000;
+  int scale = 100;
+  for (size_t i = 2; i < param.size(); ++i, scale /= 10) {
+    if (param[i] < '0' || param[i] > '9') {
+      return 0;
+    }
+    q += (param[i] - '0') * scale;
+  }
+  return q > 1000 ? 0 : q;
+}
+
+bool Gzip(const char* data, size_t len, std::string* out) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  /* windowBits + 16 生成gzip格式而不是zlib格式 */
+  if (deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  out->resize(deflateBound(&zs, len));
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  zs.avail_in = len;
+  zs.next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+  zs.avail_out = out->size();
+  int ret = deflate(&zs, Z_FINISH);
+  out->resize(zs.total_out);
+  deflateEnd(&zs);
+  return ret == Z_STREAM_END;
+}
+
+#ifdef WEBSERVER_BROTLI
+bool Brotli(const char* data, size_t len, std::string* out) {
+  size_t outLen = BrotliEncoderMaxCompressedSize(len);
+  if (outLen == 0) {
+    return false;
+  }
+  out->resize(outLen);
+  if (!BrotliEncoderCompress(BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW,
+                             BROTLI_MODE_TEXT, len,
+                             reinterpret_cast<const uint8_t*>(data), &outLen,
+                             reinterpret_cast<uint8_t*>(&(*out)[0]))) {
+    return false;
+  }
+  out->resize(outLen);
+  return true;
+}
+#endif
+
+}  // namespace
+
+Compressor::ENCODING Compressor::Negotiate(const StringPiece& acceptEncoding) {
+  int gzip = -1, br = -1, star = -1;
+  StringPiece rest = acceptEncoding;
+  while (!rest.empty()) {
+    size_t comma = rest.find(',');
+    StringPiece item = rest.substr(0, comma);
+    rest = (comma == StringPiece::npos) ? StringPiece()
+                                        : rest.substr(comma + 1);
+    size_t semi = item.find(';');
+    StringPiece coding = item.substr(0, semi);
+    coding.TrimSpace();
+    int q = (semi == StringPiece::npos) ? 1000
+                                        : ParseQuality(item.substr(semi + 1));
+    if (coding.EqualsIgnoreCase("gzip") || coding.EqualsIgnoreCase("x-gzip")) {
+      gzip = q;
+    } else if (coding.EqualsIgnoreCase("br")) {
+      br = q;
+    } else if (coding == "*") {
+      star = q;
+    }
+  }
+  /* 未列出的编码按*的q值处理 */
+  if (gzip < 0) gzip = (star < 0) ? 0 : star;
+  if (br < 0) br = (star < 0) ? 0 : star;
+#ifdef WEBSERVER_BROTLI
+  if (br > 0 && br >= gzip) {
+    return BROTLI;
+  }
+#endif
+  return gzip > 0 ? GZIP : IDENTITY;
+}
+
+const char* Compressor::Name(ENCODING encoding) {
+  switch (encoding) {
+    case GZIP:
+      return "gzip";
+    case BROTLI:
+      return "br";
+    default:
+      return "identity";
+  }
+}
+
+bool Compressor::Compressible(const char* mime) {
+  static const char* const TYPES[] = {
+      "application/javascript", "application/json", "application/rtf",
+      "application/xhtml+xml",  "application/xml",  "image/svg+xml",
+  };
+  if (strncmp(mime, "text/", 5) == 0) {
+    return true;
+  }
+  for (const char* type : TYPES) {
+    if (strcmp(mime, type) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Compressor::Compress(ENCODING encoding, const char* data, size_t len,
+                          std::string* out) {
+  switch (encoding) {
+    case GZIP:
+      return Gzip(data, len, out);
+#ifdef WEBSERVER_BROTLI
+    case BROTLI:
+      return Brotli(data, len, out);
+#endif
+    default:
+      return false;
+  }
+}
+
+std::shared_ptr<const std::string> Compressor::Encode(
+    const FileCache::EntryPtr& file, const std::string& path,
+    ENCODING encoding) {
+  if (!file || encoding == IDENTITY || encoding >= ENCODINGS ||
+      !file->data || file->Size() < MIN_SIZE || !Compressible(file->mime)) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> locker(file->derivedMtx);
+  if (file->derivedDone[encoding]) {
+    return file->derived[encoding];
+  }
+  file->derivedDone[encoding] = true;
+
+  std::shared_ptr<std::string> out = std::make_shared<std::string>();
+  const char* suffix = (encoding == GZIP) ? ".gz" : ".br";
+  if (ReadSidecar_(path + suffix, file->st, out.get())) {
+    LOG_DEBUG("precompressed %s%s, %d bytes", path.data(), suffix,
+              (int)out->size());
+  } else if (Compress(encoding, file->data, file->Size(), out.get())) {
+    LOG_DEBUG("compressed %s with %s, %d -> %d bytes", path.data(),
+              Name(encoding), (int)file->Size(), (int)out->size());
+  } else {
+    return nullptr;
+  }
+  if (out->size() >= file->Size()) {
+    return nullptr;
+  }
+  file->derived[encoding] = out;
+  return out;
+}
+
+bool Compressor::ReadSidecar_(const std::string& path,
+                              const struct stat& source, std::string* out) {
+  int fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  /* 比源文件旧的预压缩文件已过期, 改为即时压缩 */
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+      st.st_mtime < source.st_mtime) {
+    close(fd);
+    return false;
+  }
+  out->resize(st.st_size);
+  size_t done = 0;
+  while (done < out->size()) {
+    ssize_t len = read(fd, &(*out)[done], out->size() - done);
+    if (len <= 0) {
+      break;
+    }
+    done += len;
+  }
+  close(fd);
+  out->resize(done);
+  return done == static_cast<size_t>(st.st_size) && done > 0;
+}
+
+}  // namespace webserver
@@ -0,0 +1,301 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-10
+ * @copyleft Apache 2.0
+ */
+
+#include "http/filecache.h"
+
+#include <ctype.h>     // tolower
+#include <errno.h>
+#include <fcntl.h>     // open
+#include <stdio.h>     // snprintf
+#include <string.h>    // memset, strcmp
+#include <sys/mman.h>  // mmap, munmap
+#include <time.h>      // gmtime_r, strftime
+#include <unistd.h>    // close
+
+#include <chrono>
+#include <functional>
+
+#include "utils/logger.h"
+
+namespace webserver {
+
+const int FileCache::Entry::DERIVED;
+const int FileCache::SHARDS;
+const size_t FileCache::MAX_ENTRIES;
+const size_t FileCache::FD_MIN;
+const size_t FileCache::STREAM_MIN;
+const int64_t FileCache::REVALIDATE_MS;
+
+namespace {
+
+const char REVALIDATE[] = "no-cache";
+const char ONE_HOUR[] = "max-age=3600";
+const char ONE_DAY[] = "max-age=86400";
+const char ONE_WEEK[] = "max-age=604800";
+
+/* 后缀(不含'.', 小写) -> MIME类型与Cache-Control */
+struct FileType {
+  const char* suffix;
+  const char* mime;
+  const char* cacheControl;
+};
+
+constexpr FileType FILE_TYPES[] = {
+    {"html", "text/html", REVALIDATE},
+    {"xml", "text/xml", REVALIDATE},
+    {"xhtml", "application/xhtml+xml", REVALIDATE},
+    {"txt", "text/plain", ONE_HOUR},
+    {"rtf", "application/rtf", ONE_HOUR},
+    {"pdf", "application/pdf", ONE_HOUR},
+    {"word", "application/nsword", ONE_HOUR},
+    {"png", "image/png", ONE_WEEK},
+    {"gif", "image/gif", ONE_WEEK},
+    {"jpg", "image/jpeg", ONE_WEEK},
+    {"jpeg", "image/jpeg", ONE_WEEK},
+    {"ico", "image/x-icon", ONE_WEEK},
+    {"au", "audio/basic", ONE_WEEK},
+    {"mpeg", "video/mpeg", ONE_WEEK},
+    {"mpg", "video/mpeg", ONE_WEEK},
+    {"avi", "video/x-msvideo", ONE_WEEK},
+    {"mp4", "video/mp4", ONE_WEEK},
+    {"gz", "application/x-gzip", ONE_HOUR},
+    {"tar", "application/x-tar", ONE_HOUR},
+    {"css", "text/css", ONE_DAY},
+    {"js", "text/javascript", ONE_DAY},
+};
+constexpr size_t TYPE_COUNT = sizeof(FILE_TYPES) / sizeof(FILE_TYPES[0]);
+
+/* 后缀的完美哈希: 首字符、末字符与长度即可区分表中所有后缀,
+   新增后缀发生冲突时编译失败, 需要调整系数 */
+constexpr size_t HASH_SIZE = 64;
+constexpr size_t MAX_SUFFIX = 8;
+
+constexpr size_t Hash(char first, char last, size_t len) {
+  return (static_cast<unsigned char>(first) +
+          static_cast<unsigned char>(last) * 30 + len) %
+         HASH_SIZE;
+}
+
+constexpr size_t Length(const char* s) { return *s ? 1 + Length(s + 1) : 0; }
+
+constexpr size_t HashOf(const char* s) {
+  return Hash(s[0], s[Length(s) - 1], Length(s));
+}
+
+constexpr bool Distinct(size_t i, size_t j) {
+  return j >= TYPE_COUNT || (HashOf(FILE_TYPES[i].suffix) !=
+                                 HashOf(FILE_TYPES[j].suffix) &&
+                             Distinct(i, j + 1));
+}
+
+constexpr bool Perfect(size_t i) {
+  return i >= TYPE_COUNT ||
+         (Length(FILE_TYPES[i].suffix) < MAX_SUFFIX && Distinct(i, i + 1) &&
+          Perfect(i + 1));
+}
+
+static_assert(Perfect(0), "suffix hash collision in FILE_TYPES");
+
+/* 哈希槽 -> FILE_TYPES下标, 静态初始化时填充一次 */
+struct HashSlots {
+  int8_t index[HASH_SIZE];
+  HashSlots() {
+    memset(index, -1, sizeof(index));
+    for (size_t i = 0; i < TYPE_COUNT; ++i) {
+      index[HashOf(FILE_TYPES[i].suffix)] = static_cast<int8_t>(i);
+    }
+  }
+};
+const HashSlots SLOTS;
+
+/* 按最后一个'.'之后的后缀查表, 不区分大小写(如.GIF), 不分配内存 */
+const FileType* FindType(const std::string& path) {
+  std::string::size_type idx = path.find_last_of('.');
+  if (idx == std::string::npos) {
+    return nullptr;
+  }
+  size_t len = path.size() - idx - 1;
+  if (len == 0 || len >= MAX_SUFFIX) {
+    return nullptr;
+  }
+  char suffix[MAX_SUFFIX];
+  for (size_t i = 0; i < len; ++i) {
+    suffix[i] = static_cast<char>(tolower(path[idx + 1 + i]));
+  }
+  suffix[len] = '\0';
+  int i = SLOTS.index[Hash(suffix[0], suffix[len - 1], len)];
+  if (i < 0 || strcmp(FILE_TYPES[i].suffix, suffix) != 0) {
+    return nullptr;
+  }
+  return &FILE_TYPES[i];
+}
+
+}  // namespace
+
+FileCache::Entry::~Entry() {
+  if (data) {
+    munmap(data, st.st_size);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+FileCache* FileCache::Instance() {
+  static FileCache instance;
+  return &instance;
+}
+
+FileCache::EntryPtr FileCache::Get(const std::string& path) {
+  Shard& shard = shards_[std::hash<std::string>()(path) % SHARDS];
+  int64_t now = NowMs_();
+  EntryPtr cached;
+  {
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto it = shard.slots.find(path);
+    if (it != shard.slots.end()) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+      if (now - it->second.checkedMs < REVALIDATE_MS) {
+        return it->second.entry;
+      }
+      cached = it->second.entry;
+    }
+  }
+
+  /* 未命中或需要重新确认: 在锁外做文件系统调用 */
+  struct stat st;
+  if (stat(path.data(), &st) < 0 || !S_ISREG(st.st_mode)) {
+    if (cached) {
+      std::lock_guard<std::mutex> locker(shard.mtx);
+      Erase_(shard, path);
+    }
+    return nullptr;
+  }
+  EntryPtr entry =
+      (cached && SameFile_(cached->st, st)) ? cached : Load_(path, st);
+  if (!entry) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> locker(shard.mtx);
+  auto it = shard.slots.find(path);
+  if (it == shard.slots.end()) {
+    if (shard.slots.size() >= MAX_ENTRIES) {
+      /* 淘汰最久未访问的条目, 它由正在发送它的连接继续持有, 发送完毕后
+         才释放 */
+      Erase_(shard, shard.lru.back());
+    }
+    shard.lru.push_front(path);
+    shard.slots.emplace(path, Slot{entry, now, shard.lru.begin()});
+  } else {
+    it->second.entry = entry;
+    it->second.checkedMs = now;
+  }
+  return entry;
+}
+
+const char* FileCache::MimeType(const std::string& path) {
+  const FileType* type = FindType(path);
+  return type ? type->mime : "text/plain";
+}
+
+const char* FileCache::CacheControl(const std::string& path) {
+  const FileType* type = FindType(path);
+  return type ? type->cacheControl : ONE_HOUR;
+}
+
+void FileCache::Clear() {
+  for (Shard& shard : shards_) {
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    shard.slots.clear();
+    shard.lru.clear();
+  }
+}
+
+void FileCache::Erase_(Shard& shard, const std::string& path) {
+  auto it = shard.slots.find(path);
+  if (it == shard.slots.end()) {
+    return;
+  }
+  /* path可能就是lru中的元素, 先删除表项再删除它 */
+  std::list<std::string>::iterator lru = it->second.lru;
+  shard.slots.erase(it);
+  shard.lru.erase(lru);
+}
+
+FileCache::EntryPtr FileCache::Load_(const std::string& path,
+                                     const struct stat& st) {
+  std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+  entry->st = st;
+  entry->mime = MimeType(path);
+  entry->cacheControl = CacheControl(path);
+  if (!(st.st_mode & S_IROTH)) {
+    return entry;  // 403, 不打开文件
+  }
+
+  int fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG_WARN("open %s failed, errno %d", path.data(), errno);
+    return nullptr;
+  }
+  /* 以打开后的fd为准, 避免stat与open之间文件被替换 */
+  if (fstat(fd, &entry->st) < 0) {
+    close(fd);
+    return nullptr;
+  }
+  size_t size = entry->st.st_size;
+  if (size >= STREAM_MIN) {
+    /* 大文件总是从头到尾顺序读取, 加大内核预读窗口 */
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  } else if (size > 0) {
+    /* MAP_PRIVATE 建立一个写入时拷贝的私有映射 */
+    void* mmRet = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mmRet == MAP_FAILED) {
+      LOG_WARN("mmap %s failed, errno %d", path.data(), errno);
+      close(fd);
+      return nullptr;
+    }
+    entry->data = static_cast<char*>(mmRet);
+  }
+  if (size >= FD_MIN) {
+    entry->fd = fd;  // sendfile使用显式偏移, 多个连接共享同一个fd是安全的
+  } else {
+    close(fd);
+  }
+  SetValidators_(entry.get());
+  LOG_DEBUG("file cache load %s", path.data());
+  return entry;
+}
+
+bool FileCache::SameFile_(const struct stat& a, const struct stat& b) {
+  return a.st_ino == b.st_ino && a.st_dev == b.st_dev &&
+         a.st_size == b.st_size && a.st_mode == b.st_mode &&
+         a.st_mtim.tv_sec == b.st_mtim.tv_sec &&
+         a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+/* 强ETag由inode、大小和纳秒级修改时间组成, 文件被替换或修改后必然变化 */
+void FileCache::SetValidators_(Entry* entry) {
+  char buf[64];
+  unsigned long long mtimeNs =
+      entry->st.st_mtim.tv_sec * 1000000000ULL + entry->st.st_mtim.tv_nsec;
+  snprintf(buf, sizeof(buf), "%llx-%llx-%llx",
+           static_cast<unsigned long long>(entry->st.st_ino),
+           static_cast<unsigned long long>(entry->st.st_size), mtimeNs);
+  entry->etag = buf;
+  struct tm tm;
+  gmtime_r(&entry->st.st_mtime, &tm);
+  strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  entry->lastModified = buf;
+}
+
+int64_t FileCache::NowMs_() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace webserver
@@ -0,0 +1,412 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-17
+ * @copyleft Apache 2.0
+ */
+
+#include "http/formdata.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>  // mkostemp
+#include <string.h>  // memmem
+#include <unistd.h>
+
+#include "http/httpscanner.h"
+
+namespace webserver {
+
+const int FormData::MAX_FIELDS;
+const size_t FormData::MAX_PART_HEAD;
+const size_t FormData::MAX_BOUNDARY;
+
+namespace {
+
+int HexValue(char ch) {
+  if (ch >= '0' && ch <= '9') return ch - '0';
+  if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+  return -1;
+}
+
+StringPiece Trim(StringPiece str) {
+  str.TrimSpace();
+  return str;
+}
+
+}  // namespace
+
+FormData::FormData()
+    : state_(FAILED), arena_(nullptr), fieldLimit_(0), tooLarge_(false) {}
+
+FormData::~FormData() { Reset(); }
+
+void FormData::Reset() {
+  /* 临时文件的路径在arena中, 须在arena清空之前调用 */
+  for (const Part& part : parts_) {
+    if (part.fd >= 0) {
+      close(part.fd);
+      unlink(Piece_(part.path).ToString().c_str());
+    }
+  }
+  parts_.clear();
+  fields_.clear();
+  pending_.clear();
+  state_ = FAILED;
+  arena_ = nullptr;
+  tooLarge_ = false;
+}
+
+/* ---------------------- urlencoded ---------------------- */
+
+size_t FormData::UrlDecode(char* data, size_t len) {
+  char* out = data;
+  const char* p = data;
+  const char* end = data + len;
+  /* 不需要转换的连续字节由HttpScanner批量跳过, 解码后变短时整段前移 */
+  while (p < end) {
+    const char* stop = HttpScanner::FindFormEscape(p, end);
+    if (out != p) {
+      memmove(out, p, stop - p);
+    }
+    out += stop - p;
+    p = stop;
+    if (p == end) {
+      break;
+    }
+    if (*p == '+') {
+      *out++ = ' ';
+      ++p;
+      continue;
+    }
+    int hi = (end - p >= 3) ? HexValue(p[1]) : -1;
+    int lo = (hi >= 0) ? HexValue(p[2]) : -1;
+    if (lo >= 0) {
+      *out++ = static_cast<char>(hi * 16 + lo);
+      p += 3;
+    } else {
+      *out++ = *p++;
+    }
+  }
+  return out - data;
+}
+
+void FormData::ParseUrlencoded(char* data, size_t len) {
+  fields_.clear();
+  char* p = data;
+  char* end = data + len;
+  while (p < end && fields_.size() < static_cast<size_t>(MAX_FIELDS)) {
+    char* amp = static_cast<char*>(memchr(p, '&', end - p));
+    if (!amp) amp = end;
+    if (amp > p) {
+      /* 名字与值各自原地解码, 两段互不重叠 */
+      char* eq = static_cast<char*>(memchr(p, '=', amp - p));
+      if (!eq) eq = amp;
+      Field field;
+      field.name = StringPiece(p, UrlDecode(p, eq - p));
+      char* value = (eq < amp) ? eq + 1 : amp;
+      field.size = UrlDecode(value, amp - value);
+      field.value = StringPiece(value, field.size);
+      field.fd = -1;
+      fields_.push_back(field);
+    }
+    p = amp + 1;
+  }
+}
+
+const FormData::Field* FormData::Get(const StringPiece& name) const {
+  for (const Field& field : fields_) {
+    if (field.name == name) {
+      return &field;
+    }
+  }
+  return nullptr;
+}
+
+StringPiece FormData::MediaType(const StringPiece& contentType) {
+  size_t semi = contentType.find(';');
+  return Trim(contentType.substr(0, semi));
+}
+
+StringPiece FormData::Param(const StringPiece& header,
+                            const StringPiece& name) {
+  size_t size = header.size();
+  size_t i = header.find(';');
+  while (i < size) {
+    ++i;
+    size_t keyBegin = i;
+    while (i < size && header[i] != '=' && header[i] != ';') ++i;
+    StringPiece key = Trim(header.substr(keyBegin, i - keyBegin));
+    if (i == size || header[i] == ';') {
+      continue;
+    }
+    ++i;
+    while (i < size && (header[i] == ' ' || header[i] == '\t')) ++i;
+    StringPiece value;
+    if (i < size && header[i] == '"') {
+      /* 引号中可能有';', 转义的引号原样保留 */
+      size_t begin = ++i;
+      while (i < size && header[i] != '"') {
+        i += (header[i] == '\\' && i + 1 < size) ? 2 : 1;
+      }
+      value = header.substr(begin, i - begin);
+      while (i < size && header[i] != ';') ++i;
+    } else {
+      size_t begin = i;
+      while (i < size && header[i] != ';') ++i;
+      value = Trim(header.substr(begin, i - begin));
+    }
+    if (key.EqualsIgnoreCase(name)) {
+      return value;
+    }
+  }
+  return StringPiece();
+}
+
+/* ---------------------- multipart/form-data ---------------------- */
+
+bool FormData::InitMultipart(const StringPiece& contentType,
+                             std::string* arena, size_t fieldLimit,
+                             const std::string& uploadDir) {
+  Reset();
+  StringPiece boundary = Param(contentType, "boundary");
+  if (boundary.empty() || boundary.size() > MAX_BOUNDARY) {
+    return false;
+  }
+  delimiter_.assign("\r\n--");
+  delimiter_.append(boundary.data(), boundary.size());
+  /* 第一个分隔符前面没有CRLF, 补上后所有分隔符的形式相同 */
+  pending_.assign("\r\n");
+  arena_ = arena;
+  fieldLimit_ = fieldLimit;
+  uploadDir_ = uploadDir;
+  state_ = PREAMBLE;
+  return true;
+}
+
+bool FormData::Feed(const char* data, size_t len) {
+  if (state_ == FAILED) {
+    return false;
+  }
+  /* 通常没有遗留的字节, 直接在调用方的缓冲区上处理, 只保存未消费的尾部 */
+  if (pending_.empty()) {
+    size_t used = Process_(data, len);
+    pending_.assign(data + used, len - used);
+  } else {
+    pending_.append(data, len);
+    size_t used = Process_(pending_.data(), pending_.size());
+    pending_.erase(0, used);
+  }
+  return state_ != FAILED;
+}
+
+bool FormData::Finish() {
+  if (state_ != EPILOGUE) {
+    return false;
+  }
+  fields_.clear();
+  for (const Part& part : parts_) {
+    Field field;
+    field.name = Piece_(part.name);
+    field.filename = Piece_(part.filename);
+    field.contentType = Piece_(part.contentType);
+    field.path = Piece_(part.path);
+    field.fd = part.fd;
+    field.size = part.size;
+    if (part.fd < 0) {
+      field.value = StringPiece(arena_->data() + part.value, part.size);
+    } else {
+      lseek(part.fd, 0, SEEK_SET);
+    }
+    fields_.push_back(field);
+  }
+  return true;
+}
+
+size_t FormData::Process_(const char* data, size_t len) {
+  const char* delim = delimiter_.data();
+  size_t dlen = delimiter_.size();
+  size_t i = 0;
+  while (i < len) {
+    const char* p = data + i;
+    size_t n = len - i;
+    switch (state_) {
+      case PREAMBLE:
+      case PART_DATA: {
+        /* 分隔符之前的都是内容(前导部分直接丢弃) */
+        const char* found =
+            static_cast<const char*>(memmem(p, n, delim, dlen));
+        size_t avail = found ? found - p : n - PartialDelimiter_(p, n);
+        if (state_ == PART_DATA && !AppendPart_(p, avail)) {
+          state_ = FAILED;
+          return i;
+        }
+        i += avail;
+        if (!found) {
+          return i;
+        }
+        i += dlen;
+        state_ = DELIMITER;
+        break;
+      }
+      case DELIMITER:
+        /* 分隔符之后可以有空白(transport padding) */
+        if (p[0] == ' ' || p[0] == '\t') {
+          ++i;
+          break;
+        }
+        if (n < 2) {
+          return i;
+        }
+        if (p[0] == '-' && p[1] == '-') {
+          state_ = EPILOGUE;
+        } else if (p[0] == '\r' && p[1] == '\n') {
+          state_ = PART_HEAD;
+        } else {
+          state_ = FAILED;
+          return i;
+        }
+        i += 2;
+        break;
+      case PART_HEAD: {
+        /* 头部以空行结束, 没有任何头部时直接是空行 */
+        size_t headLen = 0;
+        if (n >= 2 && p[0] == '\r' && p[1] == '\n') {
+          i += 2;
+        } else {
+          const char* found =
+              static_cast<const char*>(memmem(p, n, "\r\n\r\n", 4));
+          if (!found) {
+            if (n > MAX_PART_HEAD) state_ = FAILED;
+            return i;
+          }
+          headLen = found - p + 2;
+          i += headLen + 2;
+        }
+        if (headLen > MAX_PART_HEAD || !OpenPart_(p, headLen)) {
+          state_ = FAILED;
+          return i;
+        }
+        state_ = PART_DATA;
+        break;
+      }
+      case EPILOGUE:
+        /* 结束分隔符之后的内容忽略 */
+        return len;
+      default:
+        return i;
+    }
+  }
+  return i;
+}
+
+size_t FormData::PartialDelimiter_(const char* data, size_t len) const {
+  size_t dlen = delimiter_.size();
+  size_t i = (len >= dlen) ? len - dlen + 1 : 0;
+  for (; i < len; ++i) {
+    if (data[i] == '\r' &&
+        memcmp(data + i, delimiter_.data(), len - i) == 0) {
+      return len - i;
+    }
+  }
+  return 0;
+}
+
+bool FormData::Save_(const StringPiece& str, Span* span) {
+  if (arena_->size() + str.size() > fieldLimit_) {
+    tooLarge_ = true;
+    return false;
+  }
+  span->begin = static_cast<uint32_t>(arena_->size());
+  span->len = static_cast<uint32_t>(str.size());
+  arena_->append(str.data(), str.size());
+  return true;
+}
+
+bool FormData::OpenPart_(const char* head, size_t len) {
+  if (parts_.size() >= static_cast<size_t>(MAX_FIELDS)) {
+    return false;
+  }
+  /* 每行"Name: value\r\n", 只关心Content-Disposition与Content-Type */
+  StringPiece disposition, type;
+  StringPiece rest(head, len);
+  while (!rest.empty()) {
+    size_t eol = rest.find('\n');
+    StringPiece line = rest.substr(0, eol);
+    rest = rest.substr(eol == StringPiece::npos ? rest.size() : eol + 1);
+    size_t colon = line.find(':');
+    if (colon == StringPiece::npos) {
+      continue;
+    }
+    StringPiece name = Trim(line.substr(0, colon));
+    StringPiece value = line.substr(colon + 1);
+    if (!value.empty() && value[value.size() - 1] == '\r') {
+      value = value.substr(0, value.size() - 1);
+    }
+    if (name.EqualsIgnoreCase("Content-Disposition")) {
+      disposition = Trim(value);
+    } else if (name.EqualsIgnoreCase("Content-Type")) {
+      type = Trim(value);
+    }
+  }
+  StringPiece fieldName = Param(disposition, "name");
+  if (!MediaType(disposition).EqualsIgnoreCase("form-data") ||
+      fieldName.empty()) {
+    return false;
+  }
+  /* 带filename参数(即使为空)的是文件字段 */
+  StringPiece filename = Param(disposition, "filename");
+  bool isFile = filename.data() != nullptr;
+
+  Part part;
+  part.fd = -1;
+  part.size = 0;
+  part.path.begin = part.path.len = 0;
+  if (!Save_(fieldName, &part.name) || !Save_(filename, &part.filename) ||
+      !Save_(type, &part.contentType)) {
+    return false;
+  }
+  if (isFile) {
+    std::string path = uploadDir_ + "/orion-upload-XXXXXX";
+    part.fd = mkostemp(&path[0], O_CLOEXEC);
+    if (part.fd < 0) {
+      return false;
+    }
+    if (!Save_(path, &part.path)) {
+      close(part.fd);
+      unlink(path.c_str());
+      return false;
+    }
+  }
+  part.value = arena_->size();
+  parts_.push_back(part);
+  return true;
+}
+
+bool FormData::AppendPart_(const char* data, size_t len) {
+  if (len == 0) {
+    return true;
+  }
+  Part& part = parts_.back();
+  part.size += len;
+  if (part.fd < 0) {
+    if (arena_->size() + len > fieldLimit_) {
+      tooLarge_ = true;
+      return false;
+    }
+    arena_->append(data, len);
+    return true;
+  }
+  while (len > 0) {
+    ssize_t n = write(part.fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+}  // namespace webserver
@@ -5,9 +5,21 @@
  */
 #include "http/httpconnection.h"
 
+#include <string.h>        // memcmp
+#include <sys/mman.h>      // mmap, madvise
+#include <sys/sendfile.h>  // sendfile
+#include <sys/socket.h>    // sendmsg, shutdown
+#include <unistd.h>        // sysconf
+
+#include <algorithm>
+
+#include "http/router.h"
+
 namespace webserver {
 
 // const char* HttpConn::srcDir;
+const size_t HttpConn::STREAM_WINDOW;
+const size_t HttpConn::READ_BUDGET;
 std::string HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
@@ -16,31 +28,55 @@ HttpConn::HttpConn() {
   fd_ = -1;
   addr_ = {0};
   isClose_ = true;
+  isKeepAlive_ = false;
+  sendfile_ = false;
+  readPending_ = false;
+  async_ = ASYNC_IDLE;
+  iovIdx_ = 0;
+  fileIdx_ = 0;
+  fileIov_ = 0;
+  toWrite_ = 0;
+  window_ = nullptr;
+  windowLen_ = 0;
 };
 
 HttpConn::~HttpConn() { Close(); };
 
-void HttpConn::init(int fd, const sockaddr_in& addr) {
+void HttpConn::init(int fd, const sockaddr_in& addr, bool sendfile) {
   assert(fd > 0);
   ++userCount;
   addr_ = addr;
   fd_ = fd;
-  writeBuff_.RetrieveAll();
+  ResetOutput_();
   readBuff_.RetrieveAll();
+  request_.Init();
   isClose_ = false;
+  isKeepAlive_ = false;
+  sendfile_ = sendfile;
+  readPending_ = false;
+  async_ = ASYNC_IDLE;
   LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(),
            (int)userCount);
 }
 
 void HttpConn::Close() {
+  int fd = Release();
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+int HttpConn::Release() {
   response_.UnmapFile();
+  ResetOutput_();
   if (isClose_ == false) {
     isClose_ = true;
     userCount--;
-    close(fd_);
     LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(),
              (int)userCount);
+    return fd_;
   }
+  return -1;
 }
 
 int HttpConn::GetFd() const { return fd_; };
@@ -55,72 +91,389 @@ int HttpConn::GetPort() const { return addr_.sin_port; }
 
 ssize_t HttpConn::read(int* saveErrno) {
   ssize_t len = -1;
+  readPending_ = false;
   do {
     len = readBuff_.ReadFromFd(fd_, saveErrno);
     if (len <= 0) {
       break;
     }
+    /* 上传的请求体不整个读进缓冲区: 攒够READ_BUDGET先交给process解码,
+       ET模式下由调用者处理完后接着读(ReadPending) */
+    if (readBuff_.ReadableBytes() >= READ_BUDGET) {
+      readPending_ = isET;
+      break;
+    }
   } while (isET);
   return len;
 }
 
 ssize_t HttpConn::write(int* saveErrno) {
   ssize_t len = -1;
+  size_t sent = 0;
   do {
-    len = writev(fd_, iov_, iovCnt_);
+    len = Send_();
     if (len <= 0) {
       *saveErrno = errno;
       break;
     }
-    if (iov_[0].iov_len + iov_[1].iov_len == 0) {
+    HasWritten(len);
+    if (toWrite_ == 0) {
       break;
     } /* 传输结束 */
-    else if (static_cast<size_t>(len) > iov_[0].iov_len) {
-      iov_[1].iov_base = (uint8_t*)iov_[1].iov_base + (len - iov_[0].iov_len);
-      iov_[1].iov_len -= (len - iov_[0].iov_len);
-      if (iov_[0].iov_len) {
-        writeBuff_.RetrieveAll();
-        iov_[0].iov_len = 0;
+    sent += len;
+    /* ET模式须写到EAGAIN才会有下一次通知; LT模式下大文件每次只发送一个
+       窗口, 重新注册EPOLLOUT后轮到其他连接 */
+  } while (isET || (ToWriteBytes() > 10240 && sent < STREAM_WINDOW));
+  return len;
+}
+
+/* 文件段用sendfile发送, 其余连续的内存段合并为一次sendmsg; 内存段之后紧跟
+   文件段时带MSG_MORE, 让响应头与文件开头合并成完整的TCP报文段, 效果与
+   TCP_CORK相同但不需要额外的setsockopt */
+ssize_t HttpConn::Send_() {
+  const iovec* iov = iov_.data() + iovIdx_;
+  size_t left = iov_.size() - iovIdx_;
+  if (iov->iov_base == nullptr) {
+    const Piece& piece = pieces_[fileIdx_];
+    off_t off = piece.off;  // 偏移由HasWritten推进, EAGAIN后从断点继续
+    ssize_t len = sendfile(fd_, piece.fd, &off, iov->iov_len);
+    if (len == 0) {
+      errno = EIO;  // 文件在发送过程中被截断
+      return -1;
+    }
+    return len;
+  }
+  size_t cnt = 1;
+  while (cnt < left && iov[cnt].iov_base) {
+    ++cnt;
+  }
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = const_cast<iovec*>(iov);
+  msg.msg_iovlen = cnt;
+  return sendmsg(fd_, &msg, MSG_NOSIGNAL | (cnt < left ? MSG_MORE : 0));
+}
+
+bool HttpConn::AddCachedResponse_(const std::string& path,
+                                  Compressor::ENCODING encoding) {
+  FileCache::EntryPtr file = FileCache::Instance()->Get(path);
+  ResponseCache::ResponsePtr cached =
+      ResponseCache::Instance()->Get(path, isKeepAlive_, encoding, file);
+  if (!cached) {
+    return false;
+  }
+  AddCachedPieces_(cached);
+  return true;
+}
+
+/* 缓存的响应中的Date行已过时, 换成写缓冲区中当前时间的Date行 */
+void HttpConn::AddCachedPieces_(const ResponseCache::ResponsePtr& cached) {
+  size_t dateOff = HttpResponse::DateOffset(200);
+  size_t rest = dateOff + HttpResponse::DATE_LINE_LEN;
+  assert(cached->size() >= rest);
+  pieces_.push_back({cached, cached->data(), -1, 0, dateOff});
+  pieces_.push_back({nullptr, nullptr, -1, writeBuff_.ReadableBytes(),
+                     HttpResponse::DATE_LINE_LEN});
+  HttpResponse::AddDate(writeBuff_);
+  pieces_.push_back(
+      {cached, cached->data() + rest, -1, 0, cached->size() - rest});
+}
+
+bool HttpConn::NextFile_(size_t piece, size_t iov) {
+  while (piece < pieces_.size() && pieces_[piece].fd < 0) {
+    ++piece;
+  }
+  while (iov < iov_.size() && iov_[iov].iov_base) {
+    ++iov;
+  }
+  fileIdx_ = piece;
+  fileIov_ = iov;
+  UnmapWindow_();
+  return sendfile_ || piece == pieces_.size() || MapWindow_();
+}
+
+/* 窗口从off所在的页开始; 顺序访问的提示让内核加大预读并及时回收已发送
+   的页, WILLNEED则立即开始读入整个窗口 */
+bool HttpConn::MapWindow_() {
+  static const size_t PAGE = sysconf(_SC_PAGESIZE);
+  UnmapWindow_();
+  const Piece& piece = pieces_[fileIdx_];
+  size_t base = piece.off - piece.off % PAGE;
+  size_t skip = piece.off - base;
+  size_t len = std::min(STREAM_WINDOW, skip + piece.len);
+  void* addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, piece.fd, base);
+  if (addr == MAP_FAILED) {
+    LOG_ERROR("Client[%d] mmap window failed, errno %d", fd_, errno);
+    iov_[fileIov_] = {nullptr, piece.len};
+    shutdown(fd_, SHUT_RDWR);
+    return false;
+  }
+  madvise(addr, len, MADV_SEQUENTIAL);
+  madvise(addr, len, MADV_WILLNEED);
+  window_ = addr;
+  windowLen_ = len;
+  iov_[fileIov_] = {static_cast<char*>(addr) + skip, len - skip};
+  return true;
+}
+
+void HttpConn::UnmapWindow_() {
+  if (window_) {
+    munmap(window_, windowLen_);
+    window_ = nullptr;
+    windowLen_ = 0;
+  }
+}
+
+iovec HttpConn::ReadSpace(size_t len) {
+  readBuff_.EnsureWritable(len);
+  iovec iov;
+  iov.iov_base = readBuff_.WriteBeginPtr();
+  iov.iov_len = readBuff_.PostWritableBytes();
+  return iov;
+}
+
+void HttpConn::HasRead(size_t len) { readBuff_.CompleteWriting(len); }
+
+const iovec* HttpConn::WriteIov(int* iovCnt) const {
+  assert(!sendfile_);
+  /* 只提交到当前窗口为止, 之后的文件段轮到时才映射 */
+  size_t cnt = 1;
+  while (iovIdx_ + cnt < iov_.size() && iov_[iovIdx_ + cnt].iov_base) {
+    ++cnt;
+  }
+  *iovCnt = static_cast<int>(cnt);
+  return iov_.data() + iovIdx_;
+}
+
+/* 根据已写出的字节数推进输出链, 全部写完后解除映射、清空writeBuff_ */
+void HttpConn::HasWritten(size_t len) {
+  assert(len <= toWrite_);
+  toWrite_ -= len;
+  while (len > 0) {
+    iovec& iov = iov_[iovIdx_];
+    size_t n = std::min(len, iov.iov_len);
+    iov.iov_len -= n;
+    len -= n;
+    if (iov.iov_base) {
+      iov.iov_base = static_cast<uint8_t*>(iov.iov_base) + n;
+    }
+    if (iovIdx_ != fileIov_) {
+      if (iov.iov_len == 0) {
+        ++iovIdx_;
       }
-    } else {
-      iov_[0].iov_base = (uint8_t*)iov_[0].iov_base + len;
-      iov_[0].iov_len -= len;
-      writeBuff_.Retrieve(len);
+      continue;
     }
-  } while (isET || ToWriteBytes() > 10240);
-  return len;
+    Piece& piece = pieces_[fileIdx_];
+    piece.off += n;
+    piece.len -= n;
+    bool mapped = true;
+    if (piece.len == 0) {
+      ++iovIdx_;
+      mapped = NextFile_(fileIdx_ + 1, iovIdx_);
+    } else if (iov.iov_len == 0) {
+      mapped = MapWindow_();  // 窗口已发送完, 映射下一个窗口
+    }
+    if (!mapped) {
+      return;
+    }
+  }
+  if (toWrite_ == 0) {
+    ResetOutput_();
+  }
 }
 
-bool HttpConn::process() {
-  // 此处处理http请求
-  request_.Init();
-  if (readBuff_.ReadableBytes() <= 0) {
-    // 请求内容为空，那么epoll中events修改为EPOLLIN，继续监听
+/* POST要解码请求体(可能写临时文件), 路由到可能阻塞的处理者(如访问
+   数据库)的请求也交给线程池; 请求行不完整时本次不会调用处理者 */
+bool HttpConn::IsInlineable() const {
+  static const char post[] = "POST";
+  if (request_.InBody()) {
+    return false;
+  }
+  const char* begin = readBuff_.ReadBeginPtr();
+  size_t size = readBuff_.ReadableBytes();
+  size_t len = std::min(size, sizeof(post) - 1);
+  if (len > 0 && memcmp(begin, post, len) == 0) {
     return false;
-  } else if (request_.parse(readBuff_)) {
-    // 存在有效请求，处理
-    LOG_DEBUG("%s", request_.path().c_str());
-    response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
-  } else {
-    // 无效请求
-    response_.Init(srcDir, request_.path(), false, 400);
   }
+  const char* sp = static_cast<const char*>(memchr(begin, ' ', size));
+  if (!sp) {
+    return true;
+  }
+  const char* target = sp + 1;
+  const char* end = static_cast<const char*>(
+      memchr(target, ' ', begin + size - target));
+  if (!end) {
+    return true;
+  }
+  return Router::Instance()->IsInlineable(StringPiece(begin, sp - begin),
+                                          StringPiece(target, end - target));
+}
 
-  response_.MakeResponse(writeBuff_);
-  /* 响应头 */
-  iov_[0].iov_base = const_cast<char*>(writeBuff_.ReadBeginPtr());
-  iov_[0].iov_len = writeBuff_.ReadableBytes();
-  iovCnt_ = 1;
+bool HttpConn::process(bool inlineOnly) {
+  assert(toWrite_ == 0 && !IsPending());
+  ResetOutput_();
+  int cnt = 0;
+  // 此处处理http请求, 读缓冲区中可能有多个流水线请求
+  while (cnt < MAX_PIPELINE && readBuff_.ReadableBytes() > 0) {
+    if (inlineOnly && !IsInlineable()) {
+      break;
+    }
+    HttpRequest::HTTP_CODE code = request_.parse(readBuff_);
+    if (code == HttpRequest::NO_REQUEST) {
+      // 请求不完整, 保留已收到的数据, 继续监听EPOLLIN
+      if (request_.TakeContinue()) {
+        /* 客户端收到100 Continue才发送请求体, 否则要等它超时 */
+        static const char CONTINUE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        size_t off = writeBuff_.ReadableBytes();
+        writeBuff_.Append(CONTINUE, sizeof(CONTINUE) - 1);
+        pieces_.push_back({nullptr, nullptr, -1, off, sizeof(CONTINUE) - 1});
+        isKeepAlive_ = true;
+        ++cnt;
+      }
+      break;
+    } else if (code == HttpRequest::GET_REQUEST) {
+      // 存在有效请求，处理
+      LOG_DEBUG("%s", request_.path().c_str());
+      bool keepAlive = request_.IsKeepAlive();
+      Compressor::ENCODING encoding = request_.AcceptedEncoding();
+      /* 路由的处理者可以改为回复其它文件或直接给出内容, 没有匹配的路由
+         时回复与请求路径同名的静态文件 */
+      response_.Init(srcDir, request_.path(), keepAlive, 200, encoding);
+      /* 先置为WAITING: done可能在Dispatch返回之前就在其它线程中被调用 */
+      async_ = ASYNC_WAITING;
+      if (Router::Instance()->Dispatch(request_, response_, completion_) ==
+          Router::PENDING) {
+        /* 回复在Resume时生成, 之后的请求也要等到那时; isKeepAlive_仍是
+           输出链中上一个响应的 */
+        break;
+      }
+      async_ = ASYNC_IDLE;
+      isKeepAlive_ = keepAlive;
+      AddResponse_(encoding);
+    } else {
+      // 无效请求, 之后的数据无法再定界, 丢弃并关闭连接
+      readBuff_.RetrieveAll();
+      isKeepAlive_ = false;
+      response_.Init(srcDir, request_.path(), false,
+                     code == HttpRequest::PAYLOAD_TOO_LARGE ? 413 : 400);
+      AddPieces_(false, Compressor::IDENTITY);
+    }
+    ++cnt;
+    if (!isKeepAlive_) {
+      break;
+    }
+  }
+  if (cnt == 0) {
+    return false;
+  }
+
+  BuildIov_();
+  LOG_DEBUG("%d responses, %d iovecs, %d bytes", cnt, (int)iov_.size(),
+            ToWriteBytes());
+  return true;
+}
 
-  /* 文件 */
-  if (response_.FileLen() > 0 && response_.File()) {
-    iov_[1].iov_base = response_.File();
-    iov_[1].iov_len = response_.FileLen();
-    iovCnt_ = 2;
+void HttpConn::Complete() {
+  assert(async_ == ASYNC_WAITING);
+  async_ = ASYNC_DONE;
+}
+
+bool HttpConn::Resume() {
+  if (async_ != ASYNC_DONE) {
+    return false;
   }
-  LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen(), iovCnt_,
+  assert(toWrite_ == 0);
+  async_ = ASYNC_IDLE;
+  ResetOutput_();
+  isKeepAlive_ = request_.IsKeepAlive();
+  AddResponse_(request_.AcceptedEncoding());
+  BuildIov_();
+  LOG_DEBUG("Async response of %s, %d bytes", request_.path().c_str(),
             ToWriteBytes());
   return true;
 }
 
+void HttpConn::AddResponse_(Compressor::ENCODING encoding) {
+  /* 条件请求可能以304回复, 范围请求只发送部分内容, 都不使用缓存的
+     完整响应 */
+  StringPiece ifNoneMatch = request_.GetHeader("If-None-Match");
+  StringPiece ifModifiedSince = request_.GetHeader("If-Modified-Since");
+  StringPiece range = request_.GetHeader("Range");
+  if (response_.Code() == 200 && !response_.HasContent() &&
+      ifNoneMatch.empty() && ifModifiedSince.empty() && range.empty() &&
+      AddCachedResponse_(response_.FullPath(), encoding)) {
+    return;
+  }
+  response_.SetConditional(ifNoneMatch, ifModifiedSince);
+  response_.SetRange(range, request_.GetHeader("If-Range"));
+  AddPieces_(true, encoding);
+}
+
+void HttpConn::AddPieces_(bool cacheable, Compressor::ENCODING encoding) {
+  /* 响应头 */
+  size_t off = writeBuff_.ReadableBytes();
+  response_.MakeResponse(writeBuff_);
+  size_t headLen = response_.HeadLen();
+  ResponseCache::ResponsePtr cached;
+  if (cacheable && response_.Code() == 200) {
+    cached = ResponseCache::Instance()->Put(
+        response_.FullPath(), isKeepAlive_, encoding,
+        response_.FileEntry(), writeBuff_.ReadBeginPtr() + off, headLen,
+        response_.Body(), response_.BodyLen());
+  }
+  if (cached) {
+    /* 已拼成完整响应, 写缓冲区中的响应头不再发送, 随输出链一起清空 */
+    AddCachedPieces_(cached);
+    response_.UnmapFile();
+    return;
+  }
+  pieces_.push_back({nullptr, nullptr, -1, off, headLen});
+  /* 内容段, 原文且缓存条目保留了fd的(不小于FD_MIN)由内核直接从页缓存
+     发送, 没有整体映射的大文件按窗口映射; 多段响应的分段头在写缓冲区中 */
+  std::shared_ptr<const void> owner = response_.DetachBody();
+  for (const HttpResponse::Segment& seg : response_.Segments()) {
+    if (!seg.data && seg.fd < 0) {
+      pieces_.push_back({nullptr, nullptr, -1, seg.off, seg.len});
+    } else if (seg.fd >= 0 && (sendfile_ || !seg.data)) {
+      pieces_.push_back({owner, nullptr, seg.fd, seg.off, seg.len});
+    } else {
+      pieces_.push_back({owner, seg.data, -1, 0, seg.len});
+    }
+  }
+}
+
+void HttpConn::BuildIov_() {
+  const char* base = writeBuff_.ReadBeginPtr();
+  for (const Piece& piece : pieces_) {
+    toWrite_ += piece.len;
+    if (piece.fd >= 0) {
+      iov_.push_back({nullptr, piece.len});
+      continue;
+    }
+    char* data = const_cast<char*>(piece.data ? piece.data : base + piece.off);
+    if (!piece.data && !iov_.empty() && iov_.back().iov_base &&
+        static_cast<char*>(iov_.back().iov_base) + iov_.back().iov_len ==
+            data) {
+      /* 相邻的响应头(如两个错误页面)合并为一个iovec */
+      iov_.back().iov_len += piece.len;
+    } else {
+      iov_.push_back({data, piece.len});
+    }
+  }
+  NextFile_(0, 0);
+}
+
+void HttpConn::ResetOutput_() {
+  UnmapWindow_();
+  pieces_.clear();  // 释放对缓存条目的引用
+  iov_.clear();
+  iovIdx_ = 0;
+  fileIdx_ = 0;
+  fileIov_ = 0;
+  toWrite_ = 0;
+  if (writeBuff_.ReadableBytes() > 0) {
+    writeBuff_.RetrieveAll();
+  }
+}
+
 }  // namespace webserver
\ No newline at end of file
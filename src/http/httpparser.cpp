@@ -0,0 +1,203 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-26
+ * @copyleft Apache 2.0
+ */
+
+#include "http/httpparser.h"
+
+#include "http/httpscanner.h"
+
+namespace webserver {
+
+const int HttpParser::MAX_HEADERS;
+const size_t HttpParser::MAX_HEAD_SIZE;
+
+void HttpParser::Reset() {
+  state_ = METHOD;
+  pos_ = mark_ = consumed_ = 0;
+  base_ = nullptr;
+  method_ = target_ = version_ = MakeSpan_(0, 0);
+  header_cnt_ = 0;
+  keep_alive_ = false;
+  content_length_ = 0;
+  chunked_ = false;
+}
+
+HttpParser::STATUS HttpParser::Parse(const char* data, size_t len) {
+  base_ = data;
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+  const char* end = data + len;
+  size_t i = pos_;
+
+  /* 每个分支扫描到token结束; 数据不足时i == len, 退出循环等待下次继续。
+     token由HttpScanner批量扫描, 停下的字符若不是预期的分隔符即为非法字符 */
+  while (i < len && state_ < DONE) {
+    switch (state_) {
+      case METHOD:
+        /* 忽略请求之前多余的空行(如上一个POST body之后的CRLF) */
+        if (i == mark_ && (p[i] == '\r' || p[i] == '\n')) {
+          mark_ = ++i;
+          break;
+        }
+        i = HttpScanner::FindTokenEnd(data + i, end) - data;
+        if (i == len) break;
+        if (p[i] != ' ' || i == mark_) return ERROR;
+        method_ = MakeSpan_(mark_, i);
+        mark_ = ++i;
+        state_ = TARGET;
+        break;
+      case TARGET:
+        i = HttpScanner::FindTargetEnd(data + i, end) - data;
+        if (i == len) break;
+        if (p[i] != ' ' || i == mark_) return ERROR;
+        target_ = MakeSpan_(mark_, i);
+        if (!SafePath_(Target())) return ERROR;
+        mark_ = ++i;
+        state_ = VERSION;
+        break;
+      case VERSION: {
+        while (i < len && p[i] != '\r' && p[i] != '\n') ++i;
+        if (i == len) break;
+        StringPiece version(data + mark_, i - mark_);
+        if (version.size() != 8 || !version.StartsWith("HTTP/")) {
+          return ERROR;
+        }
+        version_ = MakeSpan_(mark_ + 5, i);
+        state_ = (p[i] == '\r') ? REQUEST_LINE_LF : HEADER_START;
+        ++i;
+        break;
+      }
+      case REQUEST_LINE_LF:
+        if (p[i++] != '\n') return ERROR;
+        state_ = HEADER_START;
+        break;
+      case HEADER_START:
+        if (p[i] == '\r' || p[i] == '\n') {
+          /* 空行, 头部结束 */
+          if (p[i] == '\r') ++i;
+          state_ = HEAD_END_LF;
+          break;
+        }
+        if (header_cnt_ == MAX_HEADERS) return ERROR;
+        mark_ = i;
+        state_ = HEADER_NAME;
+        break;
+      case HEADER_NAME:
+        i = HttpScanner::FindTokenEnd(data + i, end) - data;
+        if (i == len) break;
+        if (p[i] != ':' || i == mark_) return ERROR;
+        headers_[header_cnt_].name = MakeSpan_(mark_, i);
+        ++i;
+        state_ = HEADER_VALUE_START;
+        break;
+      case HEADER_VALUE_START:
+        while (i < len && (p[i] == ' ' || p[i] == '\t')) ++i;
+        if (i == len) break;
+        mark_ = i;
+        state_ = HEADER_VALUE;
+        break;
+      case HEADER_VALUE: {
+        i = HttpScanner::FindValueEnd(data + i, end) - data;
+        if (i == len) break;
+        /* 字段值以CRLF(或单独的LF)结束, 其他控制字符都是非法的 */
+        size_t next = i + 1;
+        if (p[i] == '\r') {
+          if (next == len) {
+            /* 等待LF, 下次从CR处重新判断 */
+            pos_ = i;
+            return INCOMPLETE;
+          }
+          if (p[next++] != '\n') return ERROR;
+        } else if (p[i] != '\n') {
+          return ERROR;
+        }
+        size_t valueEnd = i;
+        while (valueEnd > mark_ &&
+               (p[valueEnd - 1] == ' ' || p[valueEnd - 1] == '\t')) {
+          --valueEnd;
+        }
+        headers_[header_cnt_++].value = MakeSpan_(mark_, valueEnd);
+        i = next;
+        state_ = HEADER_START;
+        break;
+      }
+      case HEAD_END_LF:
+        if (p[i++] != '\n') return ERROR;
+        if (!OnHeadersComplete_()) return ERROR;
+        consumed_ = i;
+        state_ = DONE;
+        break;
+      default:
+        break;
+    }
+  }
+  pos_ = i;
+
+  if (state_ < DONE) {
+    return (pos_ > MAX_HEAD_SIZE) ? ERROR : INCOMPLETE;
+  }
+  return (consumed_ > MAX_HEAD_SIZE) ? ERROR : COMPLETE;
+}
+
+StringPiece HttpParser::GetHeader(const StringPiece& name) const {
+  for (int i = 0; i < header_cnt_; ++i) {
+    StringPiece field = HeaderName(i);
+    if (field.EqualsIgnoreCase(name)) {
+      return HeaderValue(i);
+    }
+  }
+  return StringPiece();
+}
+
+bool HttpParser::SafePath_(const StringPiece& target) {
+  StringPiece path = target.substr(0, target.find('?'));
+  while (!path.empty()) {
+    size_t slash = path.find('/');
+    StringPiece seg = path.substr(0, slash);
+    if (seg == ".." || seg.EqualsIgnoreCase(".%2e") ||
+        seg.EqualsIgnoreCase("%2e.") || seg.EqualsIgnoreCase("%2e%2e")) {
+      return false;
+    }
+    if (slash == StringPiece::npos) break;
+    path.RemovePrefix(slash + 1);
+  }
+  return true;
+}
+
+bool HttpParser::OnHeadersComplete_() {
+  keep_alive_ = (Version() == "1.1");
+  bool hasLength = false;
+  for (int i = 0; i < header_cnt_; ++i) {
+    StringPiece name = HeaderName(i);
+    StringPiece value = HeaderValue(i);
+    if (name.EqualsIgnoreCase("Connection")) {
+      if (value.EqualsIgnoreCase("close")) {
+        keep_alive_ = false;
+      } else if (value.EqualsIgnoreCase("keep-alive")) {
+        keep_alive_ = true;
+      }
+    } else if (name.EqualsIgnoreCase("Content-Length")) {
+      /* 只接受纯数字, 重复且不一致的Content-Length可能被用于请求走私 */
+      if (value.empty()) return false;
+      size_t length = 0;
+      for (size_t k = 0; k < value.size(); ++k) {
+        if (value[k] < '0' || value[k] > '9') return false;
+        if (length > (SIZE_MAX - 9) / 10) return false;
+        length = length * 10 + (value[k] - '0');
+      }
+      if (hasLength && length != content_length_) return false;
+      content_length_ = length;
+      hasLength = true;
+    } else if (name.EqualsIgnoreCase("Transfer-Encoding")) {
+      /* 只支持单独的chunked; 其他编码无法确定报文边界 */
+      if (chunked_ || !value.EqualsIgnoreCase("chunked")) return false;
+      chunked_ = true;
+    }
+  }
+  /* 同时带有Transfer-Encoding与Content-Length的请求可能被用于请求走私 */
+  if (chunked_ && hasLength) return false;
+  return true;
+}
+
+}  // namespace webserver
@@ -7,272 +7,217 @@
 
 namespace webserver {
 
-const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML{
-    "/index", "/register", "/login", "/welcome", "/video", "/picture",
-};
-
-// 通过文件名区分是登录行为还是注册行为
-const std::unordered_map<std::string, int> HttpRequest::DEFAULT_HTML_TAG{
-    {"/register.html", 0},
-    {"/login.html", 1},
-};
+const size_t HttpRequest::BODY_KEEP;
+size_t HttpRequest::maxBodySize = 1024 * 1024;
+size_t HttpRequest::maxUploadSize = 64 * 1024 * 1024;
+HttpRequest::BodyHandler HttpRequest::bodyHandler;
+std::string HttpRequest::uploadDir = "/tmp";
 
 void HttpRequest::Init() {
-  method_ = path_ = version_ = body_ = "";
-  state_ = REQUEST_LINE;
-  header_.clear();
-  post_.clear();
+  path_.clear();
+  /* 上一个请求的临时文件路径在body_中, 先于body_清空 */
+  form_.Reset();
+  json_.Reset();
+  /* 较大的请求体不在连接上长期占用内存 */
+  if (body_.capacity() > BODY_KEEP) {
+    std::string().swap(body_);
+  }
+  body_.clear();
+  params_.clear();
+  parser_.Reset();
+  reader_.Reset();
+  finished_ = false;
+  keep_alive_ = false;
+  inBody_ = false;
+  expectContinue_ = false;
+  streamed_ = false;
 }
 
-bool HttpRequest::IsKeepAlive() const {
-  if (header_.count("Connection") == 1) {
-    return header_.find("Connection")->second == "keep-alive" &&
-           version_ == "1.1";
-  }
-  return false;
-}
+bool HttpRequest::IsKeepAlive() const { return keep_alive_; }
 
-bool HttpRequest::parse(StringBuffer& buff) {
-  const char CRLF[] = "\r\n";
-  if (buff.ReadableBytes() <= 0) {
-    return false;
+HttpRequest::HTTP_CODE HttpRequest::parse(StringBuffer& buff) {
+  if (finished_) {
+    Init();
   }
-  while (buff.ReadableBytes() && state_ != FINISH) {
-    const char* lineEnd = std::search(
-        buff.ReadBeginPtr(), static_cast<const char*>(buff.WriteBeginPtr()),
-        CRLF, CRLF + 2);
-    std::string line(buff.ReadBeginPtr(), lineEnd);
-    switch (state_) {
-      case REQUEST_LINE:
-        if (!ParseRequestLine_(line)) {
-          return false;
-        }
-        ParsePath_();
-        break;
-      case HEADERS:
-        ParseHeader_(line);
-        if (buff.ReadableBytes() <= 2) {
-          state_ = FINISH;
-        }
-        break;
-      case BODY:
-        ParseBody_(line);
-        break;
-      default:
-        break;
+  if (!inBody_) {
+    HttpParser::STATUS status =
+        parser_.Parse(buff.ReadBeginPtr(), buff.ReadableBytes());
+    if (status == HttpParser::INCOMPLETE) {
+      return NO_REQUEST;
     }
-    if (lineEnd == buff.WriteBeginPtr()) {
-      break;
+    if (status == HttpParser::ERROR) {
+      finished_ = true;
+      LOG_ERROR("Bad request");
+      return BAD_REQUEST;
     }
-    buff.RetrieveUntil(lineEnd + 2);
-  }
-  LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(),
-            version_.c_str());
-  return true;
-}
 
-void HttpRequest::ParsePath_() {
-  if (path_ == "/") {
-    path_ = "/index.html";
-  } else {
-    for (auto& item : DEFAULT_HTML) {
-      if (item == path_) {
-        path_ += ".html";
-        break;
-      }
+    keep_alive_ = parser_.IsKeepAlive();
+    StringPiece target = parser_.Target();
+    path_.assign(target.data(), target.size());
+    LOG_DEBUG("[%.*s], [%s], [%.*s]", (int)parser_.Method().size(),
+              parser_.Method().data(), path_.c_str(),
+              (int)parser_.Version().size(), parser_.Version().data());
+    if (!parser_.HasBody()) {
+      finished_ = true;
+      /* 只移动读指针, 数据仍在缓冲区中, StringPiece在下次读入前保持有效 */
+      buff.Retrieve(parser_.Consumed());
+      return GET_REQUEST;
+    }
+    StartBody_(buff);
+  }
+
+  size_t used = 0;
+  BodyReader::STATUS status =
+      reader_.Feed(buff.ReadBeginPtr(), buff.ReadableBytes(), &used);
+  buff.Retrieve(used);
+  if (status == BodyReader::INCOMPLETE) {
+    return NO_REQUEST;
+  }
+  finished_ = true;
+  inBody_ = false;
+  size_t received = reader_.Received();
+  /* 请求体结束即释放Sink, 流式处理时由它持有的资源(如上传文件)随之关闭 */
+  reader_.Reset();
+  if (status == BodyReader::TOO_LARGE) {
+    LOG_WARN("Request body too large, %zu bytes received", received);
+    return PAYLOAD_TOO_LARGE;
+  }
+  if (status == BodyReader::ERROR) {
+    if (form_.TooLarge()) {
+      LOG_WARN("Form fields too large, %zu bytes received", received);
+      return PAYLOAD_TOO_LARGE;
     }
+    LOG_ERROR("Bad request body");
+    return BAD_REQUEST;
   }
+  if (!ParsePost_()) {
+    LOG_ERROR("Bad %.*s body", (int)ContentType_().size(),
+              ContentType_().data());
+    return BAD_REQUEST;
+  }
+  return GET_REQUEST;
 }
 
-bool HttpRequest::ParseRequestLine_(const std::string& line) {
-  std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-  std::smatch subMatch;
-  if (std::regex_match(line, subMatch, patten)) {
-    method_ = subMatch[1];
-    path_ = subMatch[2];
-    version_ = subMatch[3];
-    state_ = HEADERS;
-    return true;
+void HttpRequest::KeepHead() {
+  StringPiece head = parser_.Head();
+  if (head.data() == head_.data()) {
+    return;  // 有请求体, 已经是副本
   }
-  LOG_ERROR("RequestLine Error");
-  return false;
+  head_.assign(head.data(), head.size());
+  parser_.Rebase(head_.data());
 }
 
-void HttpRequest::ParseHeader_(const std::string& line) {
-  std::regex patten("^([^:]*): ?(.*)$");
-  std::smatch subMatch;
-  if (std::regex_match(line, subMatch, patten)) {
-    header_[subMatch[1]] = subMatch[2];
+void HttpRequest::StartBody_(StringBuffer& buff) {
+  /* 读缓冲区中的头部取走后会被请求体覆盖, 解析结果改为指向副本 */
+  head_.assign(buff.ReadBeginPtr(), parser_.Consumed());
+  parser_.Parse(head_.data(), head_.size());
+  buff.Retrieve(head_.size());
+
+  BodyReader::Sink sink;
+  if (bodyHandler) {
+    sink = bodyHandler(*this);
+  }
+  size_t limit = maxUploadSize;
+  streamed_ = static_cast<bool>(sink);
+  if (!sink && ContentType_().EqualsIgnoreCase("multipart/form-data") &&
+      form_.InitMultipart(parser_.GetHeader("Content-Type"), &body_,
+                          maxBodySize, uploadDir)) {
+    /* 文件字段边收边写入临时文件, 只有普通字段占用body_ */
+    sink = [this](const char* data, size_t len) {
+      return form_.Feed(data, len);
+    };
+  }
+  if (!sink) {
+    limit = maxBodySize;
+    if (parser_.ContentLength() <= limit) {
+      body_.reserve(parser_.ContentLength());
+    }
+    sink = [this](const char* data, size_t len) {
+      body_.append(data, len);
+      return true;
+    };
+  }
+  if (parser_.IsChunked()) {
+    reader_.InitChunked(limit, sink);
   } else {
-    state_ = BODY;
+    reader_.InitLength(parser_.ContentLength(), limit, sink);
   }
+  inBody_ = true;
+  expectContinue_ = parser_.Version() == "1.1" &&
+                    parser_.GetHeader("Expect").EqualsIgnoreCase("100-continue");
 }
 
-void HttpRequest::ParseBody_(const std::string& line) {
-  body_ = line;
-  ParsePost_();
-  state_ = FINISH;
-  LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+bool HttpRequest::TakeContinue() {
+  /* 请求体已经开始到达时客户端没有在等待 */
+  if (!expectContinue_ || !inBody_ || reader_.Received() > 0) {
+    return false;
+  }
+  expectContinue_ = false;
+  return true;
 }
 
-int HttpRequest::ConverHex(char ch) {
-  if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
-  if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
-  return ch;
+StringPiece HttpRequest::ContentType_() const {
+  return FormData::MediaType(parser_.GetHeader("Content-Type"));
 }
 
-void HttpRequest::ParsePost_() {
-  if (method_ == "POST" &&
-      header_["Content-Type"] == "application/x-www-form-urlencoded") {
-    ParseFromUrlencoded_();
-    if (DEFAULT_HTML_TAG.count(path_)) {
-      int tag = DEFAULT_HTML_TAG.find(path_)->second;
-      LOG_DEBUG("Tag:%d", tag);
-      if (tag == 0 || tag == 1) {
-        bool isLogin = (tag == 1);
-        if (UserVerify(post_["username"], post_["password"], isLogin)) {
-          path_ = "/welcome.html";
-        } else {
-          path_ = "/error.html";
-        }
-      }
-    }
-  }
-}
-
-// 解析http报文body部分内容，在本项目中为username&password
-void HttpRequest::ParseFromUrlencoded_() {
-  if (body_.size() == 0) {
-    return;
+bool HttpRequest::ParsePost_() {
+  if (!parser_.HasBody() || streamed_) {
+    return true;
   }
-
-  std::string key, value;
-  int num = 0;
-  int n = body_.size();
-  int i = 0, j = 0;
-
-  for (; i < n; i++) {
-    char ch = body_[i];
-    switch (ch) {
-      case '=':
-         key = body_.substr(j, i - j);
-        j = i + 1;
-        break;
-      case '+':
-        body_[i] = ' ';
-        break;
-      case '%':
-        num = ConverHex(body_[i + 1]) * 16 + ConverHex(body_[i + 2]);
-        body_[i + 2] = num % 10 + '0';
-        body_[i + 1] = num / 10 + '0';
-        i += 2;
-        break;
-      case '&':
-        value = body_.substr(j, i - j);
-        j = i + 1;
-        post_[key] = value;
-        LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
-        break;
-      default:
-        break;
+  StringPiece type = ContentType_();
+  if (type.EqualsIgnoreCase("application/x-www-form-urlencoded")) {
+    /* 表单中可能有密码, 只记录长度 */
+    LOG_DEBUG("Urlencoded body, len:%zu", body_.size());
+    form_.ParseUrlencoded(&body_[0], body_.size());
+  } else if (type.EqualsIgnoreCase("multipart/form-data")) {
+    if (!form_.Finish()) {
+      return false;
+    }
+  } else if (type.EqualsIgnoreCase("application/json")) {
+    if (!json_.Parse(&body_[0], body_.size())) {
+      return false;
     }
   }
-  assert(j <= i);
-  if (post_.count(key) == 0 && j < i) {
-    value = body_.substr(j, i - j);
-    post_[key] = value;
-  }
+  return true;
 }
 
-bool HttpRequest::UserVerify(const std::string& name, const std::string& pwd,
-                             bool isLogin) {
-  if (name == "" || pwd == "") {
-    return false;
-  }
-  LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
-  MYSQL* sql;
-  SqlConnRAII(&sql, SqlConnPool::Instance());
-  assert(sql);
+std::string HttpRequest::path() const { return path_; }
 
-  bool flag = false;
-  // int j = 0;
-  char order[256] = {0};
-  // MYSQL_FIELD* fields = nullptr;
-  MYSQL_RES* res = nullptr;
+std::string& HttpRequest::path() { return path_; }
+StringPiece HttpRequest::method() const { return parser_.Method(); }
 
-  if (!isLogin) {
-    flag = true;
-  }
-  /* 查询用户及密码 */
-  snprintf(order, 256,
-           "SELECT username, password FROM user WHERE username='%s' LIMIT 1",
-           name.c_str());
-  LOG_DEBUG("%s", order);
+StringPiece HttpRequest::version() const { return parser_.Version(); }
 
-  if (mysql_query(sql, order)) {
-    mysql_free_result(res);
-    return false;
-  }
-  res = mysql_store_result(sql);
-  // j = mysql_num_fields(res);
-  // fields = mysql_fetch_fields(res);
+StringPiece HttpRequest::GetHeader(const char* name) const {
+  return parser_.GetHeader(name);
+}
 
-  while (MYSQL_ROW row = mysql_fetch_row(res)) {
-    LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-    std::string password(row[1]);
-    /* 登录行为 核验密码*/
-    if (isLogin) {
-      if (pwd == password) {
-        flag = true;
-      } else {
-        flag = false;
-        LOG_DEBUG("pwd error!");
-      }
-    } else {
-      flag = false;
-      LOG_DEBUG("user used!");
-    }
-  }
-  mysql_free_result(res);
+Compressor::ENCODING HttpRequest::AcceptedEncoding() const {
+  return Compressor::Negotiate(parser_.GetHeader("Accept-Encoding"));
+}
 
-  /* 注册行为 且 用户名未被使用*/
-  if (!isLogin && flag == true) {
-    LOG_DEBUG("regirster!");
-    bzero(order, 256);
-    snprintf(order, 256,
-             "INSERT INTO user(username, password) VALUES('%s','%s')",
-             name.c_str(), pwd.c_str());
-    LOG_DEBUG("%s", order);
-    if (mysql_query(sql, order)) {
-      LOG_DEBUG("Insert error!");
-      flag = false;
+StringPiece HttpRequest::Param(const StringPiece& name) const {
+  for (const Router::Param& param : params_) {
+    if (param.name == name) {
+      return param.value;
     }
-    flag = true;
   }
-  SqlConnPool::Instance()->ReleaseConn(sql);
-  LOG_DEBUG("UserVerify success!!");
-  return flag;
+  return StringPiece();
 }
 
-std::string HttpRequest::path() const { return path_; }
-
-std::string& HttpRequest::path() { return path_; }
-std::string HttpRequest::method() const { return method_; }
-
-std::string HttpRequest::version() const { return version_; }
-
 std::string HttpRequest::GetPost(const std::string& key) const {
-  assert(key != "");
-  if (post_.count(key) == 1) {
-    return post_.find(key)->second;
-  }
-  return "";
+  return GetPost(key.c_str());
 }
 
 std::string HttpRequest::GetPost(const char* key) const {
   assert(key != nullptr);
-  if (post_.count(key) == 1) {
-    return post_.find(key)->second;
+  const FormData::Field* field = form_.Get(key);
+  if (field) {
+    return field->value.ToString();
+  }
+  int i = json_.Find(0, key);
+  if (i >= 0 && json_[i].type == JsonParser::STRING) {
+    return json_[i].text.ToString();
   }
   return "";
 }
@@ -5,177 +5,654 @@
  */
 #include "http/httpresponse.h"
 
+#include <assert.h>
+#include <stdint.h>  // SIZE_MAX
+#include <string.h>  // memcpy
+#include <time.h>    // strptime, timegm, gmtime_r, strftime
+
+#include <algorithm>  // sort
+
 namespace webserver {
 
-const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE = {
-    {".html", "text/html"},
-    {".xml", "text/xml"},
-    {".xhtml", "application/xhtml+xml"},
-    {".txt", "text/plain"},
-    {".rtf", "application/rtf"},
-    {".pdf", "application/pdf"},
-    {".word", "application/nsword"},
-    {".png", "image/png"},
-    {".gif", "image/gif"},
-    {".jpg", "image/jpeg"},
-    {".jpeg", "image/jpeg"},
-    {".au", "audio/basic"},
-    {".mpeg", "video/mpeg"},
-    {".mpg", "video/mpeg"},
-    {".avi", "video/x-msvideo"},
-    {".gz", "application/x-gzip"},
-    {".tar", "application/x-tar"},
-    {".css", "text/css "},
-    {".js", "text/javascript "},
-};
+const size_t HttpResponse::MAX_RANGES;
+const size_t HttpResponse::DATE_LINE_LEN;
+
+namespace {
 
-const std::unordered_map<int, std::string> HttpResponse::CODE_STATUS = {
-    {200, "OK"},
-    {400, "Bad Request"},
-    {403, "Forbidden"},
-    {404, "Not Found"},
+/* 状态码 -> 原因短语、预先拼好的状态行与错误页面 */
+struct Status {
+  int code;
+  const char* reason;
+  const char* line;
+  size_t lineLen;
+  const char* errorPage;
 };
 
-const std::unordered_map<int, std::string> HttpResponse::CODE_PATH = {
-    {400, "/400.html"},
-    {403, "/403.html"},
-    {404, "/404.html"},
+#define HTTP_STATUS(code, reason, page)                               \
+  {                                                                   \
+    code, reason, "HTTP/1.1 " #code " " reason "\r\n",                \
+        sizeof("HTTP/1.1 " #code " " reason "\r\n") - 1, page         \
+  }
+
+const Status STATUS[] = {
+    HTTP_STATUS(200, "OK", nullptr),
+    HTTP_STATUS(201, "Created", nullptr),
+    HTTP_STATUS(206, "Partial Content", nullptr),
+    HTTP_STATUS(304, "Not Modified", nullptr),
+    HTTP_STATUS(400, "Bad Request", "/400.html"),
+    HTTP_STATUS(401, "Unauthorized", nullptr),
+    HTTP_STATUS(403, "Forbidden", "/403.html"),
+    HTTP_STATUS(404, "Not Found", "/404.html"),
+    HTTP_STATUS(405, "Method Not Allowed", nullptr),
+    HTTP_STATUS(413, "Payload Too Large", nullptr),
+    HTTP_STATUS(416, "Range Not Satisfiable", nullptr),
+    HTTP_STATUS(500, "Internal Server Error", nullptr),
 };
 
+#undef HTTP_STATUS
+
+const Status* FindStatus(int code) {
+  for (const Status& status : STATUS) {
+    if (status.code == code) {
+      return &status;
+    }
+  }
+  return nullptr;
+}
+
+/* 直接写入缓冲区, 不构造std::string临时对象 */
+template <size_t N>
+void AppendLiteral(StringBuffer& buff, const char (&str)[N]) {
+  buff.Append(str, N - 1);
+}
+
+void AppendCString(StringBuffer& buff, const char* str) {
+  buff.Append(str, strlen(str));
+}
+
+void AppendNumber(StringBuffer& buff, uint64_t value) {
+  char digits[20];
+  char* p = digits + sizeof(digits);
+  do {
+    *--p = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  buff.Append(p, digits + sizeof(digits) - p);
+}
+
+/* 当前时间的Date行, 每个线程每秒只格式化一次 */
+const char* DateLine() {
+  thread_local time_t last = -1;
+  thread_local char line[HttpResponse::DATE_LINE_LEN + 1];
+  time_t now = time(nullptr);
+  if (now != last) {
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    strftime(line, sizeof(line), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+    last = now;
+  }
+  return line;
+}
+
+/* 十进制的字节位置, 不接受空串、符号和溢出 */
+bool ParseSize(const StringPiece& digits, size_t* value) {
+  if (digits.empty()) {
+    return false;
+  }
+  size_t v = 0;
+  for (size_t i = 0; i < digits.size(); ++i) {
+    if (digits[i] < '0' || digits[i] > '9' || v > (SIZE_MAX - 9) / 10) {
+      return false;
+    }
+    v = v * 10 + (digits[i] - '0');
+  }
+  *value = v;
+  return true;
+}
+
+/* 文件映射中off处的指针, 流式发送的大文件没有映射 */
+const char* DataAt(const FileCache::EntryPtr& file, size_t off) {
+  return file->data ? file->data + off : nullptr;
+}
+
+size_t DigitCount(uint64_t value) {
+  size_t n = 1;
+  while (value >= 10) {
+    value /= 10;
+    ++n;
+  }
+  return n;
+}
+
+/* 多段响应中的固定片段, 长度由sizeof得出 */
+constexpr char BOUNDARY_PREFIX[] = "ORION-";
+constexpr char PART_TYPE[] = "\r\nContent-Type: ";
+constexpr char PART_RANGE[] = "\r\nContent-Range: bytes ";
+constexpr char PART_END[] = "\r\n\r\n";
+constexpr char TAIL_END[] = "--\r\n";
+
+template <size_t N>
+constexpr size_t LiteralLen(const char (&)[N]) {
+  return N - 1;
+}
+
+}  // namespace
+
 HttpResponse::HttpResponse() {
   code_ = -1;
-  path_ = srcDir_ = "";
+  headStart_ = headLen_ = 0;
+  path_ = srcDir_ = fullPath_ = "";
   isKeepAlive_ = false;
-  mmFile_ = nullptr;
-  mmFileStat_ = {0};
+  encoding_ = Compressor::IDENTITY;
+  contentType_ = nullptr;
 };
 
 HttpResponse::~HttpResponse() { UnmapFile(); }
 
 void HttpResponse::Init(const std::string& srcDir, std::string& path,
-                        bool isKeepAlive, int code) {
+                        bool isKeepAlive, int code,
+                        Compressor::ENCODING encoding) {
   assert(srcDir != "");
-  if (mmFile_) {
-    UnmapFile();
-  }
+  UnmapFile();
   code_ = code;
   isKeepAlive_ = isKeepAlive;
+  encoding_ = encoding;
+  ifNoneMatch_ = ifModifiedSince_ = StringPiece();
+  range_ = ifRange_ = StringPiece();
+  ranges_.clear();
+  segments_.clear();
+  headStart_ = headLen_ = 0;
+  contentType_ = nullptr;
   path_ = path;
   srcDir_ = srcDir;
-  mmFile_ = nullptr;
-  mmFileStat_ = {0};
+  UpdateFullPath_();
+}
+
+void HttpResponse::SetPath(const std::string& path) {
+  path_ = path;
+  UpdateFullPath_();
+}
+
+void HttpResponse::SetConditional(const StringPiece& ifNoneMatch,
+                                  const StringPiece& ifModifiedSince) {
+  ifNoneMatch_ = ifNoneMatch;
+  ifModifiedSince_ = ifModifiedSince;
+}
+
+void HttpResponse::SetRange(const StringPiece& range,
+                            const StringPiece& ifRange) {
+  range_ = range;
+  ifRange_ = ifRange;
+}
+
+void HttpResponse::SetContent(int code, std::string content,
+                              const char* contentType) {
+  code_ = code;
+  content_ = std::make_shared<const std::string>(std::move(content));
+  contentType_ = contentType;
 }
 
 void HttpResponse::MakeResponse(StringBuffer& buff) {
-  /* 判断请求的资源文件 */
-  if (stat((srcDir_ + path_).data(), &mmFileStat_) < 0 ||
-      S_ISDIR(mmFileStat_.st_mode)) {
-    code_ = 404;
-  } else if (!(mmFileStat_.st_mode & S_IROTH)) {
-    code_ = 403;
-  } else if (code_ == -1) {
-    code_ = 200;
+  headStart_ = buff.ReadableBytes();
+  /* 判断请求的资源文件, stat/open/mmap的结果由FileCache缓存;
+     请求本身有错误(400/413)或处理者给出了内容时不查找资源 */
+  if (content_) {
+    encoding_ = Compressor::IDENTITY;
+  } else if (code_ < 400) {
+    file_ = FileCache::Instance()->Get(fullPath_);
+    if (!file_) {
+      code_ = 404;
+    } else if (!(file_->st.st_mode & S_IROTH)) {
+      code_ = 403;
+    } else if (code_ == -1) {
+      code_ = 200;
+    }
   }
   // 处理错误的http请求，参考 CODE_PATH 中支持的错误
-  ErrorHtml_();
+  if (!content_) {
+    ErrorHtml_();
+  }
+  /* 范围是原文的字节位置, 有效的范围请求不压缩 */
+  bool ranged =
+      code_ == 200 && file_ && !range_.empty() && RangeApplies_();
+  if (ranged) {
+    encoding_ = Compressor::IDENTITY;
+  }
+  /* 压缩结果缓存在文件缓存条目中, 同一版本只压缩一次 */
+  if (encoding_ != Compressor::IDENTITY) {
+    encoded_ = Compressor::Encode(file_, fullPath_, encoding_);
+    if (!encoded_) {
+      encoding_ = Compressor::IDENTITY;
+    }
+  }
+  /* 条件请求先于Range判断(RFC 7233 3.1) */
+  if (code_ == 200 && NotModified_()) {
+    code_ = 304;
+  } else if (ranged && ParseRanges_()) {
+    code_ = ranges_.empty() ? 416 : 206;
+  }
   // 添加响应状态行
   AddStateLine_(buff);
   // 添加响应头部
   AddHeader_(buff);
   AddContent_(buff);
+  if (code_ != 206) {
+    headLen_ = buff.ReadableBytes() - headStart_;  // 206由AddRanges_记录
+  }
 }
 
-char* HttpResponse::File() { return mmFile_; }
+const char* HttpResponse::Body() const {
+  if (content_) {
+    return content_->data();
+  }
+  if (encoded_) {
+    return encoded_->data();
+  }
+  return file_ ? file_->data : nullptr;
+}
 
-size_t HttpResponse::FileLen() const { return mmFileStat_.st_size; }
+size_t HttpResponse::BodyLen() const {
+  if (content_) {
+    return content_->size();
+  }
+  if (encoded_) {
+    return encoded_->size();
+  }
+  return file_ ? file_->Size() : 0;
+}
+
+std::shared_ptr<const void> HttpResponse::DetachBody() {
+  std::shared_ptr<const void> body;
+  if (content_) {
+    body = std::move(content_);
+  } else if (encoded_) {
+    body = std::move(encoded_);
+  } else {
+    body = std::move(file_);
+  }
+  UnmapFile();
+  return body;
+}
+
+size_t HttpResponse::DateOffset(int code) {
+  const Status* status = FindStatus(code);
+  return status ? status->lineLen : 0;
+}
+
+void HttpResponse::AddDate(StringBuffer& buff) {
+  buff.Append(DateLine(), DATE_LINE_LEN);
+}
 
 void HttpResponse::ErrorHtml_() {
-  if (CODE_PATH.count(code_) == 1) {
-    path_ = CODE_PATH.find(code_)->second;
-    stat((srcDir_ + path_).data(), &mmFileStat_);
+  const Status* status = FindStatus(code_);
+  if (status && status->errorPage) {
+    path_ = status->errorPage;
+    UpdateFullPath_();
+    file_ = FileCache::Instance()->Get(fullPath_);
   }
 }
 
 void HttpResponse::AddStateLine_(StringBuffer& buff) {
-  std::string status;
-  if (CODE_STATUS.count(code_) == 1) {
-    status = CODE_STATUS.find(code_)->second;
-  } else {
+  const Status* status = FindStatus(code_);
+  if (!status) {
     code_ = 400;
-    status = CODE_STATUS.find(400)->second;
+    status = FindStatus(400);
   }
-  buff.Append("HTTP/1.1 " + std::to_string(code_) + " " + status + "\r\n");
+  buff.Append(status->line, status->lineLen);
+  AddDate(buff);
 }
 
 void HttpResponse::AddHeader_(StringBuffer& buff) {
-  buff.Append("Connection: ");
   if (isKeepAlive_) {
-    buff.Append("keep-alive\r\n");
-    buff.Append("keep-alive: max=6, timeout=120\r\n");
+    AppendLiteral(buff,
+                  "Connection: keep-alive\r\n"
+                  "keep-alive: max=6, timeout=120\r\n");
+  } else {
+    AppendLiteral(buff, "Connection: close\r\n");
+  }
+  if (code_ == 206 && ranges_.size() > 1) {
+    AppendLiteral(buff, "Content-type: multipart/byteranges; boundary=");
+    AddBoundary_(buff);
   } else {
-    buff.Append("close\r\n");
+    AppendLiteral(buff, "Content-type: ");
+    AppendCString(buff, GetFileType_());
+  }
+  AppendLiteral(buff, "\r\n");
+  if (file_ && Compressor::Compressible(file_->mime)) {
+    /* 内容随Accept-Encoding变化, 告知中间缓存分别保存 */
+    AppendLiteral(buff, "Vary: Accept-Encoding\r\n");
+  }
+  if (encoding_ != Compressor::IDENTITY) {
+    AppendLiteral(buff, "Content-Encoding: ");
+    AppendCString(buff, Compressor::Name(encoding_));
+    AppendLiteral(buff, "\r\n");
+  }
+  /* 验证器与缓存策略, 浏览器据此缓存并发起条件请求 */
+  if ((code_ == 200 || code_ == 206 || code_ == 304) && file_) {
+    AppendLiteral(buff, "ETag: \"");
+    buff.Append(file_->etag);
+    if (encoding_ != Compressor::IDENTITY) {
+      AppendLiteral(buff, "-");
+      AppendCString(buff, Compressor::Name(encoding_));
+    }
+    AppendLiteral(buff, "\"\r\nLast-Modified: ");
+    buff.Append(file_->lastModified);
+    AppendLiteral(buff, "\r\nCache-Control: ");
+    AppendCString(buff, file_->cacheControl);
+    AppendLiteral(buff, "\r\n");
+  }
+  if ((code_ == 200 || code_ == 206) && file_) {
+    AppendLiteral(buff, "Accept-Ranges: bytes\r\n");
+  }
+  if (code_ == 206 && ranges_.size() == 1) {
+    AppendLiteral(buff, "Content-Range: bytes ");
+    AppendNumber(buff, ranges_[0].first);
+    AppendLiteral(buff, "-");
+    AppendNumber(buff, ranges_[0].second);
+    AppendLiteral(buff, "/");
+    AppendNumber(buff, file_->Size());
+    AppendLiteral(buff, "\r\n");
+  } else if (code_ == 416) {
+    AppendLiteral(buff, "Content-Range: bytes */");
+    AppendNumber(buff, file_->Size());
+    AppendLiteral(buff, "\r\n");
   }
-  buff.Append("Content-type: " + GetFileType_() + "\r\n");
 }
 
 void HttpResponse::AddContent_(StringBuffer& buff) {
-  int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
-  if (srcFd < 0) {
-    ErrorContent(buff, "File NotFound!");
+  if (code_ == 304) {
+    /* 304没有内容 */
+    UnmapFile();
+    AppendLiteral(buff, "\r\n");
+    return;
+  }
+  if (code_ == 416) {
+    UnmapFile();
+    AppendLiteral(buff, "Content-length: 0\r\n\r\n");
+    return;
+  }
+  if (content_) {
+    AppendLiteral(buff, "Content-length: ");
+    AppendNumber(buff, content_->size());
+    AppendLiteral(buff, "\r\n\r\n");
+    if (!content_->empty()) {
+      segments_.push_back({content_->data(), -1, 0, content_->size()});
+    }
     return;
   }
+  if (!file_ || (file_->Size() > 0 && !file_->data && file_->fd < 0)) {
+    file_.reset();
+    ErrorContent(buff, code_ == 404 ? "File NotFound!" : "");
+    return;
+  }
+  LOG_DEBUG("file path %s", fullPath_.c_str());
+  if (code_ == 206) {
+    AddRanges_(buff);
+    return;
+  }
+  AppendLiteral(buff, "Content-length: ");
+  AppendNumber(buff, BodyLen());
+  AppendLiteral(buff, "\r\n\r\n");
+  if (BodyLen() > 0) {
+    segments_.push_back(
+        {Body(), encoded_ ? -1 : file_->fd, 0, BodyLen()});
+  }
+}
 
-  /* 将文件映射到内存提高文件的访问速度
-      MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
-  LOG_DEBUG("file path %s", (srcDir_ + path_).data());
-  int* mmRet =
-      (int*)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-  if (*mmRet == -1) {
-    ErrorContent(buff, "File NotFound!");
+/* 单个范围直接作为内容; 多个范围按multipart/byteranges分段, 分段头写入
+   buff, 各段文件内容仍可由sendfile发送 */
+void HttpResponse::AddRanges_(StringBuffer& buff) {
+  size_t size = file_->Size();
+  if (ranges_.size() == 1) {
+    size_t first = ranges_[0].first;
+    size_t len = ranges_[0].second - first + 1;
+    AppendLiteral(buff, "Content-length: ");
+    AppendNumber(buff, len);
+    AppendLiteral(buff, "\r\n\r\n");
+    headLen_ = buff.ReadableBytes() - headStart_;
+    segments_.push_back({DataAt(file_, first), file_->fd, first, len});
     return;
   }
-  mmFile_ = (char*)mmRet;
-  close(srcFd);
-  buff.Append("Content-length: " + std::to_string(mmFileStat_.st_size) +
-              "\r\n\r\n");
+  /* 分段头的长度可直接算出, 先写Content-length, 再把分段头逐个写入buff */
+  size_t boundaryLen = LiteralLen(BOUNDARY_PREFIX) + file_->etag.size();
+  size_t mimeLen = strlen(file_->mime);
+  size_t total = 0;
+  for (size_t i = 0; i < ranges_.size(); ++i) {
+    size_t first = ranges_[i].first;
+    size_t last = ranges_[i].second;
+    total += (i == 0 ? 2 : 4) + boundaryLen + LiteralLen(PART_TYPE) + mimeLen +
+             LiteralLen(PART_RANGE) + DigitCount(first) + 1 +
+             DigitCount(last) + 1 + DigitCount(size) + LiteralLen(PART_END) +
+             last - first + 1;
+  }
+  total += 4 + boundaryLen + LiteralLen(TAIL_END);
+
+  AppendLiteral(buff, "Content-length: ");
+  AppendNumber(buff, total);
+  AppendLiteral(buff, "\r\n\r\n");
+  headLen_ = buff.ReadableBytes() - headStart_;
+  size_t bodyStart = buff.ReadableBytes();
+  size_t fileLen = 0;
+  for (size_t i = 0; i < ranges_.size(); ++i) {
+    size_t first = ranges_[i].first;
+    size_t last = ranges_[i].second;
+    size_t off = buff.ReadableBytes();
+    if (i > 0) {
+      AppendLiteral(buff, "\r\n");
+    }
+    AppendLiteral(buff, "--");
+    AddBoundary_(buff);
+    AppendLiteral(buff, PART_TYPE);
+    buff.Append(file_->mime, mimeLen);
+    AppendLiteral(buff, PART_RANGE);
+    AppendNumber(buff, first);
+    AppendLiteral(buff, "-");
+    AppendNumber(buff, last);
+    AppendLiteral(buff, "/");
+    AppendNumber(buff, size);
+    AppendLiteral(buff, PART_END);
+    segments_.push_back({nullptr, -1, off, buff.ReadableBytes() - off});
+    segments_.push_back(
+        {DataAt(file_, first), file_->fd, first, last - first + 1});
+    fileLen += last - first + 1;
+  }
+  size_t off = buff.ReadableBytes();
+  AppendLiteral(buff, "\r\n--");
+  AddBoundary_(buff);
+  AppendLiteral(buff, TAIL_END);
+  segments_.push_back({nullptr, -1, off, buff.ReadableBytes() - off});
+  assert(buff.ReadableBytes() - bodyStart + fileLen == total);
 }
 
 void HttpResponse::UnmapFile() {
-  if (mmFile_) {
-    munmap(mmFile_, mmFileStat_.st_size);
-    mmFile_ = nullptr;
+  file_.reset();
+  encoded_.reset();
+  content_.reset();
+}
+
+/* 同一文件的不同编码是不同的表示, 强ETag为"etag"或"etag-编码名" */
+bool HttpResponse::MatchETag_(StringPiece tag,
+                              Compressor::ENCODING encoding) const {
+  if (tag.size() < 2 || tag[0] != '"' || tag[tag.size() - 1] != '"') {
+    return false;
   }
+  tag = tag.substr(1, tag.size() - 2);
+  if (!tag.StartsWith(file_->etag)) {
+    return false;
+  }
+  tag.RemovePrefix(file_->etag.size());
+  if (encoding == Compressor::IDENTITY) {
+    return tag.empty();
+  }
+  return tag.size() > 1 && tag[0] == '-' &&
+         tag.substr(1) == Compressor::Name(encoding);
 }
 
-std::string HttpResponse::GetFileType_() {
-  /* 判断文件类型 */
-  std::string::size_type idx = path_.find_last_of('.');
-  if (idx == std::string::npos) {
-    return "text/plain";
+bool HttpResponse::NotModified_() const {
+  if (!file_ || file_->etag.empty()) {
+    return false;
   }
-  std::string suffix = path_.substr(idx);
-  if (SUFFIX_TYPE.count(suffix) == 1) {
-    return SUFFIX_TYPE.find(suffix)->second;
+  /* 有If-None-Match时忽略If-Modified-Since(RFC 7232 6) */
+  if (!ifNoneMatch_.empty()) {
+    StringPiece rest = ifNoneMatch_;
+    while (!rest.empty()) {
+      size_t comma = rest.find(',');
+      StringPiece tag = rest.substr(0, comma);
+      rest = (comma == StringPiece::npos) ? StringPiece()
+                                          : rest.substr(comma + 1);
+      tag.TrimSpace();
+      if (tag.StartsWith("W/")) {
+        tag.RemovePrefix(2);  // If-None-Match使用弱比较
+      }
+      if (tag == "*" || MatchETag_(tag, encoding_)) {
+        return true;
+      }
+    }
+    return false;
   }
-  return "text/plain";
+  if (!ifModifiedSince_.empty() && ifModifiedSince_.size() < 64) {
+    char date[64];
+    memcpy(date, ifModifiedSince_.data(), ifModifiedSince_.size());
+    date[ifModifiedSince_.size()] = '\0';
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return end && *end == '\0' && file_->st.st_mtime <= timegm(&tm);
+  }
+  return false;
 }
 
-void HttpResponse::ErrorContent(StringBuffer& buff, std::string message) {
-  std::string body;
-  std::string status;
-  body += "<html><title>Error</title>";
-  body += "<body bgcolor=\"ffffff\">";
-  if (CODE_STATUS.count(code_) == 1) {
-    status = CODE_STATUS.find(code_)->second;
-  } else {
-    status = "Bad Request";
+bool HttpResponse::RangeApplies_() const {
+  if (ifRange_.empty()) {
+    return true;
+  }
+  /* If-Range的ETag使用强比较, 日期必须与Last-Modified完全相同 */
+  if (ifRange_[0] == '"') {
+    return MatchETag_(ifRange_, Compressor::IDENTITY);
+  }
+  return !ifRange_.StartsWith("W/") && ifRange_ == file_->lastModified;
+}
+
+bool HttpResponse::ParseRanges_() {
+  ranges_.clear();
+  StringPiece rest = range_;
+  rest.TrimSpace();
+  if (!rest.StartsWith("bytes=")) {
+    return false;  // 不认识的单位
+  }
+  rest.RemovePrefix(6);
+  size_t size = file_->Size();
+  size_t count = 0;
+  while (!rest.empty()) {
+    size_t comma = rest.find(',');
+    StringPiece item = rest.substr(0, comma);
+    rest = (comma == StringPiece::npos) ? StringPiece()
+                                        : rest.substr(comma + 1);
+    item.TrimSpace();
+    if (item.empty()) {
+      continue;
+    }
+    if (++count > MAX_RANGES) {
+      return false;
+    }
+    size_t dash = item.find('-');
+    if (dash == StringPiece::npos) {
+      return false;
+    }
+    StringPiece firstPos = item.substr(0, dash);
+    StringPiece lastPos = item.substr(dash + 1);
+    firstPos.TrimSpace();
+    lastPos.TrimSpace();
+    size_t first, last;
+    if (firstPos.empty()) {
+      /* 后缀范围: 最后n个字节 */
+      size_t n;
+      if (!ParseSize(lastPos, &n)) {
+        return false;
+      }
+      if (n == 0 || size == 0) {
+        continue;
+      }
+      first = n >= size ? 0 : size - n;
+      last = size - 1;
+    } else {
+      if (!ParseSize(firstPos, &first)) {
+        return false;
+      }
+      if (lastPos.empty()) {
+        last = size - 1;
+      } else if (!ParseSize(lastPos, &last) || last < first) {
+        return false;
+      }
+      if (first >= size) {
+        continue;  // 不可满足
+      }
+      last = std::min(last, size - 1);
+    }
+    ranges_.emplace_back(first, last);
   }
-  body += std::to_string(code_) + " : " + status + "\n";
-  body += "<p>" + message + "</p>";
-  body += "<hr><em>WebDemo-SemanticQaQ</em></body></html>";
+  if (count == 0) {
+    return false;
+  }
+  /* 合并重叠或相邻的范围(RFC 7233 4.1), 同一段内容只发送一次 */
+  std::sort(ranges_.begin(), ranges_.end());
+  size_t merged = 0;
+  for (size_t i = 1; i < ranges_.size(); ++i) {
+    if (ranges_[i].first <= ranges_[merged].second + 1) {
+      ranges_[merged].second =
+          std::max(ranges_[merged].second, ranges_[i].second);
+    } else {
+      ranges_[++merged] = ranges_[i];
+    }
+  }
+  if (!ranges_.empty()) {
+    ranges_.resize(merged + 1);
+  }
+  return true;
+}
+
+/* 复用fullPath_的容量, 每次响应不再分配新的字符串 */
+void HttpResponse::UpdateFullPath_() {
+  fullPath_.assign(srcDir_);
+  fullPath_.append(path_);
+}
+
+void HttpResponse::AddBoundary_(StringBuffer& buff) const {
+  AppendLiteral(buff, BOUNDARY_PREFIX);
+  buff.Append(file_->etag);  // ETag只含十六进制数字和'-'
+}
+
+const char* HttpResponse::GetFileType_() {
+  /* 判断文件类型 */
+  if (contentType_) {
+    return contentType_;
+  }
+  return file_ ? file_->mime : FileCache::MimeType(path_);
+}
+
+void HttpResponse::ErrorContent(StringBuffer& buff, const char* message) {
+  static const char HEAD[] =
+      "<html><title>Error</title><body bgcolor=\"ffffff\">";
+  static const char TAIL[] =
+      "</p><hr><em>WebDemo-SemanticQaQ</em></body></html>";
+  const Status* status = FindStatus(code_);
+  const char* reason = status ? status->reason : "Bad Request";
+  size_t reasonLen = strlen(reason);
+  size_t messageLen = strlen(message);
+  /* "<code> : <reason>\n<p><message>" 夹在HEAD与TAIL之间 */
+  size_t bodyLen = LiteralLen(HEAD) + DigitCount(code_) + 3 + reasonLen + 4 +
+                   messageLen + LiteralLen(TAIL);
 
-  buff.Append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
-  buff.Append(body);
+  AppendLiteral(buff, "Content-length: ");
+  AppendNumber(buff, bodyLen);
+  AppendLiteral(buff, "\r\n\r\n");
+  AppendLiteral(buff, HEAD);
+  AppendNumber(buff, code_);
+  AppendLiteral(buff, " : ");
+  buff.Append(reason, reasonLen);
+  AppendLiteral(buff, "\n<p>");
+  buff.Append(message, messageLen);
+  AppendLiteral(buff, TAIL);
 }
 
 }  // namespace webserver
\ No newline at end of file
@@ -0,0 +1,221 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-03
+ * @copyleft Apache 2.0
+ */
+
+#include "http/httpscanner.h"
+
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HTTP_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace webserver {
+
+namespace {
+
+/* tchar的位图: 字节b合法当且仅当 b < 0x80 且 TOKEN_LO[b & 0xF] 的第(b >> 4)位
+   为1。同一张表也用作SIMD中pshufb的查找表, 一次得到16/32个字节的分类 */
+const uint8_t TOKEN_LO[16] = {0xe8, 0xfc, 0xf8, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc,
+                              0xf8, 0xf8, 0xf4, 0x54, 0xd0, 0x54, 0xf4, 0x70};
+
+inline bool IsTokenStop(uint8_t ch) {
+  return ch >= 0x80 || !(TOKEN_LO[ch & 0xF] & (1 << (ch >> 4)));
+}
+
+inline bool IsTargetStop(uint8_t ch) { return ch <= ' ' || ch == 0x7f; }
+
+inline bool IsValueStop(uint8_t ch) {
+  return (ch < ' ' && ch != '\t') || ch == 0x7f;
+}
+
+inline bool IsEscapeStop(uint8_t ch) { return ch == '%' || ch == '+'; }
+
+inline bool IsJsonStop(uint8_t ch) {
+  return ch == '"' || ch == '\\' || ch < ' ';
+}
+
+template <bool (*IsStop)(uint8_t)>
+const char* ScanScalar(const char* p, const char* end) {
+  while (p < end && !IsStop(static_cast<uint8_t>(*p))) ++p;
+  return p;
+}
+
+#ifdef HTTP_SCANNER_X86
+
+/* ---------------------- SSSE3: 每次16字节 ---------------------- */
+
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+
+SSSE3_TARGET inline __m128i TokenStop128(__m128i v) {
+  const __m128i loTable = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(TOKEN_LO));
+  const __m128i hiBit = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0,
+                                      0, 0, 0, 0, 0);
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  __m128i lo = _mm_and_si128(v, nibble);
+  __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+  __m128i allowed = _mm_and_si128(_mm_shuffle_epi8(loTable, lo),
+                                  _mm_shuffle_epi8(hiBit, hi));
+  return _mm_cmpeq_epi8(allowed, _mm_setzero_si128());
+}
+
+SSSE3_TARGET inline __m128i TargetStop128(__m128i v) {
+  /* 无符号比较 v <= 0x20 等价于 min(v, 0x20) == v */
+  __m128i space = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(' ')), v);
+  return _mm_or_si128(space, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)));
+}
+
+SSSE3_TARGET inline __m128i ValueStop128(__m128i v) {
+  __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+  __m128i tab = _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'));
+  return _mm_or_si128(_mm_andnot_si128(tab, ctl),
+                      _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)));
+}
+
+SSSE3_TARGET inline __m128i EscapeStop128(__m128i v) {
+  return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('%')),
+                      _mm_cmpeq_epi8(v, _mm_set1_epi8('+')));
+}
+
+SSSE3_TARGET inline __m128i JsonStop128(__m128i v) {
+  __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v);
+  __m128i quote = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                               _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+  return _mm_or_si128(ctl, quote);
+}
+
+template <__m128i (*Stop)(__m128i), bool (*IsStop)(uint8_t)>
+SSSE3_TARGET const char* ScanSsse3(const char* p, const char* end) {
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int mask = _mm_movemask_epi8(Stop(v));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return ScanScalar<IsStop>(p, end);
+}
+
+/* ---------------------- AVX2: 每次32字节 ---------------------- */
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET inline __m256i TokenStop256(__m256i v) {
+  /* vpshufb在每个128位通道内独立查表, 两个通道使用同一张表 */
+  const __m256i loTable = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(TOKEN_LO)));
+  const __m256i hiBit = _mm256_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32,
+      64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  __m256i lo = _mm256_and_si256(v, nibble);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+  __m256i allowed = _mm256_and_si256(_mm256_shuffle_epi8(loTable, lo),
+                                     _mm256_shuffle_epi8(hiBit, hi));
+  return _mm256_cmpeq_epi8(allowed, _mm256_setzero_si256());
+}
+
+AVX2_TARGET inline __m256i TargetStop256(__m256i v) {
+  __m256i space =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(' ')), v);
+  return _mm256_or_si256(space, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7f)));
+}
+
+AVX2_TARGET inline __m256i ValueStop256(__m256i v) {
+  __m256i ctl =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v);
+  __m256i tab = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'));
+  return _mm256_or_si256(_mm256_andnot_si256(tab, ctl),
+                         _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7f)));
+}
+
+AVX2_TARGET inline __m256i EscapeStop256(__m256i v) {
+  return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('%')),
+                         _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+')));
+}
+
+AVX2_TARGET inline __m256i JsonStop256(__m256i v) {
+  __m256i ctl =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v);
+  __m256i quote =
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+  return _mm256_or_si256(ctl, quote);
+}
+
+template <__m256i (*Stop)(__m256i), bool (*IsStop)(uint8_t)>
+AVX2_TARGET const char* ScanAvx2(const char* p, const char* end) {
+  for (; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(Stop(v)));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return ScanScalar<IsStop>(p, end);
+}
+
+#endif  // HTTP_SCANNER_X86
+
+}  // namespace
+
+/* 静态初始化时先使用逐字节实现(常量初始化, 不依赖初始化顺序),
+   随后由下面的selector按CPU特性替换 */
+HttpScanner::Impl HttpScanner::impl_ = {
+    HttpScanner::SCALAR,      ScanScalar<IsTokenStop>,
+    ScanScalar<IsTargetStop>, ScanScalar<IsValueStop>,
+    ScanScalar<IsEscapeStop>, ScanScalar<IsJsonStop>};
+
+HttpScanner::LEVEL HttpScanner::Use(LEVEL maxLevel) {
+  Impl impl = {SCALAR,
+               ScanScalar<IsTokenStop>,
+               ScanScalar<IsTargetStop>,
+               ScanScalar<IsValueStop>,
+               ScanScalar<IsEscapeStop>,
+               ScanScalar<IsJsonStop>};
+#ifdef HTTP_SCANNER_X86
+  __builtin_cpu_init();
+  if (maxLevel >= AVX2 && __builtin_cpu_supports("avx2")) {
+    impl = {AVX2, ScanAvx2<TokenStop256, IsTokenStop>,
+            ScanAvx2<TargetStop256, IsTargetStop>,
+            ScanAvx2<ValueStop256, IsValueStop>,
+            ScanAvx2<EscapeStop256, IsEscapeStop>,
+            ScanAvx2<JsonStop256, IsJsonStop>};
+  } else if (maxLevel >= SSSE3 && __builtin_cpu_supports("ssse3")) {
+    impl = {SSSE3, ScanSsse3<TokenStop128, IsTokenStop>,
+            ScanSsse3<TargetStop128, IsTargetStop>,
+            ScanSsse3<ValueStop128, IsValueStop>,
+            ScanSsse3<EscapeStop128, IsEscapeStop>,
+            ScanSsse3<JsonStop128, IsJsonStop>};
+  }
+#endif
+  impl_ = impl;
+  return impl_.level;
+}
+
+const char* HttpScanner::LevelName() {
+  switch (impl_.level) {
+    case AVX2:
+      return "AVX2";
+    case SSSE3:
+      return "SSSE3";
+    default:
+      return "scalar";
+  }
+}
+
+namespace {
+
+struct ScannerSelector {
+  ScannerSelector() { HttpScanner::Use(HttpScanner::AVX2); }
+};
+
+const ScannerSelector SELECTOR;
+
+}  // namespace
+
+}  // namespace webserver
@@ -0,0 +1,302 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-17
+ * @copyleft Apache 2.0
+ */
+
+#include "http/jsonparser.h"
+
+#include <string.h>
+
+#include "http/httpscanner.h"
+
+namespace webserver {
+
+const int JsonParser::MAX_DEPTH;
+const size_t JsonParser::TOKENS_KEEP;
+
+namespace {
+
+bool IsSpace(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+bool IsDigit(char ch) { return ch >= '0' && ch <= '9'; }
+
+int HexValue(char ch) {
+  if (ch >= '0' && ch <= '9') return ch - '0';
+  if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+  return -1;
+}
+
+/* p开始的4个十六进制数字, 不合法时返回-1 */
+long Hex4(const char* p, const char* end) {
+  if (end - p < 4) {
+    return -1;
+  }
+  long value = 0;
+  for (int i = 0; i < 4; ++i) {
+    int digit = HexValue(p[i]);
+    if (digit < 0) {
+      return -1;
+    }
+    value = value * 16 + digit;
+  }
+  return value;
+}
+
+/* UTF-8编码不长于对应的\uXXXX转义, 可以原地写入 */
+char* PutUtf8(char* out, long cp) {
+  if (cp < 0x80) {
+    *out++ = static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    *out++ = static_cast<char>(0xC0 | (cp >> 6));
+    *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    *out++ = static_cast<char>(0xE0 | (cp >> 12));
+    *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    *out++ = static_cast<char>(0xF0 | (cp >> 18));
+    *out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+  }
+  return out;
+}
+
+}  // namespace
+
+void JsonParser::Reset() {
+  if (tokens_.capacity() > TOKENS_KEEP) {
+    std::vector<Token>().swap(tokens_);
+  }
+  tokens_.clear();
+  stack_.clear();
+}
+
+int JsonParser::Find(int object, const StringPiece& key) const {
+  if (object < 0 || object >= Count() || tokens_[object].type != OBJECT) {
+    return -1;
+  }
+  int i = object + 1;
+  for (int n = 0; n < tokens_[object].size; ++n) {
+    if (tokens_[i].text == key) {
+      return i + 1;
+    }
+    i = tokens_[i + 1].next;
+  }
+  return -1;
+}
+
+void JsonParser::Push_(TYPE type, const char* begin, size_t len, bool isKey) {
+  if (!stack_.empty()) {
+    Token& parent = tokens_[stack_.back()];
+    if (isKey || parent.type == ARRAY) {
+      ++parent.size;
+    }
+  }
+  Token token;
+  token.type = type;
+  token.text = StringPiece(begin, len);
+  token.size = 0;
+  token.next = Count() + 1;
+  tokens_.push_back(token);
+}
+
+bool JsonParser::Parse(char* data, size_t len) {
+  tokens_.clear();
+  stack_.clear();
+  char* p = data;
+  char* end = data + len;
+  STATE state = VALUE;
+  while (true) {
+    while (p < end && IsSpace(*p)) ++p;
+    if (state == AFTER && stack_.empty()) {
+      return p == end;
+    }
+    if (p == end) {
+      return false;
+    }
+    switch (state) {
+      case VALUE: {
+        char ch = *p;
+        if (ch == '{' || ch == '[') {
+          if (static_cast<int>(stack_.size()) >= MAX_DEPTH) {
+            return false;
+          }
+          Push_(ch == '{' ? OBJECT : ARRAY, p, 0, false);
+          stack_.push_back(Count() - 1);
+          ++p;
+          state = FIRST;
+          break;
+        }
+        char* begin = p;
+        if (ch == '"') {
+          StringPiece str;
+          if (!ParseString_(p, end, &str)) {
+            return false;
+          }
+          Push_(STRING, str.data(), str.size(), false);
+        } else if (ch == '-' || IsDigit(ch)) {
+          if (!ParseNumber_(p, end)) {
+            return false;
+          }
+          Push_(NUMBER, begin, p - begin, false);
+        } else {
+          static const struct {
+            const char* text;
+            size_t len;
+            TYPE type;
+          } LITERALS[] = {
+              {"true", 4, BOOLEAN}, {"false", 5, BOOLEAN}, {"null", 4, NUL}};
+          bool matched = false;
+          for (const auto& lit : LITERALS) {
+            if (static_cast<size_t>(end - p) >= lit.len &&
+                memcmp(p, lit.text, lit.len) == 0) {
+              p += lit.len;
+              Push_(lit.type, begin, lit.len, false);
+              matched = true;
+              break;
+            }
+          }
+          if (!matched) {
+            return false;
+          }
+        }
+        state = AFTER;
+        break;
+      }
+      case KEY: {
+        StringPiece key;
+        if (*p != '"' || !ParseString_(p, end, &key)) {
+          return false;
+        }
+        Push_(STRING, key.data(), key.size(), true);
+        while (p < end && IsSpace(*p)) ++p;
+        if (p == end || *p != ':') {
+          return false;
+        }
+        ++p;
+        state = VALUE;
+        break;
+      }
+      case FIRST:
+      case AFTER: {
+        Token& parent = tokens_[stack_.back()];
+        char close = parent.type == OBJECT ? '}' : ']';
+        if (*p == close) {
+          /* 容器的原文与跳过它之后的下标在结束时才确定 */
+          parent.text = StringPiece(parent.text.data(),
+                                    p + 1 - parent.text.data());
+          parent.next = Count();
+          stack_.pop_back();
+          ++p;
+          state = AFTER;
+        } else if (state == FIRST) {
+          state = parent.type == OBJECT ? KEY : VALUE;
+        } else if (*p == ',') {
+          ++p;
+          state = parent.type == OBJECT ? KEY : VALUE;
+        } else {
+          return false;
+        }
+        break;
+      }
+    }
+  }
+}
+
+bool JsonParser::ParseString_(char*& p, char* end, StringPiece* out) {
+  ++p;
+  char* begin = p;
+  char* write = p;
+  /* 普通字符由HttpScanner批量跳过, 有转义后写位置落后于读位置 */
+  while (true) {
+    char* stop = const_cast<char*>(HttpScanner::FindJsonStop(p, end));
+    if (write != p) {
+      memmove(write, p, stop - p);
+    }
+    write += stop - p;
+    p = stop;
+    if (p == end) {
+      return false;
+    }
+    if (*p == '"') {
+      ++p;
+      *out = StringPiece(begin, write - begin);
+      return true;
+    }
+    if (*p != '\\' || end - p < 2) {
+      return false;  // 控制字符须转义
+    }
+    char ch = p[1];
+    p += 2;
+    switch (ch) {
+      case '"': *write++ = '"'; break;
+      case '\\': *write++ = '\\'; break;
+      case '/': *write++ = '/'; break;
+      case 'b': *write++ = '\b'; break;
+      case 'f': *write++ = '\f'; break;
+      case 'n': *write++ = '\n'; break;
+      case 'r': *write++ = '\r'; break;
+      case 't': *write++ = '\t'; break;
+      case 'u': {
+        long cp = Hex4(p, end);
+        if (cp < 0) {
+          return false;
+        }
+        p += 4;
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+          /* 高代理项后必须紧跟低代理项 */
+          long low = (end - p >= 2 && p[0] == '\\' && p[1] == 'u')
+                         ? Hex4(p + 2, end)
+                         : -1;
+          if (low < 0xDC00 || low > 0xDFFF) {
+            return false;
+          }
+          p += 6;
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+          return false;
+        }
+        write = PutUtf8(write, cp);
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+}
+
+bool JsonParser::ParseNumber_(char*& p, char* end) {
+  /* -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? */
+  if (p < end && *p == '-') ++p;
+  if (p == end || !IsDigit(*p)) {
+    return false;
+  }
+  if (*p == '0') {
+    ++p;
+  } else {
+    while (p < end && IsDigit(*p)) ++p;
+  }
+  if (p < end && *p == '.') {
+    ++p;
+    if (p == end || !IsDigit(*p)) {
+      return false;
+    }
+    while (p < end && IsDigit(*p)) ++p;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    if (p < end && (*p == '+' || *p == '-')) ++p;
+    if (p == end || !IsDigit(*p)) {
+      return false;
+    }
+    while (p < end && IsDigit(*p)) ++p;
+  }
+  return true;
+}
+
+}  // namespace webserver
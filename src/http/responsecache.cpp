@@ -0,0 +1,216 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-11
+ * @copyleft Apache 2.0
+ */
+
+#include "http/responsecache.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace webserver {
+
+const int FrequencySketch::DEPTH;
+const int FrequencySketch::MAX_COUNT;
+const int ResponseCache::SHARDS;
+const size_t ResponseCache::MAX_BYTES;
+const size_t ResponseCache::MAX_OBJECT;
+const size_t ResponseCache::SKETCH_WIDTH;
+
+FrequencySketch::FrequencySketch(size_t width) : samples_(0) {
+  size_t size = 16;
+  while (size < width) {
+    size <<= 1;
+  }
+  mask_ = size - 1;
+  sampleLimit_ = size * 10;
+  table_.assign(size * DEPTH, 0);
+}
+
+void FrequencySketch::Increment(uint64_t hash) {
+  bool added = false;
+  for (int row = 0; row < DEPTH; ++row) {
+    uint8_t& count = table_[Index_(hash, row)];
+    if (count < MAX_COUNT) {
+      ++count;
+      added = true;
+    }
+  }
+  if (added && ++samples_ >= sampleLimit_) {
+    Age_();
+  }
+}
+
+int FrequencySketch::Estimate(uint64_t hash) const {
+  int freq = MAX_COUNT;
+  for (int row = 0; row < DEPTH; ++row) {
+    freq = std::min<int>(freq, table_[Index_(hash, row)]);
+  }
+  return freq;
+}
+
+size_t FrequencySketch::Index_(uint64_t hash, int row) const {
+  static const uint64_t SEEDS[DEPTH] = {
+      0x97cb3127a0d3c5b1ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL,
+      0xd6e8feb86659fd93ULL};
+  uint64_t x = (hash + SEEDS[row]) * 0x9e3779b97f4a7c15ULL;
+  return ((x ^ (x >> 32)) & mask_) + row * (mask_ + 1);
+}
+
+void FrequencySketch::Age_() {
+  for (uint8_t& count : table_) {
+    count >>= 1;
+  }
+  samples_ /= 2;
+}
+
+ResponseCache::ResponseCache(size_t maxBytes, int shards) {
+  assert(shards > 0);
+  for (int i = 0; i < shards; ++i) {
+    shards_.emplace_back(new Shard(maxBytes / shards, SKETCH_WIDTH / shards));
+  }
+}
+
+ResponseCache* ResponseCache::Instance() {
+  static ResponseCache instance(MAX_BYTES);
+  return &instance;
+}
+
+ResponseCache::ResponsePtr ResponseCache::Get(const std::string& path,
+                                              bool keepAlive,
+                                              Compressor::ENCODING encoding,
+                                              const FileCache::EntryPtr& file) {
+  uint64_t hash = Hash_(path);
+  Shard& shard = ShardOf_(hash);
+  std::lock_guard<std::mutex> locker(shard.mtx);
+  shard.sketch.Increment(hash);
+  auto it = shard.nodes.find(path);
+  if (it == shard.nodes.end()) {
+    return nullptr;
+  }
+  Node& node = it->second;
+  if (!file || node.file != file) {
+    /* 文件已变化或已删除, 旧响应作废 */
+    Drop_(shard, node);
+    shard.lru.erase(node.lru);
+    shard.nodes.erase(it);
+    return nullptr;
+  }
+  shard.lru.splice(shard.lru.begin(), shard.lru, node.lru);
+  return node.variant[keepAlive][encoding];
+}
+
+ResponseCache::ResponsePtr ResponseCache::Put(const std::string& path,
+                                              bool keepAlive,
+                                              Compressor::ENCODING encoding,
+                                              const FileCache::EntryPtr& file,
+                                              const char* head, size_t headLen,
+                                              const char* body,
+                                              size_t bodyLen) {
+  if (!file || bodyLen >= MAX_OBJECT || (bodyLen > 0 && !body)) {
+    return nullptr;
+  }
+  size_t bytes = headLen + bodyLen;
+  uint64_t hash = Hash_(path);
+  Shard& shard = ShardOf_(hash);
+
+  std::lock_guard<std::mutex> locker(shard.mtx);
+  auto it = shard.nodes.find(path);
+  if (it != shard.nodes.end()) {
+    Node& node = it->second;
+    if (node.file != file) {
+      Drop_(shard, node);
+      node.file = file;
+    } else if (node.variant[keepAlive][encoding]) {
+      return node.variant[keepAlive][encoding];  // 其他线程已经加入
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, node.lru);
+  }
+  if (!MakeRoom_(shard, path, hash, bytes)) {
+    return nullptr;
+  }
+  if (it == shard.nodes.end()) {
+    shard.lru.push_front(path);
+    Node node;
+    node.file = file;
+    node.bytes = 0;
+    node.lru = shard.lru.begin();
+    it = shard.nodes.emplace(path, std::move(node)).first;
+  }
+
+  std::shared_ptr<std::string> response = std::make_shared<std::string>();
+  response->reserve(bytes);
+  response->append(head, headLen);
+  response->append(body, bodyLen);
+  it->second.variant[keepAlive][encoding] = response;
+  it->second.bytes += bytes;
+  shard.bytes += bytes;
+  return response;
+}
+
+size_t ResponseCache::Bytes() const {
+  size_t bytes = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> locker(shard->mtx);
+    bytes += shard->bytes;
+  }
+  return bytes;
+}
+
+void ResponseCache::Clear() {
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> locker(shard->mtx);
+    shard->nodes.clear();
+    shard->lru.clear();
+    shard->bytes = 0;
+  }
+}
+
+uint64_t ResponseCache::Hash_(const std::string& path) {
+  return std::hash<std::string>()(path);
+}
+
+ResponseCache::Shard& ResponseCache::ShardOf_(uint64_t hash) {
+  return *shards_[hash % shards_.size()];
+}
+
+void ResponseCache::Drop_(Shard& shard, Node& node) {
+  shard.bytes -= node.bytes;
+  node.bytes = 0;
+  for (auto& variants : node.variant) {
+    for (ResponsePtr& variant : variants) {
+      variant.reset();
+    }
+  }
+}
+
+/* TinyLFU准入: 从分片LRU尾部开始, 受害者的估计频率低于新响应时才淘汰它 */
+bool ResponseCache::MakeRoom_(Shard& shard, const std::string& path,
+                              uint64_t hash, size_t bytes) {
+  if (bytes > shard.maxBytes) {
+    return false;
+  }
+  int freq = -1;
+  while (shard.bytes + bytes > shard.maxBytes) {
+    const std::string& victim = shard.lru.back();
+    if (victim == path) {
+      return false;  // 只剩自己的另一个变体
+    }
+    if (freq < 0) {
+      freq = shard.sketch.Estimate(hash);
+    }
+    if (shard.sketch.Estimate(Hash_(victim)) >= freq) {
+      return false;
+    }
+    auto it = shard.nodes.find(victim);
+    Drop_(shard, it->second);
+    shard.nodes.erase(it);
+    shard.lru.pop_back();
+  }
+  return true;
+}
+
+}  // namespace webserver
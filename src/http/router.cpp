@@ -0,0 +1,262 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-18
+ * @copyleft Apache 2.0
+ */
+
+#include "http/router.h"
+
+#include <algorithm>
+
+#include "http/httprequest.h"
+#include "http/httpresponse.h"
+#include "utils/logger.h"
+
+namespace webserver {
+
+namespace {
+
+/* 路由只看路径, 查询串不参与匹配 */
+StringPiece PathOf(const StringPiece& target) {
+  return target.substr(0, target.find('?'));
+}
+
+}  // namespace
+
+Router::Router() : root_(new Node) { root_->type = STATIC; }
+
+Router::~Router() = default;
+
+Router* Router::Instance() {
+  static Router instance;
+  return &instance;
+}
+
+Router::METHOD Router::ToMethod(const StringPiece& method) {
+  static const char* const NAMES[] = {"GET",    "HEAD",  "POST",   "PUT",
+                                      "DELETE", "PATCH", "OPTIONS"};
+  for (int i = 0; i < ANY; ++i) {
+    if (method == NAMES[i]) {
+      return static_cast<METHOD>(i);
+    }
+  }
+  return ANY;
+}
+
+bool Router::Handle(METHOD method, const std::string& pattern,
+                    Handler handler, bool inlineable) {
+  assert(handler);
+  return Add_(method, pattern,
+              [handler](HttpRequest& request, HttpResponse& response,
+                        const Done&) { handler(request, response); },
+              false, inlineable);
+}
+
+bool Router::HandleAsync(METHOD method, const std::string& pattern,
+                         AsyncHandler handler) {
+  assert(handler);
+  return Add_(method, pattern, std::move(handler), true, true);
+}
+
+bool Router::Static(const std::string& pattern, const std::string& file) {
+  size_t star = pattern.find('*');
+  if (star == std::string::npos) {
+    return Handle(ANY, pattern,
+                  [file](HttpRequest&, HttpResponse& response) {
+                    response.SetPath(file);
+                  },
+                  true);
+  }
+  /* 通配段的值是最后一个参数 */
+  return Handle(ANY, pattern,
+                [file](HttpRequest& request, HttpResponse& response) {
+                  StringPiece rest = request.params().back().value;
+                  response.SetPath(file + "/" + rest.ToString());
+                },
+                true);
+}
+
+Router::RESULT Router::Dispatch(HttpRequest& request,
+                               HttpResponse& response,
+                               const Done& done) const {
+  Params& params = request.params();
+  params.clear();
+  const Route* route = Match_(root_.get(), PathOf(request.path()),
+                              ToMethod(request.method()), &params);
+  if (!route) {
+    return NO_ROUTE;
+  }
+  if (route->async) {
+    /* 处理者完成前读缓冲区可能被改动, 请求不能再指向它 */
+    assert(done);
+    request.KeepHead();
+  }
+  route->handler(request, response, done);
+  return route->async ? PENDING : HANDLED;
+}
+
+bool Router::IsInlineable(const StringPiece& method,
+                          const StringPiece& target) const {
+  thread_local Params params;
+  params.clear();
+  const Route* route =
+      Match_(root_.get(), PathOf(target), ToMethod(method), &params);
+  return !route || route->inlineable;
+}
+
+bool Router::Add_(METHOD method, const std::string& pattern,
+                  AsyncHandler handler, bool async, bool inlineable) {
+  assert(method < METHOD_COUNT);
+  Node* node = Validate_(pattern) ? Insert_(pattern) : nullptr;
+  if (!node || node->routes[method].handler) {
+    LOG_ERROR("Route %s conflicts or is invalid", pattern.c_str());
+    return false;
+  }
+  Route& route = node->routes[method];
+  route.handler = std::move(handler);
+  route.async = async;
+  route.inlineable = inlineable;
+  return true;
+}
+
+/* 以'/'开头; ':'与'*'只能紧跟在'/'之后且名字非空, '*'之后不能再有'/' */
+bool Router::Validate_(const std::string& pattern) {
+  if (pattern.empty() || pattern[0] != '/') {
+    return false;
+  }
+  for (size_t i = 1; i < pattern.size(); ++i) {
+    char ch = pattern[i];
+    if (ch != ':' && ch != '*') {
+      continue;
+    }
+    size_t end = pattern.find('/', i);
+    if (pattern[i - 1] != '/' || end == i + 1 || i + 1 == pattern.size()) {
+      return false;
+    }
+    if (ch == '*' && end != std::string::npos) {
+      return false;
+    }
+    if (pattern.find_first_of(":*", i + 1) < end) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Router::Node* Router::Insert_(StringPiece pattern) {
+  Node* node = root_.get();
+  while (!pattern.empty()) {
+    char ch = pattern[0];
+    if (ch == ':' || ch == '*') {
+      size_t end = pattern.find('/');
+      if (end == StringPiece::npos) end = pattern.size();
+      StringPiece name = pattern.substr(1, end - 1);
+      std::unique_ptr<Node>& slot = (ch == ':') ? node->param : node->wildcard;
+      if (!slot) {
+        slot.reset(new Node);
+        slot->type = (ch == ':') ? PARAM : WILDCARD;
+        slot->prefix = name.ToString();
+      } else if (StringPiece(slot->prefix) != name) {
+        return nullptr;  // 同一位置的参数名不同
+      }
+      node = slot.get();
+      pattern.RemovePrefix(end);
+      continue;
+    }
+    size_t run = 0;
+    while (run < pattern.size() && pattern[run] != ':' &&
+           pattern[run] != '*') {
+      ++run;
+    }
+    size_t idx = node->indices.find(ch);
+    if (idx == std::string::npos) {
+      std::unique_ptr<Node> child(new Node);
+      child->type = STATIC;
+      child->prefix.assign(pattern.data(), run);
+      node->indices.push_back(ch);
+      node->children.push_back(std::move(child));
+      node = node->children.back().get();
+      pattern.RemovePrefix(run);
+      continue;
+    }
+    /* 与已有子节点的公共前缀, 不完全覆盖该子节点时把它拆成两段 */
+    std::unique_ptr<Node>& slot = node->children[idx];
+    size_t common = 0;
+    while (common < run && common < slot->prefix.size() &&
+           slot->prefix[common] == pattern[common]) {
+      ++common;
+    }
+    if (common < slot->prefix.size()) {
+      std::unique_ptr<Node> mid(new Node);
+      mid->type = STATIC;
+      mid->prefix = slot->prefix.substr(0, common);
+      slot->prefix.erase(0, common);
+      mid->indices.push_back(slot->prefix[0]);
+      mid->children.push_back(std::move(slot));
+      slot = std::move(mid);
+    }
+    node = slot.get();
+    pattern.RemovePrefix(common);
+  }
+  return node;
+}
+
+const Router::Route* Router::RouteOf_(const Node* node, METHOD method) {
+  if (node->routes[method].handler) {
+    return &node->routes[method];
+  }
+  if (node->routes[ANY].handler) {
+    return &node->routes[ANY];
+  }
+  return nullptr;
+}
+
+const Router::Route* Router::Match_(const Node* node, StringPiece path,
+                                    METHOD method, Params* params) const {
+  switch (node->type) {
+    case STATIC:
+      if (!path.StartsWith(node->prefix)) {
+        return nullptr;
+      }
+      path.RemovePrefix(node->prefix.size());
+      break;
+    case PARAM: {
+      size_t len = std::min(path.find('/'), path.size());
+      if (len == 0) {
+        return nullptr;
+      }
+      params->push_back({node->prefix, path.substr(0, len)});
+      path.RemovePrefix(len);
+      break;
+    }
+    case WILDCARD: {
+      const Route* route = RouteOf_(node, method);
+      if (route) {
+        params->push_back({node->prefix, path});
+      }
+      return route;
+    }
+  }
+
+  const Route* route = nullptr;
+  if (path.empty()) {
+    route = RouteOf_(node, method);
+  } else {
+    size_t idx = node->indices.find(path[0]);
+    if (idx != std::string::npos) {
+      route = Match_(node->children[idx].get(), path, method, params);
+    }
+    if (!route && node->param) {
+      route = Match_(node->param.get(), path, method, params);
+    }
+  }
+  if (!route && node->wildcard) {
+    route = Match_(node->wildcard.get(), path, method, params);
+  }
+  if (!route && node->type == PARAM) {
+    params->pop_back();
+  }
+  return route;
+}
+
+}  // namespace webserver
@@ -11,6 +11,20 @@ int main() {
   /* 守护进程 后台运行 */
   // daemon(1, 0);
 
+  /* 其余可调参数, 未设置的项取ServerOptions的默认值 */
+  webserver::ServerOptions options;
+  options.reactorNum = 0;
+  options.dispatchMode = 0;
+  options.reusePort = false;
+  options.backlog = 1024;
+  options.deferAcceptSec = 0;
+  options.ioBackend = webserver::Reactor::EPOLL;
+  options.hotRestart = true;
+  options.maxQueueDelayMS = 50;
+  options.inlineMaxBytes = 64 * 1024;
+  options.maxBodySize = 1024 * 1024;
+  options.maxUploadSize = 64 * 1024 * 1024;
+
   // todo 改成json配置文件, 修改配置不用重新编译
   webserver::WebServer server(
       /* 服务器配置: 服务器端口 ET模式 timeout(ms) 优雅退出 */
@@ -20,7 +34,7 @@ int main() {
       /* 线程池配置: 连接池数量 线程池数量*/
       2, 6,
       /* 日志配置: 日志开关 日志等级 日志异步队列容量 */
-      true, 0, 4096);
+      true, 0, 4096, options);
 
   server.Start();
 
@@ -0,0 +1,61 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-12
+ * @copyleft Apache 2.0
+ */
+
+#include "pool/admissionlimiter.h"
+
+#include <algorithm>
+
+namespace webserver {
+
+constexpr double AdmissionLimiter::BACKOFF;
+
+AdmissionLimiter::AdmissionLimiter(int minLimit, int maxLimit, int initLimit,
+                                   int targetDelayMS)
+    : min_limit_(std::max(1, minLimit)),
+      max_limit_(std::max(min_limit_, maxLimit)),
+      target_us_(static_cast<int64_t>(targetDelayMS) * 1000),
+      inflight_(0),
+      limit_(std::min(max_limit_, std::max(min_limit_, initLimit))),
+      rejected_(0),
+      latency_us_(0),
+      limit_f_(limit_),
+      last_backoff_(SteadyClock::now()) {}
+
+bool AdmissionLimiter::TryAcquire() {
+  int cur = inflight_.load();
+  do {
+    if (cur >= limit_.load()) {
+      ++rejected_;
+      return false;
+    }
+  } while (!inflight_.compare_exchange_weak(cur, cur + 1));
+  return true;
+}
+
+void AdmissionLimiter::Release(int64_t queueUs, int64_t latencyUs) {
+  int inflight = inflight_--;
+
+  std::lock_guard<decltype(mtx_)> lock(mtx_);
+  int64_t latency = latency_us_;
+  latency += (latencyUs - latency) / EMA_WEIGHT;
+  latency_us_ = latency;
+
+  if (queueUs > target_us_) {
+    /* 拥塞: 乘性减, 收缩后等队列消化一个平滑时延再判断 */
+    auto now = SteadyClock::now();
+    if (now - last_backoff_ >=
+        std::chrono::microseconds(std::max<int64_t>(latency, 1000))) {
+      limit_f_ = std::max<double>(min_limit_, limit_f_ * BACKOFF);
+      last_backoff_ = now;
+    }
+  } else if (inflight * 2 >= limit_f_) {
+    /* 上限确实被用到时才加性增, 避免空闲时上限无限增长 */
+    limit_f_ = std::min<double>(max_limit_, limit_f_ + 1.0 / limit_f_);
+  }
+  limit_ = static_cast<int>(limit_f_);
+}
+
+}  // namespace webserver
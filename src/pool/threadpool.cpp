@@ -8,8 +8,13 @@
 
 namespace webserver {
 
-ThreadPool::ThreadPool(size_t n_threads)
+ThreadPool::ThreadPool(size_t n_threads, int maxQueueDelayMS)
     : pool_(std::make_shared<Pool>(false)) {
+  if (maxQueueDelayMS > 0) {
+    int threads = static_cast<int>(n_threads);
+    limiter_.reset(new AdmissionLimiter(
+        threads, MAX_LIMIT, threads * INIT_LIMIT_RATIO, maxQueueDelayMS));
+  }
   for (size_t i = 0; i < n_threads; ++i) {
     /* warning: lambda capture initializers only available
      * with -std=c++14 or -std=gnu++14
@@ -18,7 +23,7 @@ ThreadPool::ThreadPool(size_t n_threads)
     workers_.emplace_back([this]() {
       std::shared_ptr<Pool> pool = this->pool_;
       while (true) {
-        std::function<void()> task;
+        Item item;
         {
           std::unique_lock<decltype(pool->mtx)> lock(pool->mtx);
           pool->cv.wait(
@@ -28,10 +33,10 @@ ThreadPool::ThreadPool(size_t n_threads)
             return;
           }
 
-          task = std::move(pool->tasks.front());
+          item = std::move(pool->tasks.front());
           pool->tasks.pop();
         }
-        task();
+        RunItem_(item);
       }
     });
   }
@@ -59,14 +64,47 @@ ThreadPool::~ThreadPool() {
 
 */
 void ThreadPool::AddTask(Task &&task) {
+  Push_(Item{std::forward<Task>(task), false, SteadyClock::time_point()});
+}
+
+/* 入队时记录时间, 工作线程开始执行时得到排队时延, 执行完得到总时延 */
+bool ThreadPool::TryAddTask(Task &&task) {
+  if (!limiter_) {
+    AddTask(std::forward<Task>(task));
+    return true;
+  }
+  if (!limiter_->TryAcquire()) {
+    return false;
+  }
+  Push_(Item{std::forward<Task>(task), true, SteadyClock::now()});
+  return true;
+}
+
+/* ---------------------- 私有方法 ---------------------- */
+
+void ThreadPool::Push_(Item &&item) {
   if (pool_->closed) {
     throw std::runtime_error("add task into a closed thread pool");
   }
   {
     std::lock_guard<decltype(pool_->mtx)> lock(pool_->mtx);
-    pool_->tasks.emplace(std::forward<Task>(task));
+    pool_->tasks.emplace(std::move(item));
   }
   pool_->cv.notify_one();
 }
 
-}  // namespace webserver
\ No newline at end of file
+void ThreadPool::RunItem_(Item &item) {
+  if (!item.admitted) {
+    item.task();
+    return;
+  }
+  using std::chrono::microseconds;
+  using std::chrono::duration_cast;
+  SteadyClock::time_point start = SteadyClock::now();
+  item.task();
+  SteadyClock::time_point end = SteadyClock::now();
+  limiter_->Release(duration_cast<microseconds>(start - item.enqueue).count(),
+                    duration_cast<microseconds>(end - item.enqueue).count());
+}
+
+}  // namespace webserver
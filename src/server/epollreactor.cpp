@@ -0,0 +1,362 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-15
+ * @copyleft Apache 2.0
+ */
+
+#include "server/epollreactor.h"
+
+namespace webserver {
+
+EpollReactor::EpollReactor(int timeoutMS, uint32_t connEvent,
+                           ThreadPool* threadpool)
+    : Reactor(timeoutMS, threadpool),
+      listen_event_(0),
+      persistent_(connEvent & EPOLLET),
+      epoller_(new Epoller()),
+      users_(ConnTable_()) {
+  /* ET模式下连接以EPOLLIN|EPOLLOUT持久注册, 事件只在状态变化时通知一次,
+     由持有者读写到EAGAIN; LT模式下仍靠EPOLLONESHOT保证单线程处理 */
+  conn_event_ = persistent_ ? (connEvent & ~EPOLLONESHOT) | EPOLLOUT
+                            : connEvent | EPOLLONESHOT;
+  /* wakeup_fd_ 使用LT模式, 每次唤醒后在DealWakeup_中读空计数器 */
+  if (!epoller_->EpollAdd(wakeup_fd_, EPOLLIN, &wakeup_fd_)) {
+    LOG_ERROR("Reactor add wakeup fd error!");
+  }
+}
+
+bool EpollReactor::AddListener(int listenFd, uint32_t listenEvent,
+                               const AcceptCallback& cb) {
+  assert(listenFd > 0);
+  listen_fd_ = listenFd;
+  listen_event_ = listenEvent;
+  on_accept_ = cb;
+  return epoller_->EpollAdd(listen_fd_, listen_event_ | EPOLLIN, &listen_fd_);
+}
+
+void EpollReactor::Loop() {
+  int timeMS = -1;  // epoll wait timeout == -1 无事件将阻塞
+  while (!closed_) {
+    if (timeout_ms_ > 0) {
+      timeMS = timer_->GetNextTick();
+    }
+
+    /* eventCnt is the number of triggered events returned in "events" buffer */
+    int eventCnt = epoller_->EpollWait(timeMS);
+    bool wakeup = false;
+    for (int i = 0; i < eventCnt; i++) {
+      // 处理事件, data.ptr指向监听fd、唤醒fd或连接表中的EpollConn
+      void* ptr = epoller_->GetEventPtr(i);
+      uint32_t events = epoller_->GetEpollEvents(i);
+
+      if (ptr == &listen_fd_) {
+        /* 监听socket, 同一批事件中可能已被RemoveListener_注销 */
+        if (listen_fd_ >= 0) DealListen_();
+        continue;
+      } else if (ptr == &wakeup_fd_) {
+        /* 其他线程投递了新连接或要求退出, 在这批事件之后处理 */
+        wakeup = true;
+        continue;
+      }
+
+      EpollConn* client = static_cast<EpollConn*>(ptr);
+      ExtentTime_(client);
+      Dispatch_(client, events);
+    }
+    /* 线程池关闭的连接在投递的任务中才close; 这批事件里可能还有在它
+       EpollRemove之前取到的旧事件, 处理完之后fd才能被新连接复用 */
+    if (wakeup) {
+      DealWakeup_();
+    }
+  }
+}
+
+/* ---------------------- 私有方法 ---------------------- */
+
+/* fd在进程内唯一, 所有Reactor共享同一张表, 每个fd同一时刻只属于一个Reactor */
+FdSlab<EpollReactor::EpollConn>* EpollReactor::ConnTable_() {
+  static FdSlab<EpollConn> table(MAX_FD);
+  return &table;
+}
+
+/*服务端新增一个连接*/
+void EpollReactor::AddClient_(int fd, sockaddr_in addr) {
+  assert(fd > 0);
+  EpollConn* client = users_->Get(fd);
+  /* 上一个使用该fd的连接已在FinishClose_中注销, 此时没有任何持有者 */
+  assert(!client->busy);
+  client->conn.init(fd, addr);
+  /* done可能在任意线程中调用, 先回到本线程再交给持有者 */
+  client->conn.SetCompletion([this, client]() {
+    RunInLoop([this, client]() { Complete_(client); });
+  });
+  client->events = 0;
+  client->fd = fd;
+  client->hangup = false;
+  ++conn_count_;
+
+  if (timeout_ms_ > 0) {
+    /* 超时只投递一个HUP事件, 由持有者负责关闭 */
+    timer_->AddItem(fd, timeout_ms_, [this, client]() { Expire_(client); });
+  }
+
+  /* clientfd在accept4时已设置为非阻塞 */
+  epoller_->EpollAdd(fd, EPOLLIN | conn_event_, client);
+
+  LOG_INFO("Client[%d, %s:%d] connected!", fd,
+           ConvertIP(addr.sin_addr.s_addr).c_str(), addr.sin_port);
+}
+
+void EpollReactor::RemoveListener_() {
+  if (listen_fd_ < 0) return;
+  epoller_->EpollRemove(listen_fd_);
+  listen_fd_ = -1;
+}
+
+void EpollReactor::DealListen_() {
+  struct sockaddr_in addr;       // 此处表示一个Internet socket address
+  socklen_t len = sizeof(addr);  // 获取地址长度，地址内存在padding
+  do {
+    /* 提取挂起队列的第一个连接请求，创建一个新的连接套接字并返回其fd,
+       accept4直接得到非阻塞、close-on-exec的clientfd, 省去一次fcntl */
+    int fd = accept4(listen_fd_, (struct sockaddr*)&addr, &len,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd <= 0) {
+      /* 错误返回, socket为nonblock，队列空则返回EWOULDBLOCK （EAGAIN 11） */
+      LOG_ERROR("%s: errno is: %d (%s)", "accept error", errno,
+                strerror(errno));
+      return;
+    } else if (HttpConn::userCount >= MAX_FD || fd >= MAX_FD) {
+      /* 超出最大连接数 */
+      SendError_(fd, "Server busy!");
+      LOG_WARN("Clients is full!");
+      return;
+    }
+    /* 正常fd则添加新的客户端信息, 或交给回调分发 */
+    if (on_accept_) {
+      on_accept_(fd, addr);
+    } else {
+      AddClient_(fd, addr);
+    }
+  } while (listen_event_ & EPOLLET);  // EPOLLET模式继续循环
+}
+
+void EpollReactor::DealWakeup_() {
+  uint64_t cnt = 0;
+  if (read(wakeup_fd_, &cnt, sizeof(cnt)) != sizeof(cnt)) {
+    return;
+  }
+  DoPendingTasks_();
+}
+
+void EpollReactor::ExtentTime_(EpollConn* client) {
+  assert(client);
+  if (timeout_ms_ > 0) {
+    timer_->UpdateItem(client->fd, timeout_ms_);
+  }
+}
+
+/* 等待异步处理者的连接不算空闲, 重新计时; 处理者的完成通知也在本线程
+   中执行, 判断期间状态不会改变 */
+void EpollReactor::Expire_(EpollConn* client) {
+  if (client->conn.InHandler()) {
+    timer_->AddItem(client->fd, timeout_ms_,
+                    [this, client]() { Expire_(client); });
+    return;
+  }
+  Dispatch_(client, EPOLLHUP);
+}
+
+/* 连接在异步处理者完成前不会关闭, 此时仍属于本Reactor; 在LT模式下它
+   没有重新注册, ET模式下不会再有EPOLLOUT, 都由这里投递的事件继续 */
+void EpollReactor::Complete_(EpollConn* client) {
+  client->conn.Complete();
+  ExtentTime_(client);
+  Dispatch_(client, EPOLLOUT);
+}
+
+/* ---------------------- 连接所有权 ---------------------- */
+
+void EpollReactor::Dispatch_(EpollConn* client, uint32_t events) {
+  client->events |= events;
+  if (client->busy.exchange(true)) {
+    return;  // 持有者释放所有权前会处理新记入的事件
+  }
+  /* 在本线程中开始处理, 需要时由Handle_/Progress_移交给线程池 */
+  Run_(client, true);
+}
+
+void EpollReactor::Run_(EpollConn* client, bool onLoop) {
+  for (;;) {
+    uint32_t events = client->events.exchange(0);
+    if (!Handle_(client, events, onLoop)) {
+      return;  // 所有权已移交给线程池
+    }
+    int fd = client->released_fd;
+    client->released_fd = -1;
+    client->busy = false;
+    if (fd >= 0) {
+      /* 释放所有权之后才close, 此后该fd才可能被新连接复用 */
+      if (onLoop) {
+        FinishClose_(fd);
+      } else {
+        RunInLoop([this, fd]() { FinishClose_(fd); });
+      }
+      return;
+    }
+    /* 释放期间到达的事件由本线程重新抢占后继续处理 */
+    if (client->events == 0 || client->busy.exchange(true)) {
+      return;
+    }
+  }
+}
+
+bool EpollReactor::Handle_(EpollConn* client, uint32_t events, bool onLoop) {
+  HttpConn* conn = &client->conn;
+  if (conn->IsClosed()) {
+    return true;
+  }
+  if (client->hangup || (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+    /* 对端关闭、出错或超时 */
+    CloseConn_(client);
+    return true;
+  }
+  if ((events & EPOLLIN) && conn->IsPending()) {
+    /* 等待异步处理者时不读取: 读缓冲区保持不变, 也不会无限增长;
+       回复发出后由ReadMore_接着读 */
+    conn->SkipRead();
+  } else if (events & EPOLLIN) {
+    if (onLoop && inline_max_bytes_ == 0) {
+      /* 未开启快速路径时读取与处理都在线程池中进行 */
+      client->events |= EPOLLIN;
+      return Offload_(client, true);
+    }
+    int readErrno = 0;
+    ssize_t ret = conn->read(&readErrno);
+    if (ret <= 0 && readErrno != EAGAIN) {
+      CloseConn_(client);
+      return true;
+    }
+  }
+  return Progress_(client, onLoop);
+}
+
+/* 先发送未写完的响应, 再依次处理读缓冲区中的请求(可能是流水线请求);
+   在事件循环线程中遇到慢路径时交给线程池: POST会访问数据库,
+   大文件发送时的缺页可能阻塞在磁盘I/O上 */
+bool EpollReactor::Progress_(EpollConn* client, bool onLoop) {
+  HttpConn* conn = &client->conn;
+  for (;;) {
+    if (conn->ToWriteBytes() > 0) {
+      if (onLoop &&
+          static_cast<size_t>(conn->ToWriteBytes()) > inline_max_bytes_) {
+        return Offload_(client, false);
+      }
+      int writeErrno = 0;
+      ssize_t ret = conn->write(&writeErrno);
+      if (conn->ToWriteBytes() > 0) {
+        /* 发送缓冲区已满(LT模式下也可能只写出一部分), 等待EPOLLOUT */
+        if (ret > 0 || writeErrno == EAGAIN) {
+          Rearm_(client, EPOLLOUT);
+        } else {
+          CloseConn_(client);
+        }
+        return true;
+      }
+      /* 传输完成, 热重启排空期间不再保持连接; 还有请求在等待异步处理者
+         时先发送它的回复 */
+      if (!conn->IsPending() && (!conn->IsKeepAlive() || draining_)) {
+        CloseConn_(client);
+        return true;
+      }
+    }
+    if (conn->IsPending()) {
+      /* 异步处理者已完成时接着发送它的回复, 否则等待Complete_投递的事件,
+         期间不重新注册 */
+      if (!conn->Resume()) {
+        return true;
+      }
+      continue;
+    }
+    if (conn->ToReadBytes() == 0 && !ReadMore_(client)) {
+      return true;
+    }
+    if (onLoop && (inline_max_bytes_ == 0 || !conn->IsInlineable())) {
+      return Offload_(client, true);
+    }
+    /* 在事件循环线程中只批量处理可内联的请求, 遇到POST时停下 */
+    if (!conn->process(onLoop) && !conn->IsPending() && !ReadMore_(client)) {
+      /* 请求不完整, 等待更多数据 */
+      return true;
+    }
+  }
+}
+
+/* 读缓冲区已处理完或请求不完整: 上一次read在READ_BUDGET处停下时socket中
+   还有数据, ET模式下不会再通知, 接着读; 否则等待下一次EPOLLIN。
+   返回false时已重新注册或关闭连接 */
+bool EpollReactor::ReadMore_(EpollConn* client) {
+  HttpConn* conn = &client->conn;
+  if (!conn->ReadPending()) {
+    Rearm_(client, EPOLLIN);
+    return false;
+  }
+  int readErrno = 0;
+  ssize_t ret = conn->read(&readErrno);
+  if (ret <= 0 && readErrno != EAGAIN) {
+    CloseConn_(client);
+    return false;
+  }
+  return true;
+}
+
+bool EpollReactor::Offload_(EpollConn* client, bool gated) {
+  /* 只捕获两个指针, 可存放在std::function内部, 每次移交不再堆分配 */
+  Task task = [this, client]() { Run_(client, false); };
+  if (!gated) {
+    threadpool_->AddTask(std::move(task));
+    return false;
+  }
+  if (threadpool_->TryAddTask(std::move(task))) {
+    return false;
+  }
+  /* 过载: 读掉请求后直接返回503, 不再进入线程池排队 */
+  int readErrno = 0;
+  client->conn.read(&readErrno);
+  SendBusy_(client->fd);
+  CloseConn_(client);
+  return true;
+}
+
+void EpollReactor::Rearm_(EpollConn* client, uint32_t events) {
+  if (!persistent_) {
+    epoller_->EpollModify(client->fd, conn_event_ | events, client);
+  }
+}
+
+/*服务端正常关闭与某个client的连接*/
+void EpollReactor::CloseConn_(EpollConn* client) {
+  assert(client);
+  HttpConn* conn = &client->conn;
+  if (conn->IsClosed()) return;
+  if (conn->InHandler()) {
+    client->hangup = true;
+    return;
+  }
+  client->hangup = false;
+  LOG_INFO("Client[%d, %s:%d] quit!", client->fd,
+           ConvertIP(conn->GetAddr().sin_addr.s_addr).c_str(),
+           conn->GetAddr().sin_port);
+  epoller_->EpollRemove(client->fd);
+  client->released_fd = conn->Release();
+  --conn_count_;
+}
+
+void EpollReactor::FinishClose_(int fd) {
+  if (timeout_ms_ > 0) {
+    timer_->CancelItem(fd);
+  }
+  close(fd);
+}
+
+}  // namespace webserver
@@ -0,0 +1,234 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-05
+ * @copyleft Apache 2.0
+ */
+
+#include "server/hotrestart.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include <cstdlib>
+#include <fstream>
+
+extern char** environ;
+
+namespace webserver {
+
+constexpr const char* HotRestart::ENV_NAME;
+int HotRestart::sig_pipe_[2] = {-1, -1};
+
+HotRestart::HotRestart(int signo) : signo_(signo), channel_fd_(-1) {
+  /* 记录可执行文件路径和命令行参数, 部署时替换该路径上的文件即可升级 */
+  char path[4096] = {0};
+  ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  if (len > 0) {
+    exe_path_.assign(path, len);
+  }
+  std::ifstream cmdline("/proc/self/cmdline");
+  std::string arg;
+  while (std::getline(cmdline, arg, '\0')) {
+    args_.push_back(arg);
+  }
+  if (args_.empty()) {
+    args_.push_back(exe_path_);
+  }
+
+  /* 被旧进程拉起时, 环境变量中带有通信socket */
+  const char* env = getenv(ENV_NAME);
+  if (env) {
+    channel_fd_ = atoi(env);
+    unsetenv(ENV_NAME);
+    fcntl(channel_fd_, F_SETFD, FD_CLOEXEC);
+  }
+
+  if (pipe2(sig_pipe_, O_CLOEXEC) == 0) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &HotRestart::OnSignal_;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(signo_, &sa, nullptr);
+  }
+}
+
+HotRestart::~HotRestart() {
+  signal(signo_, SIG_DFL);
+  for (int& fd : sig_pipe_) {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  if (channel_fd_ >= 0) {
+    close(channel_fd_);
+  }
+}
+
+bool HotRestart::TakeListenFds(std::vector<int>* fds) {
+  if (channel_fd_ < 0) {
+    return false;
+  }
+  return RecvFds_(channel_fd_, fds);
+}
+
+void HotRestart::NotifyReady() {
+  if (channel_fd_ < 0) {
+    return;
+  }
+  char ready = 'R';
+  if (write(channel_fd_, &ready, 1) != 1) {
+    /* 旧进程已退出或超时放弃, 新进程照常服务 */
+  }
+  close(channel_fd_);
+  channel_fd_ = -1;
+}
+
+bool HotRestart::WaitSignal() {
+  char c = 0;
+  for (;;) {
+    ssize_t ret = read(sig_pipe_[0], &c, 1);
+    if (ret == 1) {
+      return c == 'U';
+    } else if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    return false;
+  }
+}
+
+void HotRestart::Interrupt() {
+  char quit = 'Q';
+  if (write(sig_pipe_[1], &quit, 1) != 1) {
+    /* 管道已关闭 */
+  }
+}
+
+bool HotRestart::Spawn(const std::vector<int>& fds, int timeoutMS) {
+  if (exe_path_.empty()) {
+    return false;
+  }
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+    return false;
+  }
+
+  /* fork之后子进程只能调用异步信号安全的函数, argv与envp提前准备好 */
+  std::string env = std::string(ENV_NAME) + "=" + std::to_string(sv[1]);
+  std::vector<char*> envp;
+  size_t prefix = strlen(ENV_NAME);
+  for (char** e = environ; *e; ++e) {
+    if (strncmp(*e, ENV_NAME, prefix) != 0 || (*e)[prefix] != '=') {
+      envp.push_back(*e);
+    }
+  }
+  envp.push_back(&env[0]);
+  envp.push_back(nullptr);
+  std::vector<char*> argv;
+  for (auto& arg : args_) {
+    argv.push_back(&arg[0]);
+  }
+  argv.push_back(nullptr);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    /* 子进程: 只保留通信socket, 监听socket随后通过SCM_RIGHTS传递 */
+    fcntl(sv[1], F_SETFD, 0);
+    execve(exe_path_.c_str(), argv.data(), envp.data());
+    _exit(127);
+  }
+  close(sv[1]);
+  if (pid < 0) {
+    close(sv[0]);
+    return false;
+  }
+
+  bool ok = SendFds_(sv[0], fds);
+  if (ok) {
+    struct pollfd pfd = {sv[0], POLLIN, 0};
+    char ready = 0;
+    ok = poll(&pfd, 1, timeoutMS) == 1 && read(sv[0], &ready, 1) == 1 &&
+         ready == 'R';
+  }
+  close(sv[0]);
+  if (!ok) {
+    /* 新进程启动失败或未按时就绪, 避免两个进程同时服务 */
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+  }
+  return ok;
+}
+
+/* ---------------------- 私有方法 ---------------------- */
+
+void HotRestart::OnSignal_(int) {
+  int saved = errno;
+  char upgrade = 'U';
+  if (write(sig_pipe_[1], &upgrade, 1) != 1) {
+    /* 信号处理函数中无法记录日志 */
+  }
+  errno = saved;
+}
+
+/* 数据部分为fd个数, 控制消息部分携带fd本身 */
+bool HotRestart::SendFds_(int sock, const std::vector<int>& fds) {
+  if (fds.empty() || fds.size() > MAX_FDS) {
+    return false;
+  }
+  int num = static_cast<int>(fds.size());
+  struct iovec iov = {&num, sizeof(num)};
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * num));
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * num);
+  memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * num);
+
+  return sendmsg(sock, &msg, MSG_NOSIGNAL) == sizeof(num);
+}
+
+bool HotRestart::RecvFds_(int sock, std::vector<int>* fds) {
+  int num = 0;
+  struct iovec iov = {&num, sizeof(num)};
+  char control[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t ret;
+  do {
+    ret = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  } while (ret < 0 && errno == EINTR);
+  if (ret != sizeof(num)) {
+    return false;
+  }
+
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    size_t cnt = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    const int* data = reinterpret_cast<const int*>(CMSG_DATA(cmsg));
+    fds->insert(fds->end(), data, data + cnt);
+  }
+  return static_cast<int>(fds->size()) == num;
+}
+
+}  // namespace webserver
@@ -0,0 +1,114 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-08
+ * @copyleft Apache 2.0
+ */
+
+#include "server/reactor.h"
+
+#include "server/epollreactor.h"
+#include "server/uringreactor.h"
+
+namespace webserver {
+
+bool Reactor::Supported(int backend) {
+  return backend != IO_URING || UringReactor::Supported();
+}
+
+Reactor* Reactor::Create(int backend, int timeoutMS, uint32_t connEvent,
+                         ThreadPool* threadpool) {
+  if (backend == IO_URING) {
+    if (Supported(IO_URING)) {
+      return new UringReactor(timeoutMS, threadpool);
+    }
+    LOG_WARN("io_uring is not supported, fall back to epoll");
+  }
+  return new EpollReactor(timeoutMS, connEvent, threadpool);
+}
+
+Reactor::Reactor(int timeoutMS, ThreadPool* threadpool)
+    : timeout_ms_(timeoutMS),
+      closed_(false),
+      draining_(false),
+      inline_max_bytes_(0),
+      listen_fd_(-1),
+      wakeup_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      conn_count_(0),
+      threadpool_(threadpool),
+      timer_(new TimingWheel()) {
+  assert(threadpool_);
+  if (wakeup_fd_ < 0) {
+    LOG_ERROR("Reactor create wakeup fd error!");
+  }
+}
+
+Reactor::~Reactor() {
+  if (wakeup_fd_ >= 0) {
+    close(wakeup_fd_);
+  }
+}
+
+void Reactor::Stop() {
+  closed_ = true;
+  uint64_t one = 1;
+  if (write(wakeup_fd_, &one, sizeof(one)) != sizeof(one)) {
+    LOG_WARN("Reactor wakeup error: %d (%s)", errno, strerror(errno));
+  }
+}
+
+void Reactor::RunInLoop(Task&& task) {
+  {
+    std::lock_guard<decltype(pending_mtx_)> lock(pending_mtx_);
+    pending_tasks_.emplace_back(std::forward<Task>(task));
+  }
+  uint64_t one = 1;
+  if (write(wakeup_fd_, &one, sizeof(one)) != sizeof(one)) {
+    LOG_WARN("Reactor wakeup error: %d (%s)", errno, strerror(errno));
+  }
+}
+
+void Reactor::QueueConn(int fd, const sockaddr_in& addr) {
+  RunInLoop(std::bind(&Reactor::AddClient_, this, fd, addr));
+}
+
+void Reactor::Drain() {
+  draining_ = true;
+  RunInLoop(std::bind(&Reactor::RemoveListener_, this));
+}
+
+/* ---------------------- 私有方法 ---------------------- */
+
+void Reactor::DoPendingTasks_() {
+  std::vector<Task> tasks;
+  {
+    std::lock_guard<decltype(pending_mtx_)> lock(pending_mtx_);
+    tasks.swap(pending_tasks_);
+  }
+  for (auto& task : tasks) {
+    task();
+  }
+}
+
+/* 如果服务器端出现错误，则返回info给客户端并关闭当前连接*/
+void Reactor::SendError_(int fd, const char* info) {
+  assert(fd > 0);
+  int ret = send(fd, info, strlen(info), 0);
+  if (ret < 0) {
+    LOG_WARN("send error to client[%d] error!", fd);
+  }
+  close(fd);
+}
+
+void Reactor::SendBusy_(int fd) {
+  static const char busy[] =
+      "HTTP/1.1 503 Service Unavailable\r\n"
+      "Connection: close\r\n"
+      "Retry-After: 1\r\n"
+      "Content-Length: 0\r\n\r\n";
+  /* socket为非阻塞, 发送不完整也不再重试 */
+  if (send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL) < 0) {
+    LOG_WARN("send 503 to client[%d] error!", fd);
+  }
+}
+
+}  // namespace webserver
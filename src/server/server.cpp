@@ -6,19 +6,121 @@
 
 #include "server/server.h"
 
+#include <strings.h>  // bzero
+
+#include "http/router.h"
+
 namespace webserver {
 
+namespace {
+
+bool UserVerify(const std::string& name, const std::string& pwd,
+                bool isLogin) {
+  if (name == "" || pwd == "") {
+    return false;
+  }
+  LOG_INFO("Verify name:%s pwd:%s", name.c_str(), pwd.c_str());
+  MYSQL* sql;
+  /* 整个查询期间独占这个连接, 函数返回时归还 */
+  SqlConnRAII guard(&sql, SqlConnPool::Instance());
+  assert(sql);
+
+  bool flag = false;
+  // int j = 0;
+  char order[256] = {0};
+  // MYSQL_FIELD* fields = nullptr;
+  MYSQL_RES* res = nullptr;
+
+  if (!isLogin) {
+    flag = true;
+  }
+  /* 查询用户及密码 */
+  snprintf(order, 256,
+           "SELECT username, password FROM user WHERE username='%s' LIMIT 1",
+           name.c_str());
+  LOG_DEBUG("%s", order);
+
+  if (mysql_query(sql, order)) {
+    mysql_free_result(res);
+    return false;
+  }
+  res = mysql_store_result(sql);
+  // j = mysql_num_fields(res);
+  // fields = mysql_fetch_fields(res);
+
+  while (MYSQL_ROW row = mysql_fetch_row(res)) {
+    LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
+    std::string password(row[1]);
+    /* 登录行为 核验密码*/
+    if (isLogin) {
+      if (pwd == password) {
+        flag = true;
+      } else {
+        flag = false;
+        LOG_DEBUG("pwd error!");
+      }
+    } else {
+      flag = false;
+      LOG_DEBUG("user used!");
+    }
+  }
+  mysql_free_result(res);
+
+  /* 注册行为 且 用户名未被使用*/
+  if (!isLogin && flag == true) {
+    LOG_DEBUG("regirster!");
+    bzero(order, 256);
+    snprintf(order, 256,
+             "INSERT INTO user(username, password) VALUES('%s','%s')",
+             name.c_str(), pwd.c_str());
+    LOG_DEBUG("%s", order);
+    if (mysql_query(sql, order)) {
+      LOG_DEBUG("Insert error!");
+      flag = false;
+    }
+    flag = true;
+  }
+  LOG_DEBUG("UserVerify success!!");
+  return flag;
+}
+
+/* 登录与注册表单提交到同一个页面, 结果以欢迎页或错误页回复; 查询在
+   sqlpool中进行, 完成后通过done回复 */
+void UserHandler(ThreadPool* sqlpool, bool isLogin, HttpRequest& request,
+                 HttpResponse& response, const Router::Done& done) {
+  HttpRequest* req = &request;
+  HttpResponse* res = &response;
+  sqlpool->AddTask([req, res, isLogin, done]() {
+    if (UserVerify(req->GetPost("username"), req->GetPost("password"),
+                   isLogin)) {
+      res->SetPath("/welcome.html");
+    } else {
+      res->SetPath("/error.html");
+    }
+    done();
+  });
+}
+
+}  // namespace
+
 WebServer::WebServer(int port, int trigMode, int timeoutMS, bool OptLinger,
                      int sqlPort, const char* sqlUser, const char* sqlPwd,
                      const char* dbName, int connPoolNum, int threadNum,
-                     bool openLog, int logLevel, int logQueSize)
+                     bool openLog, int logLevel, int logQueSize,
+                     const ServerOptions& options)
     : port_(port),
       open_linger_(OptLinger),
       timeout_ms_(timeoutMS),
       closed_(false),
-      timer_(new MinHeapTimer()),
-      threadpool_(new ThreadPool(threadNum)),
-      epoller_(new Epoller()) {
+      reuse_port_(options.reusePort),
+      backlog_(options.backlog),
+      defer_accept_sec_(options.deferAcceptSec),
+      dispatch_mode_(options.dispatchMode),
+      next_reactor_(0),
+      threadpool_(new ThreadPool(threadNum, options.maxQueueDelayMS)),
+      sqlpool_(new ThreadPool(connPoolNum)),
+      hot_restart_(options.hotRestart ? new HotRestart() : nullptr),
+      inherited_fds_(0) {
   /* 获取当前工作路径，检测路径是否未NULL */
   std::string base_dir(getcwd(nullptr, 256));
   assert(!base_dir.empty());
@@ -29,6 +131,11 @@ WebServer::WebServer(int port, int trigMode, int timeoutMS, bool OptLinger,
   /*HttpConn三个静态成员变量的初始化*/
   HttpConn::userCount = 0;
   HttpConn::srcDir = src_dir_;
+  HttpRequest::maxBodySize = options.maxBodySize;
+  HttpRequest::maxUploadSize = options.maxUploadSize;
+
+  /* sendfile没有MSG_NOSIGNAL, 对端已关闭时由返回的EPIPE处理 */
+  signal(SIGPIPE, SIG_IGN);
 
   /* 单例模式:SqlConnPool统一管理数据库的连接 */
   SqlConnPool::Instance()->Initialize("localhost", sqlPort, sqlUser, sqlPwd,
@@ -41,6 +148,25 @@ WebServer::WebServer(int port, int trigMode, int timeoutMS, bool OptLinger,
    * 3，表示使用ET + ET */
   InitEventMode_(trigMode);
 
+  /* 日志尚未初始化, 先确定实际使用的I/O后端, 在下面记录 */
+  int ioBackend = options.ioBackend;
+  bool uringFallback = !Reactor::Supported(ioBackend);
+  if (uringFallback) {
+    ioBackend = Reactor::EPOLL;
+  }
+
+  /* reactorNum > 0 时开启多Reactor模式, 每个子Reactor独占一个线程 */
+  main_reactor_.reset(Reactor::Create(ioBackend, timeout_ms_, conn_event_,
+                                      threadpool_.get()));
+  for (int i = 0; i < options.reactorNum; ++i) {
+    sub_reactors_.emplace_back(Reactor::Create(ioBackend, timeout_ms_,
+                                               conn_event_, threadpool_.get()));
+  }
+  main_reactor_->SetInlineStatic(options.inlineMaxBytes);
+  for (auto& reactor : sub_reactors_) {
+    reactor->SetInlineStatic(options.inlineMaxBytes);
+  }
+
   /* 创建listenfd */
   if (!InitSocket_()) {
     closed_ = true;
@@ -56,28 +182,88 @@ WebServer::WebServer(int port, int trigMode, int timeoutMS, bool OptLinger,
     } else {
       LOG_INFO("Server init!");
       LOG_INFO("Port:%d, OpenLinger: %s", port_, OptLinger ? "true" : "false");
-      LOG_INFO("listenFd_ value: %d", listen_fd_);
+      LOG_INFO("listenFd_ num: %d, ReusePort: %s, Backlog: %d, DeferAccept: %ds",
+               (int)listen_fds_.size(), reuse_port_ ? "true" : "false",
+               backlog_, defer_accept_sec_);
+      LOG_INFO("HotRestart: %s, inherited listenFd num: %d",
+               hot_restart_ ? "SIGUSR2" : "off", inherited_fds_);
+      if (uringFallback) {
+        LOG_WARN("io_uring is not supported, fall back to epoll");
+      }
+      LOG_INFO("IO Backend: %s",
+               (ioBackend == Reactor::IO_URING ? "io_uring" : "epoll"));
       LOG_INFO("Listen Mode: %s, OpenConn Mode: %s",
                (listen_event_ & EPOLLET ? "ET" : "LT"),
                (conn_event_ & EPOLLET ? "ET" : "LT"));
+      LOG_INFO("Http scanner: %s", HttpScanner::LevelName());
       LOG_INFO("LogSys level: %d", logLevel);
       LOG_INFO("srcDir: %s", HttpConn::srcDir.c_str());
       LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum,
                threadNum);
+      if (threadpool_->Limiter()) {
+        LOG_INFO("Admission control: target queue delay %dms, init limit %d",
+                 options.maxQueueDelayMS, threadpool_->Limiter()->Limit());
+      } else {
+        LOG_INFO("Admission control: off");
+      }
+      LOG_INFO("Inline static fast path: %s, max response %d bytes",
+               options.inlineMaxBytes > 0 ? "on" : "off",
+               options.inlineMaxBytes);
+      LOG_INFO("Max request body: %zu bytes, streamed upload: %zu bytes",
+               options.maxBodySize, options.maxUploadSize);
+      LOG_INFO("Reactor num: %d, Dispatch Mode: %s", options.reactorNum,
+               (dispatch_mode_ == LEAST_LOADED ? "LeastLoaded" : "RoundRobin"));
     }
   }
+  InitRoutes_();
 }
 
 /* 析构函数的操作：关闭listenFd、标记server关闭状态、释放目录、释放mysql连接对象
  * 以ctrl+c方式退出是无法记录析构函数内的日志 */
 WebServer::~WebServer() {
-  close(listen_fd_);
+  if (upgrade_thread_.joinable()) {
+    hot_restart_->Interrupt();
+    upgrade_thread_.join();
+  }
+  for (auto& reactor : sub_reactors_) {
+    reactor->Stop();
+  }
+  for (auto& thread : reactor_threads_) {
+    thread.join();
+  }
+  for (int fd : listen_fds_) {
+    close(fd);
+  }
   closed_ = true;
 }
 
+/* 页面的短地址, 以及登录、注册表单的提交地址(表单提交到短地址) */
+void WebServer::InitRoutes_() {
+  using namespace std::placeholders;
+  Router* router = Router::Instance();
+  router->Static("/", "/index.html");
+  static const char* const PAGES[] = {"index",   "register", "login",
+                                      "welcome", "video",    "picture"};
+  for (const char* page : PAGES) {
+    router->Static(std::string("/") + page,
+                   std::string("/") + page + ".html");
+  }
+  for (const char* path : {"/login", "/login.html"}) {
+    router->HandleAsync(Router::POST, path,
+                        std::bind(UserHandler, sqlpool_.get(), true, _1, _2,
+                                  _3));
+  }
+  for (const char* path : {"/register", "/register.html"}) {
+    router->HandleAsync(Router::POST, path,
+                        std::bind(UserHandler, sqlpool_.get(), false, _1, _2,
+                                  _3));
+  }
+}
+
 /* 初始化event通知模式，默认是3(ET + ET) */
 void WebServer::InitEventMode_(int trigMode) {
   listen_event_ = EPOLLRDHUP;
+  /* ET模式下EpollReactor会去掉EPOLLONESHOT, 改为持久注册 */
   conn_event_ = EPOLLONESHOT | EPOLLRDHUP;
   switch (trigMode) {
     case 0:
@@ -103,178 +289,129 @@ void WebServer::InitEventMode_(int trigMode) {
 }
 
 void WebServer::Start() {
-  int timeMS = -1;  // epoll wait timeout == -1 无事件将阻塞
-  if (!closed_) {
-    LOG_INFO("Server start!");
+  if (closed_) {
+    return;
   }
-  while (!closed_) {
-    if (timeout_ms_ > 0) {
-      timeMS = timer_->GetNextTick();
-    }
-
-    /* eventCnt is the number of triggered events returned in "events" buffer */
-    int eventCnt = epoller_->EpollWait(timeMS);
-    for (int i = 0; i < eventCnt; i++) {
-      // 处理事件
-      int fd = epoller_->GetEventFd(i);
-      uint32_t events = epoller_->GetEpollEvents(i);
-
-      if (fd == listen_fd_) {
-        /* 监听socket */
-        DealListen_();
-      } else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-        /* 关闭连接 */
-        assert(users_.count(fd) > 0);
-        CloseConn_(&users_[fd]);
-      } else if (events & EPOLLIN) {
-        /* 读取 */
-        assert(users_.count(fd) > 0);
-        DealRead_(&users_[fd]);
-      } else if (events & EPOLLOUT) {
-        assert(users_.count(fd) > 0);
-        DealWrite_(&users_[fd]);
-      } else {
-        LOG_ERROR("Unexpected event");
-      }
-    }
+  LOG_INFO("Server start!");
+  for (auto& reactor : sub_reactors_) {
+    reactor_threads_.emplace_back(&Reactor::Loop, reactor.get());
   }
+  if (hot_restart_) {
+    /* 由旧进程拉起时, 通知其停止accept */
+    hot_restart_->NotifyReady();
+    upgrade_thread_ = std::thread(&WebServer::WatchUpgrade_, this);
+  }
+  main_reactor_->Loop();
 }
 
-/* 如果服务器端出现错误，则返回info给客户端并关闭当前连接*/
-void WebServer::SendError_(int fd, const char* info) {
-  assert(fd > 0);
-  int ret = send(fd, info, strlen(info), 0);
-  if (ret < 0) {
-    LOG_WARN("send error to client[%d] error!", fd);
+void WebServer::WatchUpgrade_() {
+  while (hot_restart_->WaitSignal()) {
+    LOG_INFO("HotRestart: spawn new process");
+    if (hot_restart_->Spawn(listen_fds_, SPAWN_TIMEOUT_MS)) {
+      Drain_();
+      return;
+    }
+    LOG_ERROR("HotRestart: new process not ready, keep serving");
   }
-  close(fd);
 }
 
-/*服务端正常关闭与某个client的连接*/
-void WebServer::CloseConn_(HttpConn* client) {
-  assert(client);
-  LOG_INFO("Client[%d, %s:%d] quit!", client->GetFd(),
-           ConvertIP(client->GetAddr().sin_addr.s_addr).c_str(),
-           client->GetAddr().sin_port);
-  epoller_->EpollRemove(client->GetFd());
-  client->Close();
+void WebServer::Drain_() {
+  LOG_INFO("HotRestart: new process ready, draining %d connections",
+           ConnCount_());
+  main_reactor_->Drain();
+  for (auto& reactor : sub_reactors_) {
+    reactor->Drain();
+  }
+  /* keep-alive连接在发送完当前响应后关闭, 空闲连接由超时定时器关闭 */
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(DRAIN_TIMEOUT_MS);
+  while (ConnCount_() > 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  LOG_INFO("HotRestart: drained, %d connections left, exit", ConnCount_());
+  main_reactor_->Stop();
 }
 
-/*服务端新增一个连接*/
-void WebServer::AddClient_(int fd, sockaddr_in addr) {
-  assert(fd > 0);
-  users_[fd].init(fd, addr);
-
-  if (timeout_ms_ > 0) {
-    /* 这里的bind用作断开连接的回调函数，比较有趣，传递参数时需要加上this */
-    timer_->AddItem(fd, timeout_ms_,
-                    std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+int WebServer::ConnCount_() const {
+  int cnt = main_reactor_->ConnCount();
+  for (auto& reactor : sub_reactors_) {
+    cnt += reactor->ConnCount();
   }
-
-  epoller_->EpollAdd(fd, EPOLLIN | conn_event_);
-  
-  /* 设置fd为非阻塞clientfd*/
-  SetFdNonblock(fd);
-
-  LOG_INFO("Client[%d, %s:%d] connected!", users_[fd].GetFd(),
-           ConvertIP(users_[fd].GetAddr().sin_addr.s_addr).c_str(),
-           users_[fd].GetAddr().sin_port);
+  return cnt;
 }
 
-void WebServer::DealListen_() {
-  struct sockaddr_in addr;       // 此处表示一个Internet socket address
-  socklen_t len = sizeof(addr);  // 获取地址长度，地址内存在padding
-  do {
-    /* 提取挂起队列的第一个连接请求，创建一个新的连接套接字并返回其fd */
-    int fd = accept(listen_fd_, (struct sockaddr*)&addr, &len);
-    if (fd <= 0) {
-      /* 错误返回, socket为nonblock，队列空则返回EWOULDBLOCK （EAGAIN 11） */
-      LOG_ERROR("%s: errno is: %d (%s)", "accept error", errno,
-                strerror(errno));
-      return;
-    } else if (HttpConn::userCount >= MAX_FD) {
-      /* 超出最大连接数 */
-      SendError_(fd, "Server busy!");
-      LOG_WARN("Clients is full!");
-      return;
+void WebServer::Dispatch_(int fd, const sockaddr_in& addr) {
+  assert(!sub_reactors_.empty());
+  size_t idx = 0;
+  if (dispatch_mode_ == LEAST_LOADED) {
+    for (size_t i = 1; i < sub_reactors_.size(); ++i) {
+      if (sub_reactors_[i]->ConnCount() < sub_reactors_[idx]->ConnCount()) {
+        idx = i;
+      }
     }
-    /* 正常fd则添加新的客户端信息 */
-    AddClient_(fd, addr);
-  } while (listen_event_ & EPOLLET);  // EPOLLET模式继续循环
-}
-
-void WebServer::DealRead_(HttpConn* client) {
-  assert(client);
-  ExtentTime_(client);
-  threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client));
-}
-
-void WebServer::DealWrite_(HttpConn* client) {
-  assert(client);
-  ExtentTime_(client);
-  threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
+  } else {
+    idx = next_reactor_;
+    next_reactor_ = (next_reactor_ + 1) % sub_reactors_.size();
+  }
+  sub_reactors_[idx]->QueueConn(fd, addr);
 }
 
-void WebServer::ExtentTime_(HttpConn* client) {
-  assert(client);
-  if (timeout_ms_ > 0) {
-    timer_->UpdateItem(client->GetFd(), timeout_ms_);
+/* 创建listenFd: SO_REUSEPORT模式下每个子Reactor各持有一个监听socket,
+   由内核在这些socket之间分摊新连接, 各子Reactor独立accept;
+   热重启拉起的新进程按顺序沿用旧进程的监听socket, 不足的部分再新建 */
+bool WebServer::InitSocket_() {
+  if (port_ > 65535 || port_ < 1024) {
+    LOG_ERROR("Port:%d error!", port_);
+    return false;
   }
-}
 
-void WebServer::OnRead_(HttpConn* client) {
-  assert(client);
-  int ret = -1;
-  int readErrno = 0;
-  ret = client->read(&readErrno);
-  if (ret <= 0 && readErrno != EAGAIN) {
-    CloseConn_(client);
-    return;
+  std::vector<int> inherited;
+  if (hot_restart_ && hot_restart_->TakeListenFds(&inherited)) {
+    inherited_fds_ = static_cast<int>(inherited.size());
   }
-  /* 先从clientfd读取报文，然后调用HttpConn::process处理请求/响应 */
-  OnProcess(client);
-}
 
-void WebServer::OnProcess(HttpConn* client) {
-  if (client->process()) {
-    epoller_->EpollModify(client->GetFd(), conn_event_ | EPOLLOUT);
+  std::vector<Reactor*> listeners;
+  Reactor::AcceptCallback dispatch = nullptr;
+  if (reuse_port_ && !sub_reactors_.empty()) {
+    for (auto& reactor : sub_reactors_) {
+      listeners.push_back(reactor.get());
+    }
   } else {
-    epoller_->EpollModify(client->GetFd(), conn_event_ | EPOLLIN);
+    listeners.push_back(main_reactor_.get());
+    /* 多Reactor模式下, 主Reactor只负责accept, 连接交给Dispatch_分发 */
+    if (!sub_reactors_.empty()) {
+      dispatch = std::bind(&WebServer::Dispatch_, this, std::placeholders::_1,
+                           std::placeholders::_2);
+    }
   }
-}
 
-void WebServer::OnWrite_(HttpConn* client) {
-  assert(client);
-  int ret = -1;
-  int writeErrno = 0;
-  ret = client->write(&writeErrno);
-  if (client->ToWriteBytes() == 0) {
-    /* 传输完成 */
-    if (client->IsKeepAlive()) {
-      OnProcess(client);
-      return;
+  for (size_t i = 0; i < listeners.size(); ++i) {
+    int fd = i < inherited.size() ? inherited[i] : CreateListenFd_();
+    if (fd < 0) {
+      return false;
     }
-  } else if (ret < 0) {
-    if (writeErrno == EAGAIN) {
-      /* 继续传输 */
-      epoller_->EpollModify(client->GetFd(), conn_event_ | EPOLLOUT);
-      return;
+    listen_fds_.push_back(fd);
+    if (!listeners[i]->AddListener(fd, listen_event_, dispatch)) {
+      LOG_ERROR("Add listen error!");
+      return false;
     }
   }
-  CloseConn_(client);
+  for (size_t i = listeners.size(); i < inherited.size(); ++i) {
+    /* 新配置的监听socket更少, 多余的由旧进程退出时一并关闭 */
+    close(inherited[i]);
+  }
+
+  LOG_INFO("Server port:%d", port_);
+
+  return true;
 }
 
-/* Create listenFd */
-bool WebServer::InitSocket_() {
+int WebServer::CreateListenFd_() {
   int ret;
   /* 监听socket的TCP/IP的IPV4 socket地址 */
   struct sockaddr_in addr;
   bzero(&addr, sizeof(addr));
 
-  if (port_ > 65535 || port_ < 1024) {
-    LOG_ERROR("Port:%d error!", port_);
-    return false;
-  }
   /* socket连接所属的协议族（默认IP protocol family）*/
   addr.sin_family = AF_INET;
   /* IP地址, INADDR_ANY：将套接字绑定到addr所有可用的接口 */
@@ -291,69 +428,81 @@ bool WebServer::InitSocket_() {
   }
 
   /* 创建监听socket文件描述符
-   * socket在AF_INET上创建SOCK_STREAM类型的socket,0表示协议自动选择*/
-  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-  if (listen_fd_ < 0) {
+   * socket在AF_INET上创建SOCK_STREAM类型的socket,0表示协议自动选择,
+   * 直接以非阻塞、close-on-exec方式创建, 无需再调用fcntl */
+  int listen_fd =
+      socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
     LOG_ERROR("Create socket error!", port_);
-    return false;
+    return -1;
   }
 
   /* SO_LINGER 允许端口被重复使用 */
-  ret = setsockopt(listen_fd_, SOL_SOCKET, SO_LINGER, &optLinger,
+  ret = setsockopt(listen_fd, SOL_SOCKET, SO_LINGER, &optLinger,
                    sizeof(optLinger));
   if (ret < 0) {
-    close(listen_fd_);
+    close(listen_fd);
     LOG_ERROR("Init linger error!", port_);
-    return false;
+    return -1;
   }
 
   int optval = 1;
   /* 端口复用 */
   /* 只有最后一个套接字会正常接收数据。 */
-  ret = setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval,
+  ret = setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, (const void*)&optval,
                    sizeof(int));
   if (ret == -1) {
     LOG_ERROR("set socket setsockopt error!");
-    close(listen_fd_);
-    return false;
+    close(listen_fd);
+    return -1;
+  }
+
+  /* SO_REUSEPORT: 多个socket绑定同一端口, 内核按四元组哈希分发新连接 */
+  if (reuse_port_) {
+    ret = setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT,
+                     (const void*)&optval, sizeof(int));
+    if (ret == -1) {
+      LOG_ERROR("set SO_REUSEPORT error!");
+      close(listen_fd);
+      return -1;
+    }
   }
 
   /* 绑定socket和它的地址addr */
-  ret = bind(listen_fd_, (struct sockaddr*)&addr, sizeof(addr));
+  ret = bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr));
   if (ret < 0) {
     LOG_ERROR("Bind Port:%d error!", port_);
-    close(listen_fd_);
-    return false;
+    close(listen_fd);
+    return -1;
   }
 
-  /* 在这些客户连接被accept()之前, 创建监听队列以存放待处理的客户连接 */
-  ret = listen(listen_fd_, 6);
-  if (ret < 0) {
-    LOG_ERROR("Listen port:%d error!", port_);
-    close(listen_fd_);
-    return false;
+  /* TCP_DEFER_ACCEPT: 客户端数据到达后才唤醒accept, 单位为秒 */
+  if (defer_accept_sec_ > 0) {
+    ret = setsockopt(listen_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                     &defer_accept_sec_, sizeof(defer_accept_sec_));
+    if (ret == -1) {
+      LOG_WARN("set TCP_DEFER_ACCEPT error!");
+    }
   }
 
-  ret = epoller_->EpollAdd(listen_fd_, listen_event_ | EPOLLIN);
-  if (ret == 0) {
-    LOG_ERROR("Add listen error!");
-    close(listen_fd_);
-    return false;
+  /* TCP_NODELAY(由accept得到的socket继承): 响应总是整批writev, Nagle算法
+     只会让流水线中后一批响应等待前一批的(延迟)ACK */
+  optval = 1;
+  ret = setsockopt(listen_fd, IPPROTO_TCP, TCP_NODELAY, &optval,
+                   sizeof(optval));
+  if (ret == -1) {
+    LOG_WARN("set TCP_NODELAY error!");
   }
 
-  /* 设置非阻塞listenfd*/
-  SetFdNonblock(listen_fd_);
-
-  LOG_INFO("Server port:%d", port_);
-
-  return true;
-}
+  /* 在这些客户连接被accept()之前, 创建监听队列以存放待处理的客户连接 */
+  ret = listen(listen_fd, backlog_);
+  if (ret < 0) {
+    LOG_ERROR("Listen port:%d error!", port_);
+    close(listen_fd);
+    return -1;
+  }
 
-int WebServer::SetFdNonblock(int fd) {
-  assert(fd > 0);
-  /* F_GETFD: 首先获取fd的flags,
-     F_SETFL: 然后将其设置为O_NONBLOCK */
-  return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
+  return listen_fd;
 }
 
 }  // namespace webserver
\ No newline at end of file
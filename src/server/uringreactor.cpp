@@ -0,0 +1,308 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-15
+ * @copyleft Apache 2.0
+ */
+
+#include "server/uringreactor.h"
+
+namespace webserver {
+
+UringReactor::UringReactor(int timeoutMS, ThreadPool* threadpool)
+    : Reactor(timeoutMS, threadpool),
+      users_(ConnTable_()),
+      ring_(new IoUring()),
+      accept_len_(sizeof(accept_addr_)),
+      wakeup_cnt_(0) {
+  assert(ring_->Valid());
+  PrepWakeup_();
+}
+
+bool UringReactor::Supported() {
+  IoUring ring(2);
+  return ring.Valid();
+}
+
+bool UringReactor::AddListener(int listenFd, uint32_t listenEvent,
+                               const AcceptCallback& cb) {
+  assert(listenFd > 0);
+  /* 完成模型下每个accept请求只返回一个连接, 与listenEvent无关 */
+  listen_fd_ = listenFd;
+  on_accept_ = cb;
+  PrepAccept_();
+  return true;
+}
+
+void UringReactor::Loop() {
+  int timeMS = -1;  // 无超时设置时阻塞直到有完成事件
+  io_uring_cqe cqe;
+  while (!closed_) {
+    if (timeout_ms_ > 0) {
+      timeMS = timer_->GetNextTick();
+    }
+
+    /* 一次io_uring_enter: 提交上一轮积累的全部SQE并等待完成事件 */
+    ring_->Submit(timeMS);
+    while (ring_->PeekCqe(&cqe)) {
+      HandleCqe_(cqe);
+    }
+  }
+}
+
+/* ---------------------- 私有方法 ---------------------- */
+
+/* 与EpollReactor相同, 所有Reactor共享同一张以fd为下标的连接表 */
+FdSlab<UringReactor::UringConn>* UringReactor::ConnTable_() {
+  static FdSlab<UringConn> table(MAX_FD);
+  return &table;
+}
+
+void UringReactor::PrepAccept_() {
+  accept_len_ = sizeof(accept_addr_);
+  ring_->PrepAccept(listen_fd_, (struct sockaddr*)&accept_addr_, &accept_len_,
+                    SOCK_NONBLOCK | SOCK_CLOEXEC, Tag_(listen_fd_, OP_ACCEPT));
+}
+
+void UringReactor::PrepWakeup_() {
+  ring_->PrepRead(wakeup_fd_, &wakeup_cnt_, sizeof(wakeup_cnt_),
+                  Tag_(wakeup_fd_, OP_WAKEUP));
+}
+
+void UringReactor::PrepRecv_(UringConn* client) {
+  int fd = client->conn.GetFd();
+  iovec iov = client->conn.ReadSpace(READ_SIZE);
+  client->op = OP_RECV;
+  ring_->PrepRecv(fd, iov.iov_base, iov.iov_len, Tag_(fd, OP_RECV));
+}
+
+void UringReactor::PrepWrite_(UringConn* client) {
+  int fd = client->conn.GetFd();
+  int iovCnt = 0;
+  const iovec* iov = client->conn.WriteIov(&iovCnt);
+  client->op = OP_WRITE;
+  ring_->PrepWritev(fd, iov, iovCnt, Tag_(fd, OP_WRITE));
+}
+
+void UringReactor::HandleCqe_(const io_uring_cqe& cqe) {
+  int fd = static_cast<int>(cqe.user_data >> 8);
+  int op = static_cast<int>(cqe.user_data & 0xff);
+  switch (op) {
+    case OP_ACCEPT:
+      OnAccept_(cqe.res);
+      return;
+    case OP_WAKEUP:
+      /* 其他线程投递了新连接、处理结果或要求退出 */
+      DoPendingTasks_();
+      PrepWakeup_();
+      return;
+    case OP_RECV:
+    case OP_WRITE:
+      break;
+    default:
+      /* close和cancel的结果无需处理 */
+      return;
+  }
+
+  UringConn* client = users_->Get(fd);
+  if (client->op != op) {
+    LOG_WARN("Stale completion, fd: %d, op: %d", fd, op);
+    return;
+  }
+  if (op == OP_RECV) {
+    OnRecv_(client, cqe.res);
+  } else {
+    OnWrite_(client, cqe.res);
+  }
+}
+
+/* 撤销进行中的accept请求, 其完成事件返回-ECANCELED后不再重新提交 */
+void UringReactor::RemoveListener_() {
+  if (listen_fd_ < 0) return;
+  ring_->PrepCancel(Tag_(listen_fd_, OP_ACCEPT), Tag_(listen_fd_, OP_CANCEL));
+  listen_fd_ = -1;
+}
+
+void UringReactor::OnAccept_(int res) {
+  if (res == -ECANCELED) {
+    return;
+  } else if (res < 0) {
+    LOG_ERROR("%s: errno is: %d (%s)", "accept error", -res, strerror(-res));
+  } else if (HttpConn::userCount >= MAX_FD || res >= MAX_FD) {
+    /* 超出最大连接数 */
+    SendError_(res, "Server busy!");
+    LOG_WARN("Clients is full!");
+  } else if (on_accept_) {
+    on_accept_(res, accept_addr_);
+  } else {
+    AddClient_(res, accept_addr_);
+  }
+  if (!closed_ && listen_fd_ >= 0) {
+    PrepAccept_();
+  }
+}
+
+/*服务端新增一个连接*/
+void UringReactor::AddClient_(int fd, sockaddr_in addr) {
+  assert(fd > 0);
+  UringConn* client = users_->Get(fd);
+  client->conn.init(fd, addr, false);  // io_uring没有sendfile, 只提交iovec
+  client->conn.SetCompletion([this, client]() {
+    RunInLoop([this, client]() { OnCompleted_(client); });
+  });
+  client->expired = false;
+  ++conn_count_;
+
+  if (timeout_ms_ > 0) {
+    timer_->AddItem(fd, timeout_ms_,
+                    std::bind(&UringReactor::Expire_, this, fd));
+  }
+  PrepRecv_(client);
+
+  LOG_INFO("Client[%d, %s:%d] connected!", fd,
+           ConvertIP(addr.sin_addr.s_addr).c_str(), addr.sin_port);
+}
+
+void UringReactor::OnRecv_(UringConn* client, int res) {
+  if (res == -EAGAIN || res == -EINTR) {
+    PrepRecv_(client);
+    return;
+  }
+  if (res <= 0 || client->expired) {
+    CloseConn_(client);
+    return;
+  }
+  client->conn.HasRead(res);
+  ExtentTime_(client);
+  Process_(client);
+}
+
+/* 与epoll后端一样, 报文解析与响应生成在线程池中完成 */
+void UringReactor::Process_(UringConn* client) {
+  if (inline_max_bytes_ > 0 && client->conn.IsInlineable()) {
+    /* 快速路径: 写请求总是由本线程提交, 响应大小不影响在哪个线程解析 */
+    client->conn.process(true);
+    OnProcessed_(client);
+    return;
+  }
+  client->op = OP_PROCESS;
+  bool admitted = threadpool_->TryAddTask([this, client]() {
+    client->conn.process();
+    RunInLoop([this, client]() { OnProcessed_(client); });
+  });
+  if (!admitted) {
+    /* 过载: 直接返回503, 不再进入线程池排队 */
+    SendBusy_(client->conn.GetFd());
+    CloseConn_(client);
+  }
+}
+
+/* 请求不完整时process不生成响应, 以待写字节数判断是否继续接收 */
+void UringReactor::OnProcessed_(UringConn* client) {
+  if (client->expired) {
+    CloseConn_(client);
+  } else if (client->conn.ToWriteBytes() > 0) {
+    PrepWrite_(client);
+  } else if (client->conn.IsPending()) {
+    Resume_(client);
+  } else {
+    PrepRecv_(client);
+  }
+}
+
+/* 连接在异步处理者完成前不会关闭; 之前的响应还在发送或process还没有
+   返回时, 由OnWrite_或OnProcessed_接着调用Resume_ */
+void UringReactor::OnCompleted_(UringConn* client) {
+  client->conn.Complete();
+  if (client->op != OP_PENDING) {
+    return;
+  }
+  if (client->expired) {
+    CloseConn_(client);
+    return;
+  }
+  ExtentTime_(client);
+  Resume_(client);
+}
+
+void UringReactor::Resume_(UringConn* client) {
+  if (client->conn.Resume()) {
+    PrepWrite_(client);
+  } else {
+    client->op = OP_PENDING;
+  }
+}
+
+void UringReactor::OnWrite_(UringConn* client, int res) {
+  if (res == -EAGAIN || res == -EINTR) {
+    PrepWrite_(client);
+    return;
+  }
+  if (res < 0 || client->expired) {
+    CloseConn_(client);
+    return;
+  }
+  client->conn.HasWritten(res);
+  ExtentTime_(client);
+  if (client->conn.ToWriteBytes() > 0) {
+    /* 继续传输 */
+    PrepWrite_(client);
+  } else if (client->conn.IsPending()) {
+    /* 流水线中还有请求在等待异步处理者 */
+    Resume_(client);
+  } else if (!client->conn.IsKeepAlive() || draining_) {
+    CloseConn_(client);
+  } else if (client->conn.ToReadBytes() > 0) {
+    /* 读缓冲区中还有未处理的请求 */
+    Process_(client);
+  } else {
+    PrepRecv_(client);
+  }
+}
+
+void UringReactor::ExtentTime_(UringConn* client) {
+  if (timeout_ms_ > 0) {
+    timer_->UpdateItem(client->conn.GetFd(), timeout_ms_);
+  }
+}
+
+/* 超时: 取消进行中的读写请求, 待其完成事件返回后再关闭连接 */
+void UringReactor::Expire_(int fd) {
+  UringConn* client = users_->Get(fd);
+  if (client->conn.IsClosed()) {
+    return;
+  }
+  if (client->conn.InHandler()) {
+    /* 等待异步处理者的连接不算空闲, 重新计时 */
+    timer_->AddItem(fd, timeout_ms_,
+                    std::bind(&UringReactor::Expire_, this, fd));
+    return;
+  }
+  client->expired = true;
+  if (client->op == OP_RECV || client->op == OP_WRITE) {
+    ring_->PrepCancel(Tag_(fd, client->op), Tag_(fd, OP_CANCEL));
+  }
+}
+
+/*服务端正常关闭与某个client的连接, close同样以SQE的方式批量提交*/
+void UringReactor::CloseConn_(UringConn* client) {
+  if (client->conn.InHandler()) {
+    /* 此时没有进行中的请求, 由OnCompleted_关闭 */
+    client->expired = true;
+    client->op = OP_PENDING;
+    return;
+  }
+  LOG_INFO("Client[%d, %s:%d] quit!", client->conn.GetFd(),
+           ConvertIP(client->conn.GetAddr().sin_addr.s_addr).c_str(),
+           client->conn.GetAddr().sin_port);
+  int fd = client->conn.Release();
+  client->op = OP_CLOSE;
+  if (fd < 0) {
+    return;
+  }
+  /* 连接只在本Reactor线程中关闭, 可以直接撤销其定时器 */
+  timer_->CancelItem(fd);
+  ring_->PrepClose(fd, Tag_(fd, OP_CLOSE));
+  --conn_count_;
+}
+
+}  // namespace webserver
@@ -0,0 +1,58 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-12
+ * @copyleft Apache 2.0
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "pool/threadpool.h"
+
+/* 2个工作线程, 每个任务耗时5ms, 处理能力约400个/秒。
+ * 依次以 2倍 -> 0.5倍 -> 4倍 处理能力提交任务, 观察并发上限的收缩与恢复,
+ * 以及被拒绝的任务数; 排队时延目标为20ms。 */
+
+std::atomic<int> done(0);
+
+void Work() {
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  ++done;
+}
+
+void Offer(webserver::ThreadPool& pool, const char* phase, int perSecond,
+           int seconds) {
+  const webserver::AdmissionLimiter* limiter = pool.Limiter();
+  auto interval = std::chrono::microseconds(1000000 / perSecond);
+  auto next = std::chrono::steady_clock::now();
+  int admitted = 0, rejected = 0;
+  for (int i = 1; i <= perSecond * seconds; ++i) {
+    if (pool.TryAddTask(Work)) {
+      ++admitted;
+    } else {
+      ++rejected;
+    }
+    next += interval;
+    std::this_thread::sleep_until(next);
+    if (i % (perSecond / 5) == 0) {
+      printf("%-6s offered=%4d/s limit=%3d inflight=%3d latency=%6.1fms "
+             "admitted=%5d rejected=%5d\n",
+             phase, perSecond, limiter->Limit(), limiter->InFlight(),
+             limiter->LatencyUs() / 1000.0, admitted, rejected);
+    }
+  }
+}
+
+int main() {
+  webserver::ThreadPool pool(2, 20);
+  printf("init limit=%d\n", pool.Limiter()->Limit());
+  Offer(pool, "2x", 800, 2);
+  Offer(pool, "0.5x", 200, 2);
+  Offer(pool, "4x", 1600, 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  printf("Test Admission Completed, done=%d, total rejected=%lu\n", done.load(),
+         (unsigned long)pool.Limiter()->Rejected());
+  return 0;
+}
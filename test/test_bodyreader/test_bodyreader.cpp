@@ -0,0 +1,143 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-15
+ * @copyleft Apache 2.0
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "http/bodyreader.h"
+#include "../test_check.h"
+
+using webserver::BodyReader;
+
+/* Content-Length与分块编码的请求体在任意位置被拆开时结果都相同,
+ * 以及分块格式错误、超过上限、Sink中止时的处理 */
+
+static const size_t LIMIT = 1024 * 1024;
+
+struct Result {
+  BodyReader::STATUS status;
+  std::string body;
+  size_t used;  // 全部Feed消费的字节数
+};
+
+/* 按每次step个字节送入, 像读缓冲区一样保留未消费的字节 */
+static Result Decode(const std::string& input, bool chunked, size_t step,
+                     size_t length = 0, size_t limit = LIMIT) {
+  Result result;
+  BodyReader reader;
+  BodyReader::Sink sink = [&result](const char* data, size_t len) {
+    result.body.append(data, len);
+    return true;
+  };
+  if (chunked) {
+    reader.InitChunked(limit, sink);
+  } else {
+    reader.InitLength(length, limit, sink);
+  }
+  result.status = BodyReader::INCOMPLETE;
+  result.used = 0;
+  size_t received = 0;
+  while (result.status == BodyReader::INCOMPLETE) {
+    if (received == input.size() && result.used == received) break;
+    received = std::min(input.size(), received + step);
+    size_t used = 0;
+    result.status = reader.Feed(input.data() + result.used,
+                                received - result.used, &used);
+    result.used += used;
+  }
+  return result;
+}
+
+static void TestLength() {
+  std::string body = "username=orion&password=123";
+  std::string input = body + "GET / HTTP/1.1\r\n\r\n";
+  for (size_t step = 1; step <= input.size(); ++step) {
+    Result r = Decode(input, false, step, body.size());
+    CHECK(r.status == BodyReader::COMPLETE);
+    CHECK(r.body == body && r.used == body.size());
+  }
+  CHECK(Decode(body.substr(0, 5), false, 100, body.size()).status ==
+        BodyReader::INCOMPLETE);
+  CHECK(Decode(input, false, 100, body.size(), body.size() - 1).status ==
+        BodyReader::TOO_LARGE);
+}
+
+static void TestChunked() {
+  std::string input =
+      "5\r\nhello\r\n"
+      "6;name=value\r\n world\r\n"
+      "A\r\n0123456789\r\n"
+      "0\r\n"
+      "Trailer: x\r\n"
+      "\r\n";
+  std::string next = "GET / HTTP/1.1\r\n\r\n";
+  for (size_t step = 1; step <= input.size() + next.size(); ++step) {
+    Result r = Decode(input + next, true, step);
+    CHECK(r.status == BodyReader::COMPLETE);
+    CHECK(r.body == "hello world0123456789" && r.used == input.size());
+  }
+  /* 单独的LF与大写的十六进制 */
+  Result r = Decode("1F\n" + std::string(31, 'x') + "\n0\n\n", true, 7);
+  CHECK(r.status == BodyReader::COMPLETE && r.body.size() == 31);
+  CHECK(Decode("0\r\n\r\n", true, 1).body.empty());
+}
+
+static void TestBadChunked() {
+  const char* cases[] = {
+      "x\r\n",
+      "\r\n",
+      "5\r\nhelloX\r\n",
+      "5\r\nhello\r\r",
+      "5 \r\nhello\r\n0\r\n\rX",
+  };
+  for (const char* c : cases) {
+    CHECK(Decode(c, true, 1).status == BodyReader::ERROR);
+  }
+  /* 扩展或trailer超长 */
+  std::string ext = "1;" + std::string(BodyReader::MAX_LINE + 1, 'e');
+  CHECK(Decode(ext, true, 64).status == BodyReader::ERROR);
+  std::string trailer = "0\r\nX: " + std::string(BodyReader::MAX_LINE, 't');
+  CHECK(Decode(trailer, true, 64).status == BodyReader::ERROR);
+
+  /* 块大小超过剩余额度, 以及溢出 */
+  CHECK(Decode("101\r\n", true, 1, 0, 256).status == BodyReader::TOO_LARGE);
+  CHECK(Decode("80\r\n" + std::string(128, 'a') + "\r\n81\r\n", true, 9, 0,
+               256).status == BodyReader::TOO_LARGE);
+  CHECK(Decode("ffffffffffffffffff\r\n", true, 1, 0, SIZE_MAX).status ==
+        BodyReader::TOO_LARGE);
+}
+
+/* Sink返回false时中止 */
+static void TestAbort() {
+  BodyReader reader;
+  size_t seen = 0;
+  reader.InitLength(100, LIMIT, [&seen](const char*, size_t len) {
+    seen += len;
+    return seen < 10;
+  });
+  std::string data(100, 'a');
+  size_t used = 0;
+  CHECK(reader.Feed(data.data(), 4, &used) == BodyReader::INCOMPLETE);
+  CHECK(reader.Feed(data.data() + 4, 96, &used) == BodyReader::ERROR);
+  CHECK(reader.Received() == 100 && used == 0);
+}
+
+int main() {
+  TestLength();
+  TestChunked();
+  TestBadChunked();
+  TestAbort();
+  if (failed) {
+    printf("Test BodyReader Failed: %d\n", failed);
+    return 1;
+  }
+  printf("Test BodyReader Completed\n");
+  return 0;
+}
@@ -16,7 +16,7 @@ int main() {
   std::string s2 = "wxyz";
   webserver::StringBuffer b2(2);
   b2.Append("ab");
-  buff.Append(s1, 4);
+  buff.Append(s1, 2);
   std::cout << "buffer capacity = " << buff.Capacity() << std::endl;
   std::cout << "buffer readable bytes = " << buff.ReadableBytes() << std::endl;
   std::cout << "pre writable bytes = " << buff.PreWritableBytes() << std::endl;
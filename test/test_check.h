@@ -0,0 +1,25 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-26
+ * @copyleft Apache 2.0
+ */
+
+#ifndef TEST_CHECK_H_
+#define TEST_CHECK_H_
+
+#include <stdio.h>
+
+/* 各单元测试共用的断言: 失败时打印位置并计数, 不中断测试,
+ * main最后根据failed决定返回值 */
+
+static int failed = 0;
+
+#define CHECK(cond)                                               \
+  do {                                                            \
+    if (!(cond)) {                                                \
+      printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond);    \
+      ++failed;                                                   \
+    }                                                             \
+  } while (0)
+
+#endif  // TEST_CHECK_H_
@@ -0,0 +1,164 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-10
+ * @copyleft Apache 2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "http/filecache.h"
+#include "../test_check.h"
+
+using webserver::FileCache;
+
+/* 命中返回同一个条目; 文件被替换后, 在重新确认间隔内仍返回旧条目,
+ * 之后返回新内容; 被淘汰/替换的旧条目在引用释放前映射保持有效;
+ * 分片满时淘汰最久未访问的条目 */
+
+static void WriteFile(const std::string& path, const std::string& content) {
+  /* 先写临时文件再rename, 与部署时替换文件的方式相同 */
+  std::string tmp = path + ".tmp";
+  FILE* fp = fopen(tmp.c_str(), "w");
+  fwrite(content.data(), 1, content.size(), fp);
+  fclose(fp);
+  rename(tmp.c_str(), path.c_str());
+}
+
+static size_t ShardOf(const std::string& path) {
+  return std::hash<std::string>()(path) % FileCache::SHARDS;
+}
+
+/* 与hot落在同一分片的冷文件遍历两遍分片容量, 期间hot不断被访问,
+   不会被淘汰; 最早访问的冷文件已被淘汰, 再次访问时重新加载 */
+static void TestEviction(FileCache* cache, const std::string& dir) {
+  std::string hot = dir + "/hot.html";
+  WriteFile(hot, "hot");
+  cache->Clear();
+  FileCache::EntryPtr hotEntry = cache->Get(hot);
+  std::vector<std::string> colds;
+  for (int i = 0; colds.size() < 2 * FileCache::MAX_ENTRIES; ++i) {
+    std::string cold = dir + "/cold" + std::to_string(i) + ".txt";
+    if (ShardOf(cold) == ShardOf(hot)) {
+      colds.push_back(cold);
+    }
+  }
+  FileCache::EntryPtr firstCold;
+  for (size_t i = 0; i < colds.size(); ++i) {
+    WriteFile(colds[i], "cold");
+    FileCache::EntryPtr entry = cache->Get(colds[i]);
+    CHECK(entry);
+    if (i == 0) {
+      firstCold = entry;
+    }
+    if (i % 8 == 0) {
+      CHECK(cache->Get(hot) == hotEntry);
+    }
+  }
+  CHECK(cache->Get(hot) == hotEntry);
+  CHECK(cache->Get(colds[0]) != firstCold);
+
+  cache->Clear();
+  for (const std::string& cold : colds) {
+    unlink(cold.c_str());
+  }
+  unlink(hot.c_str());
+}
+
+static std::string Content(const FileCache::EntryPtr& entry) {
+  return std::string(entry->data, entry->Size());
+}
+
+int main() {
+  char dir[] = "/tmp/test_filecache_XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  std::string path = std::string(dir) + "/index.html";
+  FileCache* cache = FileCache::Instance();
+
+  WriteFile(path, "version 1");
+  FileCache::EntryPtr first = cache->Get(path);
+  CHECK(first && Content(first) == "version 1");
+  CHECK(strcmp(first->mime, "text/html") == 0);
+  CHECK(first->fd < 0);  // 小文件只保留映射
+  CHECK(cache->Get(path) == first);
+
+  WriteFile(path, "version 2!");
+  CHECK(cache->Get(path) == first);
+  std::this_thread::sleep_for(
+      std::chrono::milliseconds(FileCache::REVALIDATE_MS + 100));
+  FileCache::EntryPtr second = cache->Get(path);
+  CHECK(second && second != first && Content(second) == "version 2!");
+  CHECK(second->etag != first->etag);  // 验证器随文件版本变化
+  CHECK(second->lastModified.size() == 29);  // "Sun, 06 Nov 1994 08:49:37 GMT"
+  CHECK(strcmp(second->cacheControl, "no-cache") == 0);
+  CHECK(Content(first) == "version 1");  // 旧映射仍然有效
+
+  /* 大文件保留fd供sendfile使用 */
+  std::string big = std::string(dir) + "/big.js";
+  WriteFile(big, std::string(FileCache::FD_MIN, 'x'));
+  FileCache::EntryPtr bigEntry = cache->Get(big);
+  CHECK(bigEntry && bigEntry->fd >= 0);
+  CHECK(strcmp(bigEntry->mime, "text/javascript") == 0);
+  CHECK(strcmp(bigEntry->cacheControl, "max-age=86400") == 0);
+
+  /* 更大的文件不整体映射, 只保留fd流式发送 */
+  std::string huge = std::string(dir) + "/huge.mp4";
+  WriteFile(huge, "");
+  CHECK(truncate(huge.c_str(), FileCache::STREAM_MIN) == 0);
+  FileCache::EntryPtr hugeEntry = cache->Get(huge);
+  CHECK(hugeEntry && hugeEntry->fd >= 0 && !hugeEntry->data);
+  CHECK(hugeEntry->Size() == FileCache::STREAM_MIN);
+
+  /* 空文件、目录、不存在的文件 */
+  std::string empty = std::string(dir) + "/empty.txt";
+  WriteFile(empty, "");
+  FileCache::EntryPtr emptyEntry = cache->Get(empty);
+  CHECK(emptyEntry && emptyEntry->Size() == 0 && !emptyEntry->data);
+  CHECK(!cache->Get(dir));
+  CHECK(!cache->Get(std::string(dir) + "/missing.html"));
+
+  /* 后缀查表不区分大小写, 只看最后一个'.'之后的部分 */
+  CHECK(strcmp(FileCache::MimeType("/images/a.GIF"), "image/gif") == 0);
+  CHECK(strcmp(FileCache::MimeType("/a.tar.gz"), "application/x-gzip") == 0);
+  CHECK(strcmp(FileCache::MimeType("/video/b.mp4"), "video/mp4") == 0);
+  CHECK(strcmp(FileCache::MimeType("/README"), "text/plain") == 0);
+  CHECK(strcmp(FileCache::MimeType("/v1.0/index"), "text/plain") == 0);
+  CHECK(strcmp(FileCache::MimeType("/a.htm"), "text/plain") == 0);
+  CHECK(strcmp(FileCache::CacheControl("/a.JPEG"), "max-age=604800") == 0);
+
+  TestEviction(cache, dir);
+
+  cache->Clear();
+  CHECK(Content(second) == "version 2!");
+  CHECK(cache->Get(path) != second);
+
+  first.reset();
+  second.reset();
+  bigEntry.reset();
+  hugeEntry.reset();
+  emptyEntry.reset();
+  cache->Clear();
+  unlink(path.c_str());
+  unlink(big.c_str());
+  unlink(huge.c_str());
+  unlink(empty.c_str());
+  rmdir(dir);
+
+  if (failed) {
+    printf("Test FileCache Failed: %d\n", failed);
+    return 1;
+  }
+  printf("Test FileCache Completed\n");
+  return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-17
+ * @copyleft Apache 2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "http/formdata.h"
+#include "../test_check.h"
+
+using webserver::FormData;
+using webserver::StringPiece;
+
+/* URL解码(含不完整的%转义), urlencoded字段拆分, 以及multipart/form-data
+ * 在任意位置被拆开送入时结果都相同、文件字段写入临时文件并在Reset时删除 */
+
+static std::string Decode(std::string s) {
+  s.resize(FormData::UrlDecode(&s[0], s.size()));
+  return s;
+}
+
+static std::string ReadAll(int fd) {
+  std::string data;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    data.append(buf, n);
+  }
+  return data;
+}
+
+static void TestUrlDecode() {
+  CHECK(Decode("a+b%20c") == "a b c");
+  CHECK(Decode("%E4%BD%A0%e5%a5%bd") == "\xE4\xBD\xA0\xE5\xA5\xBD");
+  CHECK(Decode("100%") == "100%");
+  CHECK(Decode("%4") == "%4");
+  CHECK(Decode("%zz%41") == "%zzA");
+  CHECK(Decode("%2B%25") == "+%");
+  /* 跨越SIMD块边界的长字符串 */
+  std::string plain(100, 'x');
+  CHECK(Decode(plain + "%41" + plain + "+") == plain + "A" + plain + " ");
+  CHECK(Decode("").empty());
+}
+
+static void TestUrlencoded() {
+  std::string body = "username=orion&password=a%26b%3Dc&&empty=&flag&x=1+2";
+  FormData form;
+  form.ParseUrlencoded(&body[0], body.size());
+  CHECK(form.Fields().size() == 5);
+  CHECK(form.Get("username") && form.Get("username")->value == "orion");
+  CHECK(form.Get("password") && form.Get("password")->value == "a&b=c");
+  CHECK(form.Get("empty") && form.Get("empty")->value.empty());
+  CHECK(form.Get("flag") && form.Get("flag")->value.empty());
+  CHECK(form.Get("x") && form.Get("x")->value == "1 2");
+  CHECK(form.Get("missing") == nullptr);
+  /* 字段直接指向请求体 */
+  CHECK(form.Get("username")->value.data() >= body.data() &&
+        form.Get("username")->value.data() < body.data() + body.size());
+}
+
+static void TestParam() {
+  StringPiece type = "multipart/form-data; charset=utf-8; boundary=\"a;b c\"";
+  CHECK(FormData::MediaType(type) == "multipart/form-data");
+  CHECK(FormData::Param(type, "boundary") == "a;b c");
+  CHECK(FormData::Param(type, "CHARSET") == "utf-8");
+  CHECK(FormData::Param(type, "name").data() == nullptr);
+  StringPiece disp = "form-data; name=\"file\"; filename=\"\"";
+  CHECK(FormData::Param(disp, "name") == "file");
+  CHECK(FormData::Param(disp, "filename").empty() &&
+        FormData::Param(disp, "filename").data() != nullptr);
+}
+
+static const char* TYPE = "multipart/form-data; boundary=XyZ";
+
+static std::string Multipart(const std::string& file) {
+  return "preamble\r\n"
+         "--XyZ\r\n"
+         "Content-Disposition: form-data; name=\"title\"\r\n"
+         "\r\n"
+         "hello\r\n--XyY world\r\n"
+         "--XyZ  \r\n"
+         "content-disposition: form-data; name=\"upload\"; "
+         "filename=\"a.bin\"\r\n"
+         "Content-Type: application/octet-stream\r\n"
+         "\r\n" +
+         file +
+         "\r\n--XyZ\r\n"
+         "Content-Disposition: form-data; name=\"empty\"\r\n"
+         "\r\n"
+         "\r\n--XyZ--\r\n"
+         "epilogue";
+}
+
+/* 按每次step个字节送入 */
+static bool Feed(FormData* form, std::string* arena, const std::string& body,
+                 size_t step, size_t limit = 1024) {
+  arena->clear();
+  if (!form->InitMultipart(TYPE, arena, limit, "/tmp")) {
+    return false;
+  }
+  for (size_t i = 0; i < body.size(); i += step) {
+    if (!form->Feed(body.data() + i, std::min(step, body.size() - i))) {
+      return false;
+    }
+  }
+  return form->Finish();
+}
+
+static void TestMultipart() {
+  /* 文件内容中有CR、LF和分隔符的前缀 */
+  std::string file("\r\n--Xy\r\r\n--X\0\xff", 14);
+  file += std::string(300, 'f') + "\r\n--XyX";
+  std::string body = Multipart(file);
+  for (size_t step = 1; step <= body.size(); ++step) {
+    FormData form;
+    std::string arena;
+    CHECK(Feed(&form, &arena, body, step));
+    if (form.Fields().size() != 3) {
+      CHECK(form.Fields().size() == 3);
+      continue;
+    }
+    const FormData::Field* title = form.Get("title");
+    CHECK(title && title->value == "hello\r\n--XyY world" && title->fd < 0);
+    const FormData::Field* upload = form.Get("upload");
+    CHECK(upload && upload->fd >= 0 && upload->filename == "a.bin");
+    CHECK(upload->contentType == "application/octet-stream");
+    CHECK(upload->size == file.size() && ReadAll(upload->fd) == file);
+    std::string path = upload->path.ToString();
+    CHECK(access(path.c_str(), F_OK) == 0);
+    CHECK(form.Get("empty") && form.Get("empty")->value.empty());
+    form.Reset();
+    CHECK(access(path.c_str(), F_OK) != 0);
+  }
+}
+
+static void TestBadMultipart() {
+  FormData form;
+  std::string arena;
+  CHECK(!form.InitMultipart("multipart/form-data", &arena, 1024, "/tmp"));
+  CHECK(!form.InitMultipart(
+      "multipart/form-data; boundary=" + std::string(71, 'b'), &arena, 1024,
+      "/tmp"));
+
+  /* 没有结束分隔符 */
+  std::string body = Multipart("data");
+  CHECK(!Feed(&form, &arena, body.substr(0, body.size() - 14), 7));
+  /* 分隔符后既不是CRLF也不是"--" */
+  CHECK(!Feed(&form, &arena, "--XyZx\r\n", 3));
+  /* 缺少name */
+  CHECK(!Feed(&form, &arena,
+              "--XyZ\r\nContent-Disposition: form-data\r\n\r\nv\r\n--XyZ--",
+              5));
+  /* 分段头部过长 */
+  std::string head = "--XyZ\r\nX: " + std::string(FormData::MAX_PART_HEAD, 'h');
+  CHECK(!Feed(&form, &arena, head, 1000));
+  /* 普通字段超过上限, 文件字段不受限制 */
+  CHECK(!Feed(&form, &arena, body, 16, 10) && form.TooLarge());
+  CHECK(Feed(&form, &arena, Multipart(std::string(4096, 'f')), 512, 128));
+  CHECK(!form.TooLarge());
+  form.Reset();
+}
+
+int main() {
+  TestUrlDecode();
+  TestUrlencoded();
+  TestParam();
+  TestMultipart();
+  TestBadMultipart();
+  if (failed) {
+    printf("Test FormData Failed: %d\n", failed);
+    return 1;
+  }
+  printf("Test FormData Completed\n");
+  return 0;
+}
@@ -0,0 +1,294 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-11-26
+ * @copyleft Apache 2.0
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <regex>
+#include <string>
+#include <unordered_map>
+
+#include "http/httpparser.h"
+#include "http/httpscanner.h"
+#include "../test_check.h"
+
+using webserver::HttpParser;
+using webserver::HttpScanner;
+using webserver::StringPiece;
+
+/* 先检查增量解析的正确性以及各级SIMD扫描与逐字节实现的一致性,
+ * 再对比原先基于std::regex的逐行解析:
+ * legacy  每行拷贝成std::string, 每行构造一次std::regex, 头部存入哈希表
+ * parser  HttpParser一次扫描, 结果是指向缓冲区的StringPiece,
+ *         分别使用scalar/SSSE3/AVX2扫描, 另测一个带4KB Cookie的请求 */
+
+static const char BROWSER_REQUEST[] =
+    "GET /picture.html HTTP/1.1\r\n"
+    "Host: 127.0.0.1:1317\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+    "(KHTML, like Gecko) Chrome/107.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,"
+    "image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "\r\n";
+
+static const char POST_REQUEST[] =
+    "POST /login HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 27\r\n"
+    "\r\n"
+    "username=orion&password=123";
+
+static void TestComplete() {
+  HttpParser parser;
+  std::string req(BROWSER_REQUEST);
+  CHECK(parser.Parse(req.data(), req.size()) == HttpParser::COMPLETE);
+  CHECK(parser.Consumed() == req.size());
+  CHECK(parser.Method() == "GET");
+  CHECK(parser.Target() == "/picture.html");
+  CHECK(parser.Version() == "1.1");
+  CHECK(parser.HeaderCount() == 8);
+  CHECK(parser.GetHeader("host") == "127.0.0.1:1317");
+  CHECK(parser.GetHeader("ACCEPT-ENCODING") == "gzip, deflate, br");
+  CHECK(parser.GetHeader("Cookie").empty());
+  CHECK(parser.IsKeepAlive());
+}
+
+/* 逐字节送入, 每次都换一块新的内存, 检查断点续扫且不依赖缓冲区地址;
+ * 解析器在头部结束时即完成, 请求体由BodyReader读取 */
+static void TestIncremental() {
+  std::string req(POST_REQUEST);
+  size_t headLen = req.size() - 27;
+  HttpParser parser;
+  HttpParser::STATUS status = HttpParser::INCOMPLETE;
+  std::string buff;
+  for (size_t i = 1; i <= headLen; ++i) {
+    buff = std::string(req.data(), i);
+    status = parser.Parse(buff.data(), buff.size());
+    if (i < headLen) CHECK(status == HttpParser::INCOMPLETE);
+  }
+  CHECK(status == HttpParser::COMPLETE);
+  CHECK(parser.Consumed() == headLen);
+  CHECK(parser.Method() == "POST");
+  CHECK(parser.HasBody() && !parser.IsChunked());
+  CHECK(parser.ContentLength() == 27);
+  CHECK(parser.GetHeader("Content-Type") ==
+        "application/x-www-form-urlencoded");
+}
+
+/* 一次收到多个流水线请求, 依次解析 */
+static void TestPipeline() {
+  std::string buff = std::string(POST_REQUEST) + BROWSER_REQUEST +
+                     "GET / HTTP/1.0\r\n\r\n" + "GET /x HT";
+  const char* data = buff.data();
+  size_t left = buff.size();
+  HttpParser parser;
+  const char* targets[] = {"/login", "/picture.html", "/"};
+  for (const char* target : targets) {
+    parser.Reset();
+    CHECK(parser.Parse(data, left) == HttpParser::COMPLETE);
+    CHECK(parser.Target() == target);
+    /* 跳过请求体 */
+    data += parser.Consumed() + parser.ContentLength();
+    left -= parser.Consumed() + parser.ContentLength();
+  }
+  CHECK(!parser.IsKeepAlive());  // HTTP/1.0默认不保持连接
+  parser.Reset();
+  CHECK(parser.Parse(data, left) == HttpParser::INCOMPLETE);
+}
+
+static void TestKeepAlive() {
+  const char* cases[][2] = {
+      {"GET / HTTP/1.1\r\n\r\n", "1"},
+      {"GET / HTTP/1.1\r\nConnection: close\r\n\r\n", "0"},
+      {"GET / HTTP/1.0\r\n\r\n", "0"},
+      {"GET / HTTP/1.0\r\nconnection: Keep-Alive\r\n\r\n", "1"},
+  };
+  for (auto& c : cases) {
+    HttpParser parser;
+    CHECK(parser.Parse(c[0], strlen(c[0])) == HttpParser::COMPLETE);
+    CHECK(parser.IsKeepAlive() == (c[1][0] == '1'));
+  }
+}
+
+static void TestChunked() {
+  const char req[] =
+      "POST /upload HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n4\r\n";
+  HttpParser parser;
+  CHECK(parser.Parse(req, strlen(req)) == HttpParser::COMPLETE);
+  CHECK(parser.IsChunked() && parser.HasBody());
+  CHECK(parser.Consumed() == strlen(req) - 3);
+
+  const char get[] = "GET / HTTP/1.1\r\nContent-Length: 0\r\n\r\n";
+  parser.Reset();
+  CHECK(parser.Parse(get, strlen(get)) == HttpParser::COMPLETE);
+  CHECK(!parser.HasBody());
+}
+
+static void TestBadRequest() {
+  const char* cases[] = {
+      "GET/ HTTP/1.1\r\n\r\n",
+      "GET / FTP/1.1\r\n\r\n",
+      "G(T / HTTP/1.1\r\n\r\n",
+      "GET / HTTP/1.1\r\nBad Header: x\r\n\r\n",
+      "GET / HTTP/1.1\r\nNoColon\r\n\r\n",
+      "GET / HTTP/1.1\r\nX: a\x01b\r\n\r\n",
+      "GET / HTTP/1.1\r\nX: a\rb\r\n\r\n",
+      "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+      "POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n",
+      "POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n",
+      "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+      "Transfer-Encoding: chunked\r\n\r\n",
+      "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+      "Content-Length: 3\r\n\r\n",
+      "POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n",
+      "GET /../etc/passwd HTTP/1.1\r\n\r\n",
+      "GET /a/.. HTTP/1.1\r\n\r\n",
+      "GET /a/%2E%2e/b HTTP/1.1\r\n\r\n",
+      "GET ../x HTTP/1.1\r\n\r\n",
+  };
+  for (const char* c : cases) {
+    HttpParser parser;
+    CHECK(parser.Parse(c, strlen(c)) == HttpParser::ERROR);
+  }
+  /* 头部超长且一直不完整 */
+  std::string huge = "GET / HTTP/1.1\r\nX: " +
+                     std::string(HttpParser::MAX_HEAD_SIZE, 'a');
+  HttpParser parser;
+  CHECK(parser.Parse(huge.data(), huge.size()) == HttpParser::ERROR);
+}
+
+/* 随机内容、随机起止位置, 所有级别的结果必须与逐字节实现一致 */
+static void TestScanner() {
+  std::mt19937 rng(2022);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> pos(0, 200);
+  std::string buff(256, 0);
+  for (int round = 0; round < 20000; ++round) {
+    /* 大多数字节取自合法字符, 使停止字符出现在不同的偏移上 */
+    for (char& ch : buff) {
+      int b = byte(rng);
+      ch = (b < 240) ? "abcXYZ09-%+:\"/ \t"[b % 16] : static_cast<char>(b);
+    }
+    const char* begin = buff.data() + pos(rng) / 4;
+    const char* end = begin + pos(rng);
+    const char* expected[5];
+    HttpScanner::Use(HttpScanner::SCALAR);
+    expected[0] = HttpScanner::FindTokenEnd(begin, end);
+    expected[1] = HttpScanner::FindTargetEnd(begin, end);
+    expected[2] = HttpScanner::FindValueEnd(begin, end);
+    expected[3] = HttpScanner::FindFormEscape(begin, end);
+    expected[4] = HttpScanner::FindJsonStop(begin, end);
+    for (int level = HttpScanner::SSSE3; level <= HttpScanner::AVX2; ++level) {
+      HttpScanner::Use(static_cast<HttpScanner::LEVEL>(level));
+      CHECK(HttpScanner::FindTokenEnd(begin, end) == expected[0]);
+      CHECK(HttpScanner::FindTargetEnd(begin, end) == expected[1]);
+      CHECK(HttpScanner::FindValueEnd(begin, end) == expected[2]);
+      CHECK(HttpScanner::FindFormEscape(begin, end) == expected[3]);
+      CHECK(HttpScanner::FindJsonStop(begin, end) == expected[4]);
+    }
+  }
+  HttpScanner::Use(HttpScanner::AVX2);
+}
+
+/* ---------------------- 基准测试 ---------------------- */
+
+/* 与原HttpRequest::parse相同的做法 */
+static bool LegacyParse(const std::string& req,
+                        std::unordered_map<std::string, std::string>* header,
+                        std::string* method, std::string* path) {
+  const char CRLF[] = "\r\n";
+  const char* begin = req.data();
+  const char* end = req.data() + req.size();
+  bool requestLine = true;
+  while (begin < end) {
+    const char* lineEnd = std::search(begin, end, CRLF, CRLF + 2);
+    std::string line(begin, lineEnd);
+    if (requestLine) {
+      std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+      std::smatch subMatch;
+      if (!std::regex_match(line, subMatch, patten)) return false;
+      *method = subMatch[1];
+      *path = subMatch[2];
+      requestLine = false;
+    } else {
+      std::regex patten("^([^:]*): ?(.*)$");
+      std::smatch subMatch;
+      if (!std::regex_match(line, subMatch, patten)) break;
+      (*header)[subMatch[1]] = subMatch[2];
+    }
+    if (lineEnd == end) break;
+    begin = lineEnd + 2;
+  }
+  return true;
+}
+
+static double Now() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static double ParserNs(const std::string& req, int rounds) {
+  HttpParser parser;
+  size_t check = 0;
+  double begin = Now();
+  for (int i = 0; i < rounds; ++i) {
+    parser.Reset();
+    parser.Parse(req.data(), req.size());
+    check += parser.HeaderCount();
+  }
+  double ns = (Now() - begin) / rounds;
+  return check ? ns : 0;
+}
+
+static void Bench(int n) {
+  std::string req(BROWSER_REQUEST);
+  std::string heavy = req;
+  heavy.insert(heavy.size() - 2,
+               "Cookie: session=" + std::string(4096, 'x') + "\r\n");
+
+  double begin = Now();
+  for (int i = 0; i < n; ++i) {
+    std::unordered_map<std::string, std::string> header;
+    std::string method, path;
+    LegacyParse(req, &header, &method, &path);
+  }
+  double legacyNs = (Now() - begin) / n;
+  printf("%-16s %10.1f ns/req\n", "legacy", legacyNs);
+
+  printf("%-16s %10s %10s\n", "parser", "browser", "4KB cookie");
+  for (int level = HttpScanner::SCALAR; level <= HttpScanner::AVX2; ++level) {
+    if (HttpScanner::Use(static_cast<HttpScanner::LEVEL>(level)) != level) {
+      continue;  // CPU不支持
+    }
+    printf("%-16s %10.1f %10.1f ns/req\n", HttpScanner::LevelName(),
+           ParserNs(req, n * 100), ParserNs(heavy, n * 10));
+  }
+}
+
+int main() {
+  TestComplete();
+  TestIncremental();
+  TestPipeline();
+  TestKeepAlive();
+  TestChunked();
+  TestBadRequest();
+  TestScanner();
+  if (failed) {
+    printf("Test HttpParser Failed: %d\n", failed);
+    return 1;
+  }
+  printf("Test HttpParser Completed\n");
+  Bench(20000);
+  return 0;
+}
@@ -0,0 +1,286 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-14
+ * @copyleft Apache 2.0
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "http/httpresponse.h"
+#include "../test_check.h"
+
+using webserver::Compressor;
+using webserver::HttpResponse;
+using webserver::StringBuffer;
+
+/* Accept-Encoding协商: q值、*、x-gzip、q=0排除与br优先;
+ * 条件请求: If-None-Match列表、*、弱比较、编码后缀, If-Modified-Since
+ * 及其被忽略的情况, 304没有内容;
+ * Range请求: 单个范围、后缀范围、多段响应、合并、416, 以及语法错误、
+ * If-Range不匹配时按整个文件回复 */
+
+struct Reply {
+  int code;
+  std::string head;
+  std::string body;
+};
+
+/* 按输出链的方式拼出响应: 响应头之后依次是各个内容段 */
+static Reply Collect(HttpResponse& response, StringBuffer& buff) {
+  response.MakeResponse(buff);
+  Reply reply;
+  reply.code = response.Code();
+  const char* base = buff.ReadBeginPtr();
+  reply.head.assign(base, response.HeadLen());
+  for (const HttpResponse::Segment& seg : response.Segments()) {
+    if (seg.data) {
+      reply.body.append(seg.data, seg.len);
+    } else {
+      reply.body.append(base + seg.off, seg.len);
+    }
+  }
+  return reply;
+}
+
+static Reply Fetch(const std::string& dir, std::string path,
+                   const std::string& range,
+                   const std::string& ifRange = "") {
+  HttpResponse response;
+  StringBuffer buff;
+  response.Init(dir, path, true, 200);
+  response.SetRange(range, ifRange);
+  return Collect(response, buff);
+}
+
+static Reply Conditional(
+    const std::string& dir, std::string path, const std::string& ifNoneMatch,
+    const std::string& ifModifiedSince,
+    Compressor::ENCODING encoding = Compressor::IDENTITY) {
+  HttpResponse response;
+  StringBuffer buff;
+  response.Init(dir, path, true, 200, encoding);
+  response.SetConditional(ifNoneMatch, ifModifiedSince);
+  return Collect(response, buff);
+}
+
+/* 响应头中name的值 */
+static std::string Header(const Reply& reply, const std::string& name) {
+  size_t pos = reply.head.find("\r\n" + name + ": ");
+  if (pos == std::string::npos) {
+    return "";
+  }
+  pos += name.size() + 4;
+  return reply.head.substr(pos, reply.head.find("\r\n", pos) - pos);
+}
+
+static bool HasHeader(const Reply& reply, const std::string& line) {
+  return reply.head.find(line + "\r\n") != std::string::npos;
+}
+
+/* 未编译brotli时br不会被选中 */
+static void TestNegotiate() {
+  static const struct {
+    const char* accept;
+    Compressor::ENCODING expected;
+    Compressor::ENCODING withBrotli;
+  } CASES[] = {
+      {"", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"identity", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"deflate", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"gzip", Compressor::GZIP, Compressor::GZIP},
+      {"GZIP", Compressor::GZIP, Compressor::GZIP},
+      {"x-gzip", Compressor::GZIP, Compressor::GZIP},
+      {"br", Compressor::IDENTITY, Compressor::BROTLI},
+      /* q值相同时优先br */
+      {"gzip, deflate, br", Compressor::GZIP, Compressor::BROTLI},
+      {"br;q=0.8, gzip;q=0.8", Compressor::GZIP, Compressor::BROTLI},
+      {"gzip;q=1.0, br;q=0.5", Compressor::GZIP, Compressor::GZIP},
+      {"gzip;q=0.5, br;q=0.1", Compressor::GZIP, Compressor::GZIP},
+      {"gzip; Q=0.001", Compressor::GZIP, Compressor::GZIP},
+      {"gzip;level=1", Compressor::GZIP, Compressor::GZIP},
+      /* q=0表示不接受 */
+      {"gzip;q=0", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"gzip;q=0.000, br;q=0", Compressor::IDENTITY, Compressor::IDENTITY},
+      /* 未列出的编码按*的q值处理 */
+      {"*", Compressor::GZIP, Compressor::BROTLI},
+      {"*;q=0.5, gzip;q=0", Compressor::IDENTITY, Compressor::BROTLI},
+      {"br;q=0.5, *;q=0.9", Compressor::GZIP, Compressor::GZIP},
+      {"*;q=0", Compressor::IDENTITY, Compressor::IDENTITY},
+      /* 不合法的q值按0处理 */
+      {"gzip;q=05", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"gzip;q=15", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"gzip;q=", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"gzip;q=2", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"gzip;q=1.5", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"gzip;q=0.5x", Compressor::IDENTITY, Compressor::IDENTITY},
+      {"gzip;q=0.1234", Compressor::IDENTITY, Compressor::IDENTITY},
+  };
+  for (const auto& c : CASES) {
+#ifdef WEBSERVER_BROTLI
+    Compressor::ENCODING expected = c.withBrotli;
+#else
+    Compressor::ENCODING expected = c.expected;
+#endif
+    if (Compressor::Negotiate(c.accept) != expected) {
+      printf("Accept-Encoding: %s\n", c.accept);
+      CHECK(Compressor::Negotiate(c.accept) == expected);
+    }
+  }
+}
+
+/* 304只有响应头, 仍带着验证器 */
+static void CheckNotModified(const Reply& reply, const std::string& etag) {
+  CHECK(reply.code == 304);
+  CHECK(reply.body.empty());
+  CHECK(Header(reply, "ETag") == etag);
+  CHECK(Header(reply, "Content-length").empty());
+  CHECK(reply.head.compare(reply.head.size() - 4, 4, "\r\n\r\n") == 0);
+}
+
+static void TestConditional(const std::string& dir) {
+  std::string page(1000, 'p');
+  std::string path = dir + "/page.html";
+  FILE* fp = fopen(path.c_str(), "w");
+  fwrite(page.data(), 1, page.size(), fp);
+  fclose(fp);
+
+  Reply plain = Conditional(dir, "/page.html", "", "");
+  CHECK(plain.code == 200 && plain.body == page);
+  std::string etag = Header(plain, "ETag");
+  std::string lastModified = Header(plain, "Last-Modified");
+  CHECK(etag.size() > 2 && etag[0] == '"');
+  CHECK(!lastModified.empty());
+  /* 压缩后的表示有自己的强ETag */
+  Reply gzip = Conditional(dir, "/page.html", "", "", Compressor::GZIP);
+  CHECK(gzip.code == 200 && Header(gzip, "Content-Encoding") == "gzip");
+  std::string gzipTag = etag.substr(0, etag.size() - 1) + "-gzip\"";
+  CHECK(Header(gzip, "ETag") == gzipTag);
+
+  /* If-None-Match: 单个、列表、*、弱比较 */
+  CheckNotModified(Conditional(dir, "/page.html", etag, ""), etag);
+  CheckNotModified(
+      Conditional(dir, "/page.html", "\"other\" , " + etag + ", \"x\"", ""),
+      etag);
+  CheckNotModified(Conditional(dir, "/page.html", "*", ""), etag);
+  CheckNotModified(Conditional(dir, "/page.html", "W/" + etag, ""), etag);
+  CHECK(Conditional(dir, "/page.html", "\"other\"", "").code == 200);
+  CHECK(Conditional(dir, "/page.html", "W/\"other\"", "").code == 200);
+  CHECK(Conditional(dir, "/page.html", etag.substr(1), "").code == 200);
+
+  /* 编码后缀: 同一文件的不同编码互不匹配 */
+  CheckNotModified(
+      Conditional(dir, "/page.html", gzipTag, "", Compressor::GZIP), gzipTag);
+  CHECK(Conditional(dir, "/page.html", etag, "", Compressor::GZIP).code ==
+        200);
+  CHECK(Conditional(dir, "/page.html", gzipTag, "").code == 200);
+  std::string brTag = etag.substr(0, etag.size() - 1) + "-br\"";
+  CHECK(Conditional(dir, "/page.html", brTag, "", Compressor::GZIP).code ==
+        200);
+
+  /* If-Modified-Since */
+  CheckNotModified(Conditional(dir, "/page.html", "", lastModified), etag);
+  CHECK(Conditional(dir, "/page.html", "", "Thu, 01 Jan 1970 00:00:00 GMT")
+            .code == 200);
+  CHECK(Conditional(dir, "/page.html", "", "yesterday").code == 200);
+  CHECK(Conditional(dir, "/page.html", "", lastModified + " junk").code ==
+        200);
+  /* 有If-None-Match时忽略If-Modified-Since */
+  CHECK(Conditional(dir, "/page.html", "\"other\"", lastModified).code ==
+        200);
+
+  /* 不存在的文件不会以304回复 */
+  CHECK(Conditional(dir, "/missing.html", "*", "").code == 404);
+
+  unlink(path.c_str());
+}
+
+int main() {
+  TestNegotiate();
+
+  char dir[] = "/tmp/test_httpresponse_XXXXXX";
+  if (!mkdtemp(dir)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  std::string content;
+  for (int i = 0; i < 1000; ++i) {
+    content += static_cast<char>('a' + i % 26);
+  }
+  std::string path = std::string(dir) + "/video.mp4";
+  FILE* fp = fopen(path.c_str(), "w");
+  fwrite(content.data(), 1, content.size(), fp);
+  fclose(fp);
+
+  Reply full = Fetch(dir, "/video.mp4", "");
+  CHECK(full.code == 200 && full.body == content);
+  CHECK(HasHeader(full, "Accept-Ranges: bytes"));
+  /* Date行紧跟在状态行之后, 长度固定 */
+  CHECK(full.head.compare(HttpResponse::DateOffset(200), 6, "Date: ") == 0);
+  CHECK(full.head.compare(HttpResponse::DateOffset(200) +
+                              HttpResponse::DATE_LINE_LEN - 5,
+                          5, "GMT\r\n") == 0);
+
+  Reply single = Fetch(dir, "/video.mp4", "bytes=10-19");
+  CHECK(single.code == 206 && single.body == content.substr(10, 10));
+  CHECK(HasHeader(single, "Content-Range: bytes 10-19/1000"));
+  CHECK(HasHeader(single, "Content-length: 10"));
+
+  Reply open = Fetch(dir, "/video.mp4", "bytes=990-");
+  CHECK(open.code == 206 && open.body == content.substr(990));
+  Reply suffix = Fetch(dir, "/video.mp4", "bytes=-5");
+  CHECK(suffix.code == 206 && suffix.body == content.substr(995));
+  Reply clipped = Fetch(dir, "/video.mp4", "bytes=998-5000");
+  CHECK(clipped.code == 206 && clipped.body == content.substr(998));
+
+  /* 重叠的范围合并成一段 */
+  Reply merged = Fetch(dir, "/video.mp4", "bytes=0-9, 5-20");
+  CHECK(merged.code == 206);
+  CHECK(HasHeader(merged, "Content-Range: bytes 0-20/1000"));
+
+  Reply multi = Fetch(dir, "/video.mp4", "bytes=0-1,100-102");
+  CHECK(multi.code == 206);
+  CHECK(multi.head.find("multipart/byteranges; boundary=") !=
+        std::string::npos);
+  CHECK(HasHeader(multi, "Content-length: " +
+                             std::to_string(multi.body.size())));
+  CHECK(multi.body.find("Content-Range: bytes 0-1/1000\r\n\r\nab\r\n") !=
+        std::string::npos);
+  CHECK(multi.body.find("Content-Range: bytes 100-102/1000\r\n\r\nwxy\r\n") !=
+        std::string::npos);
+  CHECK(multi.body.compare(multi.body.size() - 4, 4, "--\r\n") == 0);
+
+  Reply unsatisfiable = Fetch(dir, "/video.mp4", "bytes=1000-");
+  CHECK(unsatisfiable.code == 416 && unsatisfiable.body.empty());
+  CHECK(HasHeader(unsatisfiable, "Content-Range: bytes */1000"));
+
+  /* 无法理解的Range按没有Range处理 */
+  CHECK(Fetch(dir, "/video.mp4", "bytes=5-2").code == 200);
+  CHECK(Fetch(dir, "/video.mp4", "items=0-1").code == 200);
+  std::string many = "bytes=";
+  for (size_t i = 0; i <= HttpResponse::MAX_RANGES; ++i) {
+    many += std::to_string(i * 10) + "-" + std::to_string(i * 10 + 1) + ",";
+  }
+  CHECK(Fetch(dir, "/video.mp4", many).code == 200);
+
+  /* If-Range */
+  std::string etag = full.head.substr(full.head.find("ETag: ") + 6);
+  etag = etag.substr(0, etag.find("\r\n"));
+  CHECK(Fetch(dir, "/video.mp4", "bytes=0-1", etag).code == 206);
+  CHECK(Fetch(dir, "/video.mp4", "bytes=0-1", "\"stale\"").code == 200);
+
+  TestConditional(dir);
+
+  webserver::FileCache::Instance()->Clear();
+  unlink(path.c_str());
+  rmdir(dir);
+
+  if (failed) {
+    printf("Test HttpResponse Failed: %d\n", failed);
+    return 1;
+  }
+  printf("Test HttpResponse Completed\n");
+  return 0;
+}
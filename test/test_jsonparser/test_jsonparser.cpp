@@ -0,0 +1,120 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-17
+ * @copyleft Apache 2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "http/jsonparser.h"
+#include "../test_check.h"
+
+using webserver::JsonParser;
+
+/* token的顺序与size/next, 字符串原地去转义(含代理对), 数字与字面量的
+ * 语法, 以及各种格式错误与嵌套深度上限 */
+
+static bool Parse(JsonParser* json, std::string* text) {
+  return json->Parse(&(*text)[0], text->size());
+}
+
+static bool Valid(std::string text) {
+  JsonParser json;
+  return Parse(&json, &text);
+}
+
+static void TestTokens() {
+  std::string text =
+      " {\"a\": [1, 2], \"b\" :true, \"c\": {\"d\": null}, \"e\": \"x\"} ";
+  JsonParser json;
+  CHECK(Parse(&json, &text));
+  CHECK(json.Count() == 13);
+  CHECK(json[0].type == JsonParser::OBJECT && json[0].size == 4);
+  CHECK(json[0].next == 13 && json[0].text.size() == text.size() - 2);
+  CHECK(json[2].type == JsonParser::ARRAY && json[2].size == 2);
+  CHECK(json[2].text == "[1, 2]" && json[2].next == 5);
+  CHECK(json[3].type == JsonParser::NUMBER && json[3].text == "1");
+  CHECK(json[6].type == JsonParser::BOOLEAN && json[6].text == "true");
+  CHECK(json[8].type == JsonParser::OBJECT && json[8].size == 1);
+  CHECK(json[10].type == JsonParser::NUL);
+
+  CHECK(json.Find(0, "a") == 2);
+  CHECK(json.Find(0, "c") == 8);
+  CHECK(json.Find(0, "e") == 12 && json[12].type == JsonParser::STRING);
+  CHECK(json.Find(0, "d") == -1);
+  CHECK(json.Find(8, "d") == 10 && json[10].text == "null");
+  CHECK(json.Find(2, "a") == -1);
+
+  /* 标量与空容器也可以是顶层值 */
+  std::string scalar = "\"top\"";
+  CHECK(Parse(&json, &scalar) && json.Count() == 1 && json[0].text == "top");
+  std::string empty = "[{}, []]";
+  CHECK(Parse(&json, &empty) && json.Count() == 3 && json[0].size == 2);
+  CHECK(json[1].size == 0 && json[1].next == 2 && json[2].next == 3);
+}
+
+static void TestString() {
+  std::string text =
+      "[\"a\\\"b\\\\c\\/d\\n\", \"\\u00e9\\u4F60\", \"\\ud83d\\ude00!\", "
+      "\"" + std::string(100, 'x') + "\\t" + std::string(40, 'y') + "\"]";
+  JsonParser json;
+  CHECK(Parse(&json, &text));
+  CHECK(json.Count() == 5);
+  CHECK(json[1].text == "a\"b\\c/d\n");
+  CHECK(json[2].text == "\xC3\xA9\xE4\xBD\xA0");
+  CHECK(json[3].text == "\xF0\x9F\x98\x80!");
+  CHECK(json[4].text == std::string(100, 'x') + "\t" + std::string(40, 'y'));
+  /* 原地解码, 指向输入 */
+  CHECK(json[1].text.data() > text.data() &&
+        json[1].text.data() < text.data() + text.size());
+
+  CHECK(!Valid("\"abc"));
+  CHECK(!Valid("\"a\tb\""));
+  CHECK(!Valid("\"\\x\""));
+  CHECK(!Valid("\"\\u12G4\""));
+  CHECK(!Valid("\"\\ud83d\""));
+  CHECK(!Valid("\"\\ud83d\\u0041\""));
+  CHECK(!Valid("\"\\ude00\""));
+}
+
+static void TestNumber() {
+  const char* good[] = {"0", "-0", "12", "-3.25", "1e9", "2E-3", "0.5e+10"};
+  for (const char* n : good) {
+    CHECK(Valid(n));
+  }
+  const char* bad[] = {"01", "-", "1.", ".5", "1e", "+1", "0x10", "1.2.3"};
+  for (const char* n : bad) {
+    CHECK(!Valid(n));
+  }
+}
+
+static void TestBad() {
+  const char* cases[] = {
+      "",      "{",     "[1,]", "{\"a\"}",   "{\"a\":}", "{a:1}",
+      "[1 2]", "[}",    "tru",  "nulll",     "{} {}",   "]",
+      "[1]]",  "{\"a\" 1}", "{\"a\":1,}",
+  };
+  for (const char* c : cases) {
+    CHECK(!Valid(c));
+  }
+  CHECK(Valid(std::string(JsonParser::MAX_DEPTH, '[') +
+              std::string(JsonParser::MAX_DEPTH, ']')));
+  CHECK(!Valid(std::string(JsonParser::MAX_DEPTH + 1, '[') +
+               std::string(JsonParser::MAX_DEPTH + 1, ']')));
+}
+
+int main() {
+  TestTokens();
+  TestString();
+  TestNumber();
+  TestBad();
+  if (failed) {
+    printf("Test JsonParser Failed: %d\n", failed);
+    return 1;
+  }
+  printf("Test JsonParser Completed\n");
+  return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-11
+ * @copyleft Apache 2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "http/responsecache.h"
+#include "../test_check.h"
+
+using webserver::Compressor;
+using webserver::FileCache;
+using webserver::ResponseCache;
+
+/* 单个分片的预算只够放下10个响应: 热点路径反复访问后, 一轮只访问一次
+ * 的遍历不能把它们挤出去; 文件变化后旧响应失效。多个分片时预算平分,
+ * 各路径落在固定的分片上 */
+
+static const size_t RESPONSE_SIZE = 100;
+
+/* 空文件的条目, 响应的大小完全由响应头决定 */
+static FileCache::EntryPtr MakeFile() {
+  std::shared_ptr<FileCache::Entry> entry =
+      std::make_shared<FileCache::Entry>();
+  memset(&entry->st, 0, sizeof(entry->st));
+  return entry;
+}
+
+static ResponseCache::ResponsePtr Get(ResponseCache* cache,
+                                      const std::string& path, bool keepAlive,
+                                      const FileCache::EntryPtr& file) {
+  return cache->Get(path, keepAlive, Compressor::IDENTITY, file);
+}
+
+/* 只有响应头、没有内容的keep-alive响应 */
+static ResponseCache::ResponsePtr Put(ResponseCache* cache,
+                                      const std::string& path,
+                                      const FileCache::EntryPtr& file,
+                                      const std::string& head) {
+  return cache->Put(path, true, Compressor::IDENTITY, file, head.data(),
+                    head.size(), nullptr, 0);
+}
+
+static std::string Path(const char* prefix, int i) {
+  return prefix + std::to_string(i) + ".html";
+}
+
+/* 16个分片共放得下每片4个响应, 字节数为各分片之和 */
+static void TestShards(const std::string& head,
+                       const FileCache::EntryPtr& file) {
+  ResponseCache cache(RESPONSE_SIZE * 4 * ResponseCache::SHARDS);
+  int stored = 0;
+  for (int i = 0; i < 32; ++i) {
+    if (Put(&cache, Path("/page", i), file, head)) {
+      ++stored;
+    }
+  }
+  CHECK(stored > 0);
+  CHECK(cache.Bytes() == RESPONSE_SIZE * stored);
+  CHECK(cache.Bytes() <= RESPONSE_SIZE * 4 * ResponseCache::SHARDS);
+  int hits = 0;
+  for (int i = 0; i < 32; ++i) {
+    hits += Get(&cache, Path("/page", i), true, file) ? 1 : 0;
+  }
+  CHECK(hits == stored);
+  cache.Clear();
+  CHECK(cache.Bytes() == 0);
+  CHECK(!Get(&cache, Path("/page", 0), true, file));
+}
+
+int main() {
+  ResponseCache cache(RESPONSE_SIZE * 10, 1);
+  std::string head(RESPONSE_SIZE, 'h');
+  FileCache::EntryPtr file = MakeFile();
+
+  /* 未命中后加入, 再次访问命中同一块内存; 两种keep-alive变体互相独立 */
+  CHECK(!Get(&cache, "/index.html", true, file));
+  ResponseCache::ResponsePtr put =
+      Put(&cache, "/index.html", file, head);
+  CHECK(put && *put == head);
+  CHECK(Get(&cache, "/index.html", true, file) == put);
+  CHECK(!Get(&cache, "/index.html", false, file));
+
+  /* 文件变化 */
+  FileCache::EntryPtr newFile = MakeFile();
+  CHECK(!Get(&cache, "/index.html", true, newFile));
+  CHECK(cache.Bytes() == 0);
+  CHECK(*put == head);  // 输出链持有的旧响应仍然有效
+
+  /* 10个热点, 每个访问5次 */
+  for (int round = 0; round < 5; ++round) {
+    for (int i = 0; i < 10; ++i) {
+      if (!Get(&cache, Path("/hot", i), true, file)) {
+        Put(&cache, Path("/hot", i), file, head);
+      }
+    }
+  }
+  CHECK(cache.Bytes() == RESPONSE_SIZE * 10);
+
+  /* 1000个只访问一次的路径 */
+  int admitted = 0;
+  for (int i = 0; i < 1000; ++i) {
+    if (!Get(&cache, Path("/scan", i), true, file) &&
+        Put(&cache, Path("/scan", i), file, head)) {
+      ++admitted;
+    }
+  }
+  CHECK(admitted == 0);
+  int hits = 0;
+  for (int i = 0; i < 10; ++i) {
+    hits += Get(&cache, Path("/hot", i), true, file) ? 1 : 0;
+  }
+  CHECK(hits == 10);
+  CHECK(cache.Bytes() <= RESPONSE_SIZE * 10);
+
+  /* 新的热点访问次数超过旧热点后可以替换它们 */
+  for (int round = 0; round < 10; ++round) {
+    Get(&cache, "/new.html", true, file);
+  }
+  CHECK(Put(&cache, "/new.html", file, head));
+  CHECK(cache.Bytes() <= RESPONSE_SIZE * 10);
+
+  TestShards(head, file);
+
+  if (failed) {
+    printf("Test ResponseCache Failed: %d\n", failed);
+    return 1;
+  }
+  printf("Test ResponseCache Completed\n");
+  return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-12-18
+ * @copyleft Apache 2.0
+ */
+
+#include <stdio.h>
+
+#include <string>
+
+#include "http/httprequest.h"
+#include "http/httpresponse.h"
+#include "http/router.h"
+#include "../test_check.h"
+
+using webserver::HttpRequest;
+using webserver::HttpResponse;
+using webserver::Router;
+using webserver::StringBuffer;
+using webserver::StringPiece;
+
+/* 静态、参数、通配段的匹配与优先级(含回退), 按方法分发, 查询串, 不合法
+ * 与冲突的模式, 越过目录的通配值, 处理者给出的内容, 以及异步处理者 */
+
+/* 处理者把名字和参数写进回复的路径, 便于检查 */
+static Router::Handler Echo(const std::string& name) {
+  return [name](HttpRequest& request, HttpResponse& response) {
+    std::string path = name;
+    for (const Router::Param& param : request.params()) {
+      path += " " + param.name.ToString() + "=" + param.value.ToString();
+    }
+    response.SetPath(path);
+  };
+}
+
+/* 没有匹配的路由时返回"-" */
+static std::string Route(const std::string& method,
+                         const std::string& target) {
+  HttpRequest request;
+  HttpResponse response;
+  StringBuffer buff;
+  buff.Append(method + " " + target + " HTTP/1.1\r\nHost: x\r\n\r\n");
+  if (request.parse(buff) != HttpRequest::GET_REQUEST) {
+    return "bad";
+  }
+  response.Init("/tmp", request.path());
+  if (Router::Instance()->Dispatch(request, response) == Router::NO_ROUTE) {
+    return "-";
+  }
+  return response.Path();
+}
+
+static void TestRegister() {
+  Router* router = Router::Instance();
+  CHECK(router->Static("/", "/index.html"));
+  CHECK(router->Static("/login", "/login.html"));
+  CHECK(router->Handle(Router::POST, "/login", Echo("login")));
+  CHECK(router->Static("/assets/*file", "/static"));
+  CHECK(router->Handle(Router::GET, "/api/users/:id", Echo("user"), true));
+  CHECK(router->Handle(Router::GET, "/api/users/new", Echo("new")));
+  CHECK(router->Handle(Router::POST, "/api/users/:id/posts/:post",
+                       Echo("post")));
+  CHECK(router->Handle(Router::GET, "/api/users/:id/*rest", Echo("rest")));
+  CHECK(router->Handle(Router::ANY, "/api/*rest", Echo("api")));
+  CHECK(router->Handle(Router::DELETE, "/api/user", Echo("user1")));
+
+  /* 重复、参数名不同、格式错误 */
+  CHECK(!router->Handle(Router::GET, "/api/users/:id", Echo("dup")));
+  CHECK(!router->Handle(Router::GET, "/api/users/:uid/x", Echo("name")));
+  const char* invalid[] = {"", "api", "/a:b", "/:", "/a/*", "/*x/y",
+                           "/:a:b"};
+  for (const char* pattern : invalid) {
+    CHECK(!router->Handle(Router::GET, pattern, Echo("invalid")));
+  }
+}
+
+static void TestMatch() {
+  CHECK(Route("GET", "/") == "/index.html");
+  CHECK(Route("GET", "/login?next=/") == "/login.html");
+  CHECK(Route("POST", "/login") == "login");
+  CHECK(Route("HEAD", "/login") == "/login.html");
+  CHECK(Route("GET", "/login.html") == "-");
+  CHECK(Route("GET", "/logi") == "-");
+  CHECK(Route("GET", "/assets/css/a.css") == "/static/css/a.css");
+
+  /* 静态优先于参数, 参数优先于通配 */
+  CHECK(Route("GET", "/api/users/new") == "new");
+  CHECK(Route("GET", "/api/users/42") == "user id=42");
+  CHECK(Route("GET", "/api/users/42/x/y") == "rest id=42 rest=x/y");
+  CHECK(Route("POST", "/api/users/42/posts/7") == "post id=42 post=7");
+  /* 方法不匹配时回退: POST的new和:id都没有, 落到/api/ *rest */
+  CHECK(Route("POST", "/api/users/new") == "api rest=users/new");
+  CHECK(Route("GET", "/api/users/42/posts/7") == "rest id=42 rest=posts/7");
+  /* 参数段不匹配空段 */
+  CHECK(Route("GET", "/api/users//x") == "api rest=users//x");
+  CHECK(Route("GET", "/api/") == "api rest=");
+  CHECK(Route("DELETE", "/api/user") == "user1");
+  CHECK(Route("GET", "/api/user") == "api rest=user");
+  CHECK(Route("BREW", "/api/pot") == "api rest=pot");
+}
+
+/* 通配段的值直接接在目录之后, 含".."段的请求在解析时即被拒绝 */
+static void TestTraversal() {
+  CHECK(Router::Instance()->Static("/static/*path", "/files"));
+  CHECK(Route("GET", "/static/a/b.css") == "/files/a/b.css");
+  CHECK(Route("GET", "/static/../x") == "bad");
+  CHECK(Route("GET", "/static/a/../../x") == "bad");
+  CHECK(Route("GET", "/static/%2e%2E/x") == "bad");
+  CHECK(Route("GET", "/static/..") == "bad");
+  /* 只有整段为".."才拒绝, 查询串不在路径中 */
+  CHECK(Route("GET", "/static/a..b/..c") == "/files/a..b/..c");
+  CHECK(Route("GET", "/static/x?next=../y") == "/files/x");
+}
+
+static void TestInlineable() {
+  Router* router = Router::Instance();
+  CHECK(router->IsInlineable("GET", "/"));
+  CHECK(router->IsInlineable("GET", "/nothing/here"));
+  CHECK(router->IsInlineable("GET", "/api/users/1"));
+  CHECK(!router->IsInlineable("GET", "/api/users/new"));
+  CHECK(!router->IsInlineable("POST", "/login?x"));
+}
+
+static void TestContent() {
+  Router::Instance()->Handle(
+      Router::GET, "/hello/:name",
+      [](HttpRequest& request, HttpResponse& response) {
+        response.SetContent(201, "hi " + request.Param("name").ToString(),
+                            "text/plain; charset=utf-8");
+      });
+  HttpRequest request;
+  HttpResponse response;
+  StringBuffer buff;
+  buff.Append(std::string("GET /hello/orion HTTP/1.1\r\n\r\n"));
+  CHECK(request.parse(buff) == HttpRequest::GET_REQUEST);
+  response.Init("/tmp", request.path(), true, 200);
+  CHECK(Router::Instance()->Dispatch(request, response) == Router::HANDLED);
+  CHECK(request.Param("name") == "orion" && request.Param("x").empty());
+  CHECK(response.HasContent());
+  response.MakeResponse(buff);
+  std::string head(buff.ReadBeginPtr(), response.HeadLen());
+  CHECK(head.find("HTTP/1.1 201 Created\r\n") == 0);
+  CHECK(head.find("Content-type: text/plain; charset=utf-8\r\n") !=
+        std::string::npos);
+  CHECK(head.find("Content-length: 8\r\n") != std::string::npos);
+  CHECK(head.find("ETag") == std::string::npos);
+  CHECK(response.Segments().size() == 1 &&
+        std::string(response.Segments()[0].data, 8) == "hi orion");
+}
+
+/* 异步处理者保存done后返回, 之后再给出内容并调用done */
+static void TestAsync() {
+  Router::Done saved;
+  HttpResponse* target = nullptr;
+  CHECK(Router::Instance()->HandleAsync(
+      Router::GET, "/async/:id",
+      [&](HttpRequest& request, HttpResponse& response,
+          const Router::Done& done) {
+        target = &response;
+        saved = done;
+      }));
+  CHECK(!Router::Instance()->HandleAsync(
+      Router::GET, "/async/:id",
+      [](HttpRequest&, HttpResponse&, const Router::Done&) {}));
+  CHECK(Router::Instance()->IsInlineable("GET", "/async/1"));
+
+  HttpRequest request;
+  HttpResponse response;
+  StringBuffer buff;
+  buff.Append(std::string("GET /async/7 HTTP/1.1\r\n\r\n"));
+  CHECK(request.parse(buff) == HttpRequest::GET_REQUEST);
+  response.Init("/tmp", request.path(), true, 200);
+  int done = 0;
+  CHECK(Router::Instance()->Dispatch(request, response, [&]() { ++done; }) ==
+        Router::PENDING);
+  CHECK(target == &response && saved && done == 0);
+  CHECK(!response.HasContent());
+  target->SetContent(200, "id " + request.Param("id").ToString());
+  saved();
+  CHECK(done == 1 && response.HasContent());
+  CHECK(std::string(response.Body(), response.BodyLen()) == "id 7");
+}
+
+/* 异步处理者完成之前读缓冲区中又收到流水线请求: 缓冲区搬移、扩容后,
+   处理者与之后生成回复时仍能读取原请求的头部 */
+static void TestAsyncPipeline() {
+  Router::Done saved;
+  HttpRequest request;
+  HttpResponse response;
+  StringBuffer buff(256);
+  buff.Append(std::string("GET /async/8 HTTP/1.1\r\nRange: bytes=0-3\r\n"
+                          "If-None-Match: \"abc\"\r\n\r\n"));
+  CHECK(request.parse(buff) == HttpRequest::GET_REQUEST);
+  response.Init("/tmp", request.path(), true, 200);
+  CHECK(Router::Instance()->Dispatch(request, response, [&]() {}) ==
+        Router::PENDING);
+  /* 先在原处搬移(覆盖已取走的头部), 再扩容 */
+  std::string next = "GET /index.html HTTP/1.1\r\nX: " +
+                     std::string(150, 'x') + "\r\n\r\n";
+  buff.Append(next);
+  buff.Append(std::string(3000, 'y'));
+  CHECK(request.method() == "GET" && request.version() == "1.1");
+  CHECK(request.GetHeader("Range") == "bytes=0-3");
+  CHECK(request.GetHeader("If-None-Match") == "\"abc\"");
+  CHECK(request.Param("id") == "8");
+  CHECK(std::string(buff.ReadBeginPtr(), next.size()) == next);
+}
+
+int main() {
+  TestRegister();
+  TestMatch();
+  TestTraversal();
+  TestInlineable();
+  TestContent();
+  TestAsync();
+  TestAsyncPipeline();
+  if (failed) {
+    printf("Test Router Failed: %d\n", failed);
+    return 1;
+  }
+  printf("Test Router Completed\n");
+  return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * @Author       : Orion
+ * @Date         : 2022-10-29
+ * @copyleft Apache 2.0
+ */
+
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "base/timer.h"
+#include "base/timingwheel.h"
+
+using webserver::Clock;
+using webserver::MinHeapTimer;
+using webserver::TimeStamp;
+using webserver::TimingWheel;
+
+/* 对比MinHeapTimer与TimingWheel:
+ * add     N个60s~120s的空闲超时
+ * update  N次随机续期(每次读写事件都会调用)
+ * dowork  N次删除
+ * expire  N个1~200ms的定时器全部到期, 只统计GetNextTick的耗时,
+ *         同时检查每个回调恰好执行一次, 且提前量不超过1ms的精度 */
+
+static double ElapsedMs(TimeStamp begin) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - begin)
+      .count();
+}
+
+template <typename T>
+void Bench(const char* name, int n) {
+  std::mt19937 rng(n);
+  std::uniform_int_distribution<int> idle(60000, 120000);
+  std::uniform_int_distribution<int> fd(0, n - 1);
+  std::uniform_int_distribution<int> shortTime(1, 200);
+  double addMs, updateMs, doworkMs, expireMs = 0;
+
+  {
+    T timer;
+    TimeStamp begin = Clock::now();
+    for (int i = 0; i < n; ++i) {
+      timer.AddItem(i, idle(rng), [] {});
+    }
+    addMs = ElapsedMs(begin);
+
+    begin = Clock::now();
+    for (int i = 0; i < n; ++i) {
+      timer.UpdateItem(fd(rng), idle(rng));
+    }
+    updateMs = ElapsedMs(begin);
+
+    begin = Clock::now();
+    for (int i = 0; i < n; ++i) {
+      timer.DoWork(i);
+    }
+    doworkMs = ElapsedMs(begin);
+  }
+
+  T timer;
+  int fired = 0, early = 0, twice = 0;
+  std::vector<TimeStamp> deadline(n);
+  std::vector<char> done(n, 0);
+  for (int i = 0; i < n; ++i) {
+    int timeout = shortTime(rng);
+    deadline[i] = Clock::now() + webserver::Msec(timeout);
+    timer.AddItem(i, timeout, [&, i] {
+      if (Clock::now() + webserver::Msec(1) < deadline[i]) ++early;
+      if (done[i]++) ++twice;
+      ++fired;
+    });
+  }
+  while (fired < n) {
+    TimeStamp begin = Clock::now();
+    int next = timer.GetNextTick();
+    expireMs += ElapsedMs(begin);
+    if (next > 0) {
+      std::this_thread::sleep_for(webserver::Msec(next));
+    }
+  }
+
+  printf("%-12s %8d %10.2f %10.2f %10.2f %10.2f   early=%d twice=%d\n", name,
+         n, addMs, updateMs, doworkMs, expireMs, early, twice);
+}
+
+int main() {
+  printf("%-12s %8s %10s %10s %10s %10s   (ms)\n", "timer", "N", "add",
+         "update", "dowork", "expire");
+  for (int n : {10000, 100000, 1000000}) {
+    Bench<MinHeapTimer>("MinHeapTimer", n);
+    Bench<TimingWheel>("TimingWheel", n);
+  }
+  return 0;
+}